@@ -99,6 +99,18 @@ STATIC int GC_hblk_fl_from_blocks(word blocks_needed)
 #   define IS_MAPPED(hhdr) TRUE
 # endif /* !USE_MUNMAP */
 
+# ifdef LAZY_ZEROING
+#   define ZEROED_FLAG(hhdr) ((hhdr) -> hb_flags & ZEROED_BLK)
+    /* A free block merged with another one stays known to be zero  */
+    /* only if the other one is.                                    */
+#   define MERGE_ZEROED_FLAG(hhdr, other_hhdr) \
+        (void)((hhdr) -> hb_flags &= \
+                (unsigned char)((other_hhdr) -> hb_flags | ~ZEROED_BLK))
+# else
+#   define ZEROED_FLAG(hhdr) 0
+#   define MERGE_ZEROED_FLAG(hhdr, other_hhdr) (void)0
+# endif
+
 #if !defined(NO_DEBUGGING) || defined(GC_ASSERTIONS)
   /* Should return the same value as GC_large_free_bytes.       */
   GC_INNER word GC_compute_large_free_bytes(void)
@@ -464,6 +476,7 @@ GC_INNER void GC_merge_unmapped(void)
             GC_remove_from_fl_at(hhdr, i);
             GC_remove_from_fl(nexthdr);
             hhdr -> hb_sz += nexthdr -> hb_sz;
+            MERGE_ZEROED_FLAG(hhdr, nexthdr);
             GC_remove_header(next);
             GC_add_to_fl(h, hhdr);
             /* Start over at beginning of list */
@@ -477,6 +490,50 @@ GC_INNER void GC_merge_unmapped(void)
 
 #endif /* USE_MUNMAP */
 
+#ifdef LAZY_ZEROING
+
+#   ifndef LAZY_ZEROING_MIN_BYTES
+#     define LAZY_ZEROING_MIN_BYTES (16 * HBLKSIZE)
+#   endif
+
+#   ifndef LAZY_ZEROING_THRESHOLD
+#     define LAZY_ZEROING_THRESHOLD 2
+#   endif
+
+GC_INNER GC_bool GC_last_hblk_zeroed = FALSE;
+
+/* Give the pages of the free blocks not known to be zero back to the   */
+/* OS, so that the blocks need not be cleared when reallocated.  Only   */
+/* blocks which have not been touched for more than                     */
+/* LAZY_ZEROING_THRESHOLD collections are released, since faulting the  */
+/* pages back in costs more than clearing them; blocks smaller than     */
+/* LAZY_ZEROING_MIN_BYTES are left alone for the same reason.           */
+GC_INNER void GC_discard_free_blocks(void)
+{
+    struct hblk * h;
+    hdr * hhdr;
+    int i;
+
+    if (GC_page_size > HBLKSIZE)
+      return; /* blocks are not page-aligned */
+
+    for (i = GC_hblk_fl_from_blocks(divHBLKSZ(LAZY_ZEROING_MIN_BYTES));
+         i <= N_HBLK_FLS; ++i) {
+      for (h = GC_hblkfreelist[i]; 0 != h; h = hhdr -> hb_next) {
+        hhdr = HDR(h);
+        if (ZEROED_FLAG(hhdr) != 0 || !IS_MAPPED(hhdr)
+            || hhdr -> hb_sz < LAZY_ZEROING_MIN_BYTES
+            || (unsigned short)GC_gc_no - hhdr -> hb_last_reclaimed
+                <= (unsigned short)LAZY_ZEROING_THRESHOLD) continue;
+
+        if (GC_discard_pages((ptr_t)h, hhdr -> hb_sz))
+          hhdr -> hb_flags |= ZEROED_BLK;
+      }
+    }
+}
+
+#endif /* LAZY_ZEROING */
+
 /*
  * Return a pointer to a block starting at h of length bytes.
  * Memory for the block is mapped.
@@ -504,7 +561,7 @@ STATIC struct hblk * GC_get_first_part(struct hblk *h, hdr *hhdr,
         return(0);
     }
     rest_hdr -> hb_sz = total_size - bytes;
-    rest_hdr -> hb_flags = 0;
+    rest_hdr -> hb_flags = ZEROED_FLAG(hhdr);
 #   ifdef GC_ASSERTIONS
       /* Mark h not free, to avoid assertion about adjacent free blocks. */
         hhdr -> hb_flags &= ~FREE_BLK;
@@ -539,7 +596,7 @@ STATIC void GC_split_block(struct hblk *h, hdr *hhdr, struct hblk *n,
       nhdr -> hb_prev = prev;
       nhdr -> hb_next = next;
       nhdr -> hb_sz = total_size - h_size;
-      nhdr -> hb_flags = 0;
+      nhdr -> hb_flags = ZEROED_FLAG(hhdr);
       if (0 != prev) {
         HDR(prev) -> hb_next = n;
       } else {
@@ -550,7 +607,7 @@ STATIC void GC_split_block(struct hblk *h, hdr *hhdr, struct hblk *n,
       }
       GC_ASSERT(GC_free_bytes[index] > h_size);
       GC_free_bytes[index] -= h_size;
-#   ifdef USE_MUNMAP
+#   if defined(USE_MUNMAP) || defined(LAZY_ZEROING)
       hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
 #   endif
     hhdr -> hb_sz = h_size;
@@ -628,6 +685,45 @@ GC_allochblk(size_t sz, int kind, unsigned flags/* IGNORE_OFF_PAGE or 0 */)
     return result;
 }
 
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  GC_INNER unsigned GC_split_inuse_hblk(struct hblk *h, word n_blocks,
+                                        unsigned count,
+                                        struct hblk **result)
+  {
+    hdr * hhdr = HDR(h);
+    struct obj_kind * ok = &GC_obj_kinds[hhdr -> hb_obj_kind];
+    word sz = n_blocks * HBLKSIZE;
+    word total_size = hhdr -> hb_sz;
+    unsigned i, j;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(total_size == count * sz);
+    result[0] = h;
+    for (i = 1; i < count; ++i) {
+      struct hblk * part = h + i * n_blocks;
+      hdr * phdr = GC_install_header(part);
+
+      if (NULL == phdr) break;
+      BCOPY(hhdr, phdr, sizeof(hdr)); /* including the cleared marks */
+      phdr -> hb_block = part;
+      result[i] = part;
+    }
+    for (j = 0; j < i; ++j) {
+      hdr * phdr = HDR(result[j]);
+      word part_sz = j + 1 < i ? sz : total_size - j * sz;
+
+      phdr -> hb_sz = part_sz;
+      phdr -> hb_descr = ok -> ok_descriptor;
+      if (ok -> ok_relocate_descr) phdr -> hb_descr += part_sz;
+      if (j > 0) {
+        /* Cannot fail, the index blocks for the whole run exist.       */
+        (void)GC_install_counts(result[j], (size_t)part_sz);
+      }
+    }
+    return i;
+  }
+#endif /* THREAD_LOCAL_LARGE_CACHE */
+
 STATIC long GC_large_alloc_warn_suppressed = 0;
                         /* Number of warnings suppressed so far.        */
 
@@ -645,6 +741,9 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
     hdr * thishdr;              /* Header corr. to thishbp */
     signed_word size_needed;    /* number of bytes in requested objects */
     signed_word size_avail;     /* bytes available in this block        */
+#   ifdef LAZY_ZEROING
+      GC_bool zeroed;
+#   endif
 
     size_needed = HBLKSIZE * OBJ_SZ_TO_BLOCKS(sz);
 
@@ -791,6 +890,9 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
         if (!GC_install_counts(hbp, (word)size_needed)) return(0);
         /* This leaks memory under very rare conditions. */
 
+#   ifdef LAZY_ZEROING
+      zeroed = ZEROED_FLAG(hhdr) != 0;
+#   endif
     /* Set up header */
         if (!setup_header(hhdr, hbp, sz, kind, flags)) {
             GC_remove_counts(hbp, (word)size_needed);
@@ -812,6 +914,9 @@ GC_allochblk_nth(size_t sz, int kind, unsigned flags, int n, int may_split)
 
     GC_large_free_bytes -= size_needed;
     GC_ASSERT(IS_MAPPED(hhdr));
+#   ifdef LAZY_ZEROING
+      GC_last_hblk_zeroed = zeroed;
+#   endif
     return( hbp );
 }
 
@@ -837,7 +942,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
       /* later.                                                             */
     GC_remove_counts(hbp, size);
     hhdr->hb_sz = size;
-#   ifdef USE_MUNMAP
+#   if defined(USE_MUNMAP) || defined(LAZY_ZEROING)
       hhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
 #   endif
 
@@ -849,6 +954,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
 
     GC_ASSERT(IS_MAPPED(hhdr));
     hhdr -> hb_flags |= FREE_BLK;
+    GC_hdr_cache_epoch++; /* the header might be cached by a marker */
     next = (struct hblk *)((ptr_t)hbp + size);
     GET_HDR(next, nexthdr);
     prev = GC_free_block_ending_at(hbp);
@@ -858,6 +964,7 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
          /* no overflow */) {
         GC_remove_from_fl(nexthdr);
         hhdr -> hb_sz += nexthdr -> hb_sz;
+        MERGE_ZEROED_FLAG(hhdr, nexthdr);
         GC_remove_header(next);
       }
     /* Coalesce with predecessor, if possible. */
@@ -867,7 +974,8 @@ GC_INNER void GC_freehblk(struct hblk *hbp)
             && (signed_word)(hhdr -> hb_sz + prevhdr -> hb_sz) > 0) {
           GC_remove_from_fl(prevhdr);
           prevhdr -> hb_sz += hhdr -> hb_sz;
-#         ifdef USE_MUNMAP
+          MERGE_ZEROED_FLAG(prevhdr, hhdr);
+#         if defined(USE_MUNMAP) || defined(LAZY_ZEROING)
             prevhdr -> hb_last_reclaimed = (unsigned short)GC_gc_no;
 #         endif
           GC_remove_header(hbp);
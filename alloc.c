@@ -305,6 +305,9 @@ GC_INNER GC_bool GC_should_collect(void)
 {
     static word last_min_bytes_allocd;
     static word last_gc_no;
+#   ifdef FINE_GRAINED_LOCKS
+      GC_flush_fl_bytes_allocd();
+#   endif
     if (last_gc_no != GC_gc_no) {
       last_gc_no = GC_gc_no;
       last_min_bytes_allocd = min_bytes_allocd();
@@ -375,7 +378,13 @@ STATIC void GC_maybe_gc(void)
                 "***>Full mark for collection #%lu after %lu allocd bytes\n",
                 (unsigned long)GC_gc_no + 1, (unsigned long)GC_bytes_allocd);
             GC_promote_black_lists();
+#           ifdef FINE_GRAINED_LOCKS
+              GC_fl_lock_all();
+#           endif
             (void)GC_reclaim_all((GC_stop_func)0, TRUE);
+#           ifdef FINE_GRAINED_LOCKS
+              GC_fl_unlock_all();
+#           endif
             GC_notify_full_gc();
             GC_clear_marks();
             n_partial_gcs = 0;
@@ -447,10 +456,20 @@ GC_INNER GC_bool GC_try_to_collect_inner(GC_stop_func stop_func)
           if (GC_parallel)
             GC_wait_for_reclaim();
 #       endif
-        if ((GC_find_leak || stop_func != GC_never_stop_func)
-            && !GC_reclaim_all(stop_func, FALSE)) {
+        if (GC_find_leak || stop_func != GC_never_stop_func) {
+          GC_bool done;
+
+#         ifdef FINE_GRAINED_LOCKS
+            GC_fl_lock_all();
+#         endif
+          done = GC_reclaim_all(stop_func, FALSE);
+#         ifdef FINE_GRAINED_LOCKS
+            GC_fl_unlock_all();
+#         endif
+          if (!done) {
             /* Aborted.  So far everything is still consistent. */
             return(FALSE);
+          }
         }
     GC_invalidate_mark_state();  /* Flush mark stack.   */
     GC_clear_marks();
@@ -608,9 +627,21 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
         GET_TIME(start_time);
 #   endif
 
+#   ifdef FINE_GRAINED_LOCKS
+      /* Keep the other threads off the free lists until GC_finish_     */
+      /* collection rebuilds them (an object allocated after the world  */
+      /* is restarted would not be marked).  No thread holds any of the */
+      /* locks while the world is stopped.                              */
+      GC_fl_lock_all();
+      GC_flush_fl_bytes_allocd();
+#   endif
     STOP_WORLD();
 #   ifdef THREAD_LOCAL_ALLOC
       GC_world_stopped = TRUE;
+#   endif
+#   ifdef THREAD_LOCAL_LARGE_CACHE
+      /* Let the sweep reclaim the cached objects not in use.  */
+      GC_drop_thread_local_large_caches();
 #   endif
         /* Output blank line for convenience here */
     GC_COND_LOG_PRINTF(
@@ -637,6 +668,9 @@ STATIC GC_bool GC_stopped_mark(GC_stop_func stop_func)
               GC_world_stopped = FALSE;
 #           endif
             START_WORLD();
+#           ifdef FINE_GRAINED_LOCKS
+              GC_fl_unlock_all();
+#           endif
             return(FALSE);
           }
           if (GC_mark_some(GC_approx_sp())) break;
@@ -723,6 +757,25 @@ GC_INNER void GC_set_fl_marks(ptr_t q)
    }
 }
 
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  GC_INNER void GC_set_region_marks(ptr_t p, ptr_t limit)
+  {
+    struct hblk *h = HBLKPTR(p);
+    hdr *hhdr = HDR(h);
+    size_t sz = hhdr -> hb_sz;
+    unsigned bit_no;
+
+    GC_ASSERT((word)limit <= (word)(h + 1));
+    for (; (word)p < (word)limit; p += sz) {
+      bit_no = MARK_BIT_NO(p - (ptr_t)h, sz);
+      if (!mark_bit_from_hdr(hhdr, bit_no)) {
+        set_mark_bit_from_hdr(hhdr, bit_no);
+        ++hhdr -> hb_n_marks;
+      }
+    }
+  }
+#endif /* THREAD_LOCAL_BUMP_ALLOC */
+
 #if defined(GC_ASSERTIONS) && defined(THREADS) && defined(THREAD_LOCAL_ALLOC)
   /* Check that all mark bits for the free list whose first entry is    */
   /* (*pfreelist) are set.  Check skipped if points to a special value. */
@@ -878,6 +931,9 @@ STATIC void GC_finish_collection(void)
 #   ifndef GC_NO_FINALIZATION
       GC_finalize();
 #   endif
+#   ifdef HEAP_PROFILE
+      GC_heap_profile_prune();
+#   endif
 #   ifdef STUBBORN_ALLOC
       GC_clean_changing_list();
 #   endif
@@ -948,8 +1004,14 @@ STATIC void GC_finish_collection(void)
     GC_bytes_dropped = 0;
     GC_bytes_freed = 0;
     GC_finalizer_bytes_freed = 0;
+#   ifdef FINE_GRAINED_LOCKS
+      GC_fl_unlock_all(); /* acquired by GC_stopped_mark */
+#   endif
 
     IF_USE_MUNMAP(GC_unmap_old());
+#   ifdef LAZY_ZEROING
+      GC_discard_free_blocks();
+#   endif
 
 #   ifndef SMALL_CONFIG
       if (GC_print_stats) {
@@ -1053,7 +1115,8 @@ GC_INNER word GC_n_heap_sects = 0;
  * Use the chunk of memory starting at p of size bytes as part of the heap.
  * Assumes p is HBLKSIZE aligned, and bytes is a multiple of HBLKSIZE.
  */
-GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes)
+GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes,
+                              GC_bool zeroed GC_ATTR_UNUSED)
 {
     hdr * phdr;
     word endp;
@@ -1085,8 +1148,27 @@ GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes)
     GC_heap_sects[GC_n_heap_sects].hs_start = (ptr_t)p;
     GC_heap_sects[GC_n_heap_sects].hs_bytes = bytes;
     GC_n_heap_sects++;
+#   ifdef HEAP_MAP
+      {
+        word i;
+        word n = ((endp - 1) >> LOG_HEAP_MAP_GRANULE)
+                 - ((word)p >> LOG_HEAP_MAP_GRANULE) + 1;
+
+        if (n > HEAP_MAP_ENTRIES) n = HEAP_MAP_ENTRIES;
+        for (i = 0; i < n; i++) {
+          set_pht_entry_from_index(GC_heap_map,
+                HEAP_MAP_HASH((word)p + (i << LOG_HEAP_MAP_GRANULE)));
+        }
+      }
+#   endif
+#   ifdef UFFD_VDB
+      GC_uffd_add_heap_range((ptr_t)p, bytes);
+#   endif
     phdr -> hb_sz = bytes;
     phdr -> hb_flags = 0;
+#   ifdef LAZY_ZEROING
+      if (zeroed) phdr -> hb_flags = ZEROED_BLK;
+#   endif
     GC_freehblk(p);
     GC_heapsize += bytes;
 
@@ -1210,7 +1292,7 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
     }
     GC_prev_heap_addr = GC_last_heap_addr;
     GC_last_heap_addr = (ptr_t)space;
-    GC_add_to_heap(space, bytes);
+    GC_add_to_heap(space, bytes, TRUE);
     /* Force GC before we are likely to allocate past expansion_slop */
       GC_collect_at_heapsize =
          GC_heapsize + expansion_slop - 2*MAXHINCR*HBLKSIZE;
@@ -1346,10 +1428,14 @@ GC_INNER ptr_t GC_allocobj(size_t gran, int kind)
       /* Do our share of marking work */
         if(TRUE_INCREMENTAL) GC_collect_a_little_inner(1);
       /* Sweep blocks for objects of this size */
+        FL_LOCK(kind, gran);
         GC_continue_reclaim(gran, kind);
+        FL_UNLOCK(kind, gran);
       EXIT_GC();
       if (*flh == 0) {
+        FL_LOCK(kind, gran);
         GC_new_hblk(gran, kind);
+        FL_UNLOCK(kind, gran);
         if (*flh == 0) {
           ENTER_GC();
           if (GC_incremental && GC_time_limit == GC_TIME_UNLIMITED
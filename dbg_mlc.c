@@ -1262,3 +1262,372 @@ GC_API void * GC_CALL GC_debug_realloc_replacement(void *p, size_t lb)
 {
     return GC_debug_realloc(p, lb, GC_DBG_EXTRAS);
 }
+
+#ifdef HEAP_PROFILE
+# include <execinfo.h>
+# include <fcntl.h>
+# include <stdio.h>
+# include <unistd.h>
+
+# ifndef HEAP_PROFILE_FRAMES
+#   define HEAP_PROFILE_FRAMES 16
+# endif
+
+  /* Allocation sampling.  The allocating thread counts down the bytes  */
+  /* to the next sample; the counter is reset to a pseudo-random        */
+  /* interval exponentially distributed with GC_heap_profile_interval   */
+  /* mean, so that every allocated byte is equally likely to be sampled */
+  /* (the profile uses the same model as the pprof "heap_v2" format).   */
+  /* A sample records the call stack into a bucket shared by all the    */
+  /* samples with that stack, and remembers the (hidden) object address */
+  /* until the object is found unmarked after a collection or is        */
+  /* explicitly deallocated.  All the profiler data is kept outside the */
+  /* garbage-collected heap (in the scratch space) and never freed, so  */
+  /* that the sampling never triggers a collection.                     */
+
+  GC_INNER word GC_heap_profile_interval = 0; /* 0 means disabled */
+
+  /* The countdown value used while the sampling is disabled, i.e. how  */
+  /* often to check whether it has been enabled.                        */
+# define HP_RECHECK_BYTES ((signed_word)1 << 20)
+
+  struct hp_bucket {
+    struct hp_bucket *next;
+    word hash;
+    word alloc_count;   /* Number of samples taken at this stack.      */
+    word alloc_bytes;
+    word live_count;    /* Number of samples not yet found dead.        */
+    word live_bytes;
+    unsigned n_frames;
+    word pcs[HEAP_PROFILE_FRAMES];
+  };
+
+  struct hp_sample {
+    struct hp_sample *next;
+    word hidden_obj;    /* GC_HIDE_POINTER(object base) */
+    word bytes;         /* requested size               */
+    struct hp_bucket *bucket;
+  };
+
+# define HP_BUCKET_LOG_TSIZE 10
+
+  STATIC struct hp_bucket **GC_hp_buckets = NULL;
+                                /* 1 << HP_BUCKET_LOG_TSIZE entries.    */
+  STATIC struct hp_sample **GC_hp_samples = NULL;
+  STATIC unsigned GC_hp_samples_log_size = 0;
+  STATIC word GC_hp_samples_cnt = 0;
+  STATIC struct hp_sample *GC_hp_free_samples = NULL;
+
+# define HP_HASH(addr, log_size) \
+        ((((word)(addr) >> 3) ^ ((word)(addr) >> (3 + (log_size)))) \
+         & (((word)1 << (log_size)) - 1))
+
+  /* Double the size of the samples table (or allocate it initially).   */
+  /* The old table is not reclaimed.  Return FALSE if out of memory.    */
+  STATIC GC_bool GC_hp_grow_samples(void)
+  {
+    unsigned log_new_size = GC_hp_samples == NULL ? 10
+                                : GC_hp_samples_log_size + 1;
+    word new_size = (word)1 << log_new_size;
+    struct hp_sample **new_table = (struct hp_sample **)
+                GC_scratch_alloc((size_t)new_size * sizeof(void *));
+    word i;
+
+    if (NULL == new_table) return FALSE;
+    BZERO(new_table, (size_t)new_size * sizeof(void *));
+    if (GC_hp_samples != NULL) {
+      for (i = 0; i < ((word)1 << GC_hp_samples_log_size); i++) {
+        struct hp_sample *s = GC_hp_samples[i];
+
+        while (s != NULL) {
+          struct hp_sample *next = s -> next;
+          word h = HP_HASH(GC_REVEAL_POINTER(s -> hidden_obj),
+                           log_new_size);
+
+          s -> next = new_table[h];
+          new_table[h] = s;
+          s = next;
+        }
+      }
+    }
+    GC_hp_samples = new_table;
+    GC_hp_samples_log_size = log_new_size;
+    return TRUE;
+  }
+
+  /* Return the bucket for the given call stack, creating it if needed. */
+  STATIC struct hp_bucket *GC_hp_get_bucket(void **pcs, unsigned n_frames)
+  {
+    word hash = 0;
+    struct hp_bucket *b;
+    unsigned i;
+
+    if (NULL == GC_hp_buckets) {
+      GC_hp_buckets = (struct hp_bucket **)GC_scratch_alloc(
+                        ((size_t)1 << HP_BUCKET_LOG_TSIZE) * sizeof(void *));
+      if (NULL == GC_hp_buckets) return NULL;
+      BZERO(GC_hp_buckets,
+            ((size_t)1 << HP_BUCKET_LOG_TSIZE) * sizeof(void *));
+    }
+    for (i = 0; i < n_frames; i++)
+      hash = hash * 31 + ((word)pcs[i] >> 2);
+    for (b = GC_hp_buckets[hash & ((1 << HP_BUCKET_LOG_TSIZE) - 1)];
+         b != NULL; b = b -> next) {
+      if (b -> hash == hash && b -> n_frames == n_frames) {
+        for (i = 0; i < n_frames; i++) {
+          if (b -> pcs[i] != (word)pcs[i]) break;
+        }
+        if (i == n_frames) return b;
+      }
+    }
+    b = (struct hp_bucket *)GC_scratch_alloc(sizeof(struct hp_bucket));
+    if (NULL == b) return NULL;
+    BZERO(b, sizeof(struct hp_bucket));
+    b -> hash = hash;
+    b -> n_frames = n_frames;
+    for (i = 0; i < n_frames; i++)
+      b -> pcs[i] = (word)pcs[i];
+    b -> next = GC_hp_buckets[hash & ((1 << HP_BUCKET_LOG_TSIZE) - 1)];
+    GC_hp_buckets[hash & ((1 << HP_BUCKET_LOG_TSIZE) - 1)] = b;
+    return b;
+  }
+
+  /* Unlink the sample of p (if any) from the samples table, and        */
+  /* return it.  Lock is held.                                          */
+  STATIC struct hp_sample *GC_hp_unlink_sample(ptr_t p)
+  {
+    struct hp_sample **prev;
+    struct hp_sample *s;
+
+    if (0 == GC_hp_samples_cnt) return NULL;
+    prev = &GC_hp_samples[HP_HASH(p, GC_hp_samples_log_size)];
+    for (s = *prev; s != NULL; prev = &s -> next, s = s -> next) {
+      if (s -> hidden_obj == GC_HIDE_POINTER(p)) {
+        *prev = s -> next;
+        GC_hp_samples_cnt--;
+        return s;
+      }
+    }
+    return NULL;
+  }
+
+  /* Account the sample s as dead, and put it to the free list.         */
+  STATIC void GC_hp_free_sample(struct hp_sample *s)
+  {
+    s -> bucket -> live_count--;
+    s -> bucket -> live_bytes -= s -> bytes;
+    s -> next = GC_hp_free_samples;
+    GC_hp_free_samples = s;
+  }
+
+  STATIC void GC_hp_add_sample(ptr_t p, size_t lb, void **pcs,
+                               unsigned n_frames)
+  {
+    struct hp_bucket *b;
+    struct hp_sample *s;
+    word h;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    s = GC_hp_unlink_sample(p); /* in case it is stale */
+    if (s != NULL) GC_hp_free_sample(s);
+    if ((NULL == GC_hp_samples
+         || GC_hp_samples_cnt >= ((word)1 << GC_hp_samples_log_size))
+        && !GC_hp_grow_samples())
+      return;
+    b = GC_hp_get_bucket(pcs, n_frames);
+    if (NULL == b) return;
+    s = GC_hp_free_samples;
+    if (s != NULL) {
+      GC_hp_free_samples = s -> next;
+    } else {
+      s = (struct hp_sample *)GC_scratch_alloc(sizeof(struct hp_sample));
+      if (NULL == s) return;
+    }
+    s -> hidden_obj = GC_HIDE_POINTER(p);
+    s -> bytes = lb;
+    s -> bucket = b;
+    h = HP_HASH(p, GC_hp_samples_log_size);
+    s -> next = GC_hp_samples[h];
+    GC_hp_samples[h] = s;
+    GC_hp_samples_cnt++;
+    b -> alloc_count++;
+    b -> alloc_bytes += lb;
+    b -> live_count++;
+    b -> live_bytes += lb;
+  }
+
+  /* Return a pseudo-random number of bytes exponentially distributed   */
+  /* with the given mean.  *prnd is the generator state.                */
+  STATIC signed_word GC_hp_next_interval(word *prnd, word mean)
+  {
+    word r;
+    unsigned log2_r = 0;
+    double neg_log2_u;
+
+    *prnd = *prnd * 1103515245 + 12345;
+    r = ((*prnd >> 8) & 0xffffff) + 1; /* u = r / 2**24 is in (0, 1] */
+    while ((r >> (log2_r + 1)) != 0) log2_r++;
+    /* -log2(u) with the logarithm linearly interpolated between the    */
+    /* powers of two (the error is below 0.09).                         */
+    neg_log2_u = 24 - log2_r
+                 - (double)(r - ((word)1 << log2_r)) / ((word)1 << log2_r);
+    return (signed_word)(neg_log2_u * 0.6931471805599453 * (double)mean)
+           + 1;
+  }
+
+  GC_INNER void *GC_sample_alloc(signed_word *pcountdown, word *prnd,
+                                 void *p, size_t lb)
+  {
+    word mean = GC_heap_profile_interval;
+    void *pcs[HEAP_PROFILE_FRAMES + 1];
+    int n_frames;
+    DCL_LOCK_STATE;
+
+    if (0 == mean) {
+      *pcountdown = HP_RECHECK_BYTES;
+      return p;
+    }
+    *pcountdown = GC_hp_next_interval(prnd, mean);
+    if (NULL == p) return p;
+    /* Omit our own frame.      */
+    n_frames = backtrace(pcs, HEAP_PROFILE_FRAMES + 1) - 1;
+    if (n_frames < 0) n_frames = 0;
+    LOCK();
+    GC_hp_add_sample((ptr_t)p, lb, pcs + 1, (unsigned)n_frames);
+    UNLOCK();
+    return p;
+  }
+
+  GC_INNER void GC_heap_profile_free(ptr_t p)
+  {
+    struct hp_sample *s = GC_hp_unlink_sample(p);
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (s != NULL) GC_hp_free_sample(s);
+  }
+
+  GC_INNER void GC_heap_profile_prune(void)
+  {
+    word i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (0 == GC_hp_samples_cnt) return;
+    for (i = 0; i < ((word)1 << GC_hp_samples_log_size); i++) {
+      struct hp_sample **prev = &GC_hp_samples[i];
+      struct hp_sample *s = *prev;
+
+      while (s != NULL) {
+        struct hp_sample *next = s -> next;
+
+        if (!GC_is_marked(GC_REVEAL_POINTER(s -> hidden_obj))) {
+          *prev = next;
+          GC_hp_samples_cnt--;
+          GC_hp_free_sample(s);
+        } else {
+          prev = &s -> next;
+        }
+        s = next;
+      }
+    }
+  }
+
+  STATIC int GC_hp_write(int fd, const char *buf, size_t len)
+  {
+    while (len > 0) {
+      ssize_t res = write(fd, buf, len);
+
+      if (res < 0) {
+        if (EINTR == errno) continue;
+        return -1;
+      }
+      buf += res;
+      len -= (size_t)res;
+    }
+    return 0;
+  }
+#endif /* HEAP_PROFILE */
+
+GC_API void GC_CALL GC_set_heap_profile_interval(GC_word bytes)
+{
+# ifdef HEAP_PROFILE
+    GC_heap_profile_interval = bytes;
+# else
+    (void)bytes;
+# endif
+}
+
+GC_API GC_word GC_CALL GC_get_heap_profile_interval(void)
+{
+# ifdef HEAP_PROFILE
+    return GC_heap_profile_interval;
+# else
+    return 0;
+# endif
+}
+
+GC_API int GC_CALL GC_dump_heap_profile(const char *file_name)
+{
+# ifdef HEAP_PROFILE
+    char buf[80 + 20 * HEAP_PROFILE_FRAMES];
+    word live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+    struct hp_bucket *b;
+    int fd;
+    int res = 0;
+    unsigned i;
+    IF_CANCEL(int cancel_state;)
+    DCL_LOCK_STATE;
+
+    fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    LOCK();
+    DISABLE_CANCEL(cancel_state);
+    for (i = 0; GC_hp_buckets != NULL && i < (1 << HP_BUCKET_LOG_TSIZE);
+         i++) {
+      for (b = GC_hp_buckets[i]; b != NULL; b = b -> next) {
+        live_count += b -> live_count;
+        live_bytes += b -> live_bytes;
+        alloc_count += b -> alloc_count;
+        alloc_bytes += b -> alloc_bytes;
+      }
+    }
+    sprintf(buf, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu\n",
+            (unsigned long)live_count, (unsigned long)live_bytes,
+            (unsigned long)alloc_count, (unsigned long)alloc_bytes,
+            (unsigned long)GC_heap_profile_interval);
+    res = GC_hp_write(fd, buf, strlen(buf));
+    for (i = 0; GC_hp_buckets != NULL && i < (1 << HP_BUCKET_LOG_TSIZE)
+                && 0 == res; i++) {
+      for (b = GC_hp_buckets[i]; b != NULL && 0 == res; b = b -> next) {
+        char *q = buf;
+        unsigned j;
+
+        q += sprintf(q, "%lu: %lu [%lu: %lu] @",
+                     (unsigned long)b -> live_count,
+                     (unsigned long)b -> live_bytes,
+                     (unsigned long)b -> alloc_count,
+                     (unsigned long)b -> alloc_bytes);
+        for (j = 0; j < b -> n_frames; j++)
+          q += sprintf(q, " 0x%lx", (unsigned long)b -> pcs[j]);
+        *q++ = '\n';
+        res = GC_hp_write(fd, buf, (size_t)(q - buf));
+      }
+    }
+#   ifdef NEED_PROC_MAPS
+      /* Let pprof symbolize the addresses in the shared libraries.     */
+      if (0 == res) {
+        char *maps = GC_get_maps();
+
+        res = GC_hp_write(fd, "\nMAPPED_LIBRARIES:\n", 19);
+        if (0 == res && maps != NULL)
+          res = GC_hp_write(fd, maps, strlen(maps));
+      }
+#   endif
+    RESTORE_CANCEL(cancel_state);
+    UNLOCK();
+    if (close(fd) < 0) res = -1;
+    return res;
+# else
+    (void)file_name;
+    return -1;
+# endif
+}
@@ -23,115 +23,471 @@
 /* descendants.                                                         */
 typedef void (* finalization_mark_proc)(ptr_t /* finalizable_obj_ptr */);
 
-#define HASH3(addr,size,log_size) \
-        ((((word)(addr) >> 3) ^ ((word)(addr) >> (3 + (log_size)))) \
-         & ((size) - 1))
-#define HASH2(addr,log_size) HASH3(addr, 1 << (log_size), log_size)
-
-struct hash_chain_entry {
-    word hidden_key;
-    struct hash_chain_entry * next;
+/* The disappearing links and the finalizers are kept in open-addressing */
+/* hash tables (with linear probing) storing the entries inline.  The   */
+/* first word of an entry is the hidden key, the second one is nonzero  */
+/* for a live entry.  A slot with zero key is empty; a deleted entry    */
+/* keeps its key (so that the probe sequences are not broken) with the  */
+/* rest of the words cleared.  If the load (including the deleted       */
+/* entries) exceeds 3/4, the table is replaced by a new one (twice as   */
+/* large as the number of the live entries), and the entries of the     */
+/* old one are moved by the subsequent insertions a few slots at a      */
+/* time, thus the collector never rehashes a huge table at once.        */
+/* Meanwhile, the lookups examine both tables.  All the operations are  */
+/* called with the allocation lock held.                                */
+struct hash_table_s {
+    word *slots;                /* The entry_words-word slots.          */
+    word *old_slots;            /* The table being moved, or NULL.      */
+                                /* Should follow slots (both are        */
+                                /* pushed by GC_push_finalizer_structures). */
+    signed_word log_size;       /* Log of the number of slots, or -1.   */
+    signed_word log_old_size;   /* The same for old_slots.              */
+    word moved;                 /* The old_slots below are moved.       */
+    word move_step;             /* The number of old_slots moved per    */
+                                /* insertion.                           */
+    word used;                  /* The number of nonempty slots.        */
+    word entry_words;
+    int kind;                   /* The kind of the table object.        */
+    const char *name;           /* For logging.                         */
 };
 
+#define HT_INITIALIZER(entry_type, kind, name) \
+        { NULL, NULL, -1, -1, 0, 0, 0, \
+          sizeof(entry_type) / sizeof(word), kind, name }
+
+#define HT_SIZE(log_size) ((log_size) == -1 ? 0 : (word)1 << (log_size))
+
+#define HT_MIN_LOG_SIZE 4
+#define HT_MIN_MOVE_STEP 16
+
+/* Fibonacci hashing of the hidden key (the low bits of the addresses   */
+/* are too regular for linear probing).                                 */
+#if CPP_WORDSZ == 64
+# define HT_HASH_MULT (((word)0x9e3779b9 << 32) | (word)0x7f4a7c15)
+#else
+# define HT_HASH_MULT ((word)0x9e3779b9)
+#endif
+#define HT_HASH(key, log_size) \
+        ((word)((key) * HT_HASH_MULT) >> (CPP_WORDSZ - (log_size)))
+
+/* Iterate over the live entries of both the tables, p points to the    */
+/* current one.  GC_ht_delete(ht, p) is allowed in the loop body.       */
+#define HT_ITERATE_BEGIN(ht, p) \
+  { \
+    int part_; \
+    for (part_ = 0; part_ < 2; part_++) { \
+      word *base_ = 0 == part_ ? (ht) -> slots : (ht) -> old_slots; \
+      word size_ = HT_SIZE(0 == part_ ? (ht) -> log_size \
+                                      : (ht) -> log_old_size); \
+      word i_ = 0 == part_ ? 0 : (ht) -> moved; \
+      \
+      for (; i_ < size_; i_++) { \
+        p = base_ + i_ * (ht) -> entry_words; \
+        if (p[1] != 0) {
+
+#define HT_ITERATE_END \
+        } \
+      } \
+    } \
+  }
+
+/* The slot i of the current table followed by the old one.             */
+#define HT_SLOT_AT(ht, i) \
+        ((i) < HT_SIZE((ht) -> log_size) \
+         ? (ht) -> slots + (i) * (ht) -> entry_words \
+         : (ht) -> old_slots \
+                + ((i) - HT_SIZE((ht) -> log_size)) * (ht) -> entry_words)
+
+/* Find the entry with the given key in the current (or old) table.     */
+/* If live is FALSE, then a deleted entry is looked for (except for the */
+/* old_slots already moved).  Returns NULL if not found.                */
+STATIC word *GC_ht_probe(const struct hash_table_s *ht, GC_bool old,
+                         word key, GC_bool live)
+{
+    word *base = old ? ht -> old_slots : ht -> slots;
+    signed_word log_size = old ? ht -> log_old_size : ht -> log_size;
+    word skip = old ? ht -> moved : 0;
+    word mask, i;
+
+    if (NULL == base) return NULL;
+    mask = ((word)1 << log_size) - 1;
+    for (i = HT_HASH(key, log_size); ; i = (i + 1) & mask) {
+        word *p = base + i * ht -> entry_words;
+
+        if (0 == p[0]) return NULL;
+        if (p[0] == key && (p[1] != 0) == live && (live || i >= skip))
+            return p;
+    }
+}
+
+GC_INLINE word *GC_ht_find(const struct hash_table_s *ht, word key,
+                           GC_bool live)
+{
+    word *p = GC_ht_probe(ht, FALSE, key, live);
+
+    return p != NULL ? p : GC_ht_probe(ht, TRUE, key, live);
+}
+
+/* Delete the given live entry.  The rest of the words are cleared not  */
+/* to retain the client data of a finalizer.                            */
+GC_INLINE void GC_ht_delete(const struct hash_table_s *ht, word *p)
+{
+    BZERO(p + 1, (ht -> entry_words - 1) * sizeof(word));
+}
+
+/* Return an empty or deleted slot of the current table for the key.    */
+/* The table should not be full.                                        */
+STATIC word *GC_ht_free_slot(struct hash_table_s *ht, word key)
+{
+    word mask = ((word)1 << ht -> log_size) - 1;
+    word i;
+
+    for (i = HT_HASH(key, ht -> log_size); ; i = (i + 1) & mask) {
+        word *p = ht -> slots + i * ht -> entry_words;
+
+        if (0 == p[1]) {
+            if (0 == p[0]) ht -> used++;
+            return p;
+        }
+    }
+}
+
+/* Move up to n old_slots to the current table.  The old table is       */
+/* freed once all its entries are moved.                                */
+STATIC void GC_ht_move_entries(struct hash_table_s *ht, word n)
+{
+    word old_size = HT_SIZE(ht -> log_old_size);
+
+    if (NULL == ht -> old_slots) return;
+    for (; n > 0 && ht -> moved < old_size; n--, ht -> moved++) {
+        word *p = ht -> old_slots + ht -> moved * ht -> entry_words;
+
+        if (p[1] != 0) {
+            BCOPY(p, GC_ht_free_slot(ht, p[0]),
+                  ht -> entry_words * sizeof(word));
+            GC_ht_delete(ht, p);
+        }
+    }
+    if (ht -> moved == old_size) {
+        word *old_slots = ht -> old_slots;
+
+        ht -> old_slots = NULL;
+        ht -> log_old_size = -1;
+        ht -> moved = 0;
+        GC_INTERNAL_FREE(old_slots);
+    }
+}
+
+/* Replace the current table with a new one (sized for the given        */
+/* number of the live entries), the old one is moved later.  May be a   */
+/* no-op (if out of memory).  May collect (before changing anything).   */
+STATIC GC_bool GC_ht_resize(struct hash_table_s *ht, word entries)
+{
+    signed_word log_new_size = HT_MIN_LOG_SIZE;
+    word new_size;
+    size_t bytes;
+    word *new_slots;
+
+    /* Finish moving the previous table first (normally, it is already  */
+    /* done as the move step is big enough).                            */
+    GC_ht_move_entries(ht, ~(word)0);
+    while (((word)1 << log_new_size) < 2 * (entries + 1))
+        log_new_size++;
+    new_size = (word)1 << log_new_size;
+    bytes = (size_t)new_size * ht -> entry_words * sizeof(word);
+    new_slots = (word *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(bytes, ht -> kind);
+    if (NULL == new_slots) return FALSE;
+    if (PTRFREE == ht -> kind) BZERO(new_slots, bytes);
+
+    GC_ASSERT(NULL == ht -> old_slots);
+    if (ht -> slots != NULL) {
+        word old_size = (word)1 << ht -> log_size;
+
+        ht -> old_slots = ht -> slots;
+        ht -> log_old_size = ht -> log_size;
+        /* At least new_size/4 insertions are needed to load the new    */
+        /* table up to 3/4 since it is at most half full after moving.  */
+        ht -> move_step = 4 * old_size / new_size + 1;
+        if (ht -> move_step < HT_MIN_MOVE_STEP)
+            ht -> move_step = HT_MIN_MOVE_STEP;
+    }
+    ht -> slots = new_slots;
+    ht -> log_size = log_new_size;
+    ht -> used = 0;
+    GC_COND_LOG_PRINTF("Resized %s table to %lu entries\n", ht -> name,
+                       (unsigned long)new_size);
+    return TRUE;
+}
+
+/* Allocate a slot for the key (which is not in the table), given the   */
+/* number of the live entries.  Only the key is stored; the caller      */
+/* should set the rest of the entry (the second word is zero till       */
+/* then).  Returns NULL if out of memory.  May collect.                 */
+STATIC word *GC_ht_insert(struct hash_table_s *ht, word key, word entries)
+{
+    word *p;
+
+    GC_ht_move_entries(ht, ht -> move_step);
+    if ((ht -> used + 1) * 4 > 3 * HT_SIZE(ht -> log_size)
+        && !GC_ht_resize(ht, entries)
+        && ht -> used + 1 >= HT_SIZE(ht -> log_size)) {
+        /* No room for the entry (the last empty slot terminates the    */
+        /* probe sequences).                                            */
+        return NULL;
+    }
+    p = GC_ht_free_slot(ht, key);
+    p[0] = key;
+    return p;
+}
+
+/* Called with the lock held once GC_ht_insert has failed.  Give the    */
+/* client a chance to free some memory by calling GC_oom_fn (without    */
+/* the lock, as it was done when each entry was allocated separately);  */
+/* the returned object is not used, as the table needs a bigger one.    */
+/* Returns FALSE with the lock released if GC_oom_fn fails, otherwise   */
+/* the caller should look up the key again (with the lock reacquired).  */
+STATIC GC_bool GC_ht_oom_retry(const struct hash_table_s *ht)
+{
+    GC_oom_func oom_fn = GC_oom_fn;
+    size_t bytes = ht -> entry_words * sizeof(word);
+    void *p;
+    DCL_LOCK_STATE;
+
+    UNLOCK();
+    p = (*oom_fn)(bytes);
+    if (NULL == p) return FALSE;
+#   ifndef DBG_HDRS_ALL
+      GC_free(p);
+#   endif
+    LOCK();
+    return TRUE;
+}
+
 struct disappearing_link {
-    struct hash_chain_entry prolog;
-#   define dl_hidden_link prolog.hidden_key
-                                /* Field to be cleared.         */
-#   define dl_next(x) (struct disappearing_link *)((x) -> prolog.next)
-#   define dl_set_next(x, y) \
-                (void)((x)->prolog.next = (struct hash_chain_entry *)(y))
+    word dl_hidden_link;        /* Field to be cleared.         */
     word dl_hidden_obj;         /* Pointer to object base       */
 };
 
 struct dl_hashtbl_s {
-    struct disappearing_link **head;
-    signed_word log_size;
+    struct hash_table_s table;
     word entries;
 };
 
 STATIC struct dl_hashtbl_s GC_dl_hashtbl = {
-    /* head */ NULL, /* log_size */ -1, /* entries */ 0 };
+    HT_INITIALIZER(struct disappearing_link, PTRFREE, "dl"),
+    /* entries */ 0 };
 #ifndef GC_LONG_REFS_NOT_NEEDED
-  STATIC struct dl_hashtbl_s GC_ll_hashtbl = { NULL, -1, 0 };
+  STATIC struct dl_hashtbl_s GC_ll_hashtbl = {
+    HT_INITIALIZER(struct disappearing_link, PTRFREE, "ll"), 0 };
 #endif
 
-STATIC struct finalizable_object {
-    struct hash_chain_entry prolog;
-#   define fo_hidden_base prolog.hidden_key
-                                /* Pointer to object base.      */
+/* The ephemerons are kept as the disappearing links (the link object   */
+/* is the key, and the value is *link).                                 */
+STATIC struct dl_hashtbl_s GC_eph_hashtbl = {
+    HT_INITIALIZER(struct disappearing_link, PTRFREE, "ephemeron"), 0 };
+
+struct finalizable_object {
+    word fo_hidden_base;        /* Pointer to object base.      */
                                 /* No longer hidden once object */
-                                /* is on finalize_now queue.    */
-#   define fo_next(x) (struct finalizable_object *)((x) -> prolog.next)
-#   define fo_set_next(x,y) ((x)->prolog.next = (struct hash_chain_entry *)(y))
+                                /* is in GC_ready.              */
     GC_finalization_proc fo_fn; /* Finalizer.                   */
     ptr_t fo_client_data;
     word fo_object_size;        /* In bytes.                    */
     finalization_mark_proc fo_mark_proc;        /* Mark-through procedure */
-} **GC_fo_head = 0;
-
-STATIC struct finalizable_object * GC_finalize_now = 0;
-        /* List of objects that should be finalized now.        */
+};
 
-static signed_word log_fo_table_size = -1;
+STATIC struct hash_table_s GC_fo_table =
+        HT_INITIALIZER(struct finalizable_object, NORMAL, "fo");
+                /* Unlike the disappearing links, the client data of    */
+                /* the finalizers should be traced.                     */
+
+/* The objects that should be finalized now are kept in a ring buffer   */
+/* (in the order of enqueueing).  The ring is never grown during a      */
+/* collection; if it is full, then the rest of the unreachable          */
+/* finalizable objects are kept till the next collection (and the ring  */
+/* is grown by GC_notify_or_invoke_finalizers).                         */
+STATIC struct finalizable_object * GC_ready = NULL;
+STATIC word GC_ready_size = 0;
+STATIC word GC_ready_first = 0;
+STATIC word GC_ready_count = 0;
+STATIC word GC_ready_deferred = 0;
+                        /* The number of the objects not enqueued by    */
+                        /* the last collection for the lack of room.    */
+
+#define READY_MIN_SIZE 64
+#define READY_SLOT(i) GC_ready[(GC_ready_first + (i)) % GC_ready_size]
+
+#ifndef FINALIZER_BATCH_SIZE
+# define FINALIZER_BATCH_SIZE 64
+#endif
 
-GC_INNER void GC_push_finalizer_structures(void)
+/* Make room for n more objects in the ring (if possible).  May         */
+/* collect.  Lock is held.                                              */
+STATIC void GC_reserve_ready(word n)
 {
-    GC_ASSERT((word)&GC_dl_hashtbl.head % sizeof(word) == 0);
-    GC_ASSERT((word)&GC_fo_head % sizeof(word) == 0);
-    GC_ASSERT((word)&GC_finalize_now % sizeof(word) == 0);
+    while (GC_ready_count + n > GC_ready_size) {
+      word new_size = GC_ready_size > 0 ? GC_ready_size : READY_MIN_SIZE;
+      struct finalizable_object * new_ready;
+      word i;
+
+      while (new_size < GC_ready_count + n)
+        new_size *= 2;
+      new_ready = (struct finalizable_object *)
+                GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+                        (size_t)new_size * sizeof(struct finalizable_object),
+                        NORMAL);
+      if (NULL == new_ready) return;
+      if (GC_ready_count > new_size) {
+        /* More objects are enqueued by a collection meanwhile.  */
+        continue;
+      }
+      for (i = 0; i < GC_ready_count; i++)
+        new_ready[i] = READY_SLOT(i);
+      if (GC_ready != NULL) GC_INTERNAL_FREE(GC_ready);
+      GC_ready = new_ready;
+      GC_ready_size = new_size;
+      GC_ready_first = 0;
+    }
+}
 
-# ifndef GC_LONG_REFS_NOT_NEEDED
-    GC_ASSERT((word)&GC_ll_hashtbl.head % sizeof(word) == 0);
-    GC_push_all((ptr_t)(&GC_ll_hashtbl.head),
-                (ptr_t)(&GC_ll_hashtbl.head) + sizeof(word));
-# endif
+#ifdef FINALIZER_THREADS
+# define FINALIZER_SEGMENTS 32
+
+  /* GC_finalizer_cv and GC_finalizer_work_wanted are protected by      */
+  /* GC_finalizer_lock.  The allocation lock may be held while          */
+  /* acquiring it, but not vice versa.                                  */
+  static pthread_mutex_t GC_finalizer_lock = PTHREAD_MUTEX_INITIALIZER;
+  static pthread_cond_t GC_finalizer_cv = PTHREAD_COND_INITIALIZER;
+                        /* Signalled when there is work for the idle    */
+                        /* finalizer threads.                           */
+
+  STATIC GC_bool GC_finalizer_work_wanted = FALSE;
+                        /* There are objects ready for finalization.    */
+                        /* Cleared by an idle finalizer thread while    */
+                        /* holding the allocation lock too, thus no     */
+                        /* wakeup is lost.                              */
+
+  /* The rest is protected by the allocation lock.      */
+
+  STATIC unsigned GC_finalizer_threads = 0;
+                        /* The number of the finalizer threads started. */
+
+  /* The ready objects are split into segments, one per a collection    */
+  /* which enqueued some, so that the time since the objects of a batch */
+  /* were enqueued is known.  If there are too many segments, the last  */
+  /* one is extended (thus overestimating the latency).                 */
+  struct finalizer_segment {
+    word fs_count;
+    CLOCK_TYPE fs_enqueue_time;
+  };
+  STATIC struct finalizer_segment GC_finalizer_segments[FINALIZER_SEGMENTS];
+  STATIC unsigned GC_finalizer_first_segment = 0;
+  STATIC unsigned GC_finalizer_n_segments = 0;
+
+  /* Statistics (see GC_prof_stats_s).  */
+  STATIC word GC_finalizer_queue_max_length = 0;
+  STATIC word GC_finalizer_thread_runs = 0;
+  STATIC word GC_finalizer_batches = 0;
+  STATIC word GC_finalizer_latency_ms_sum = 0;
+  STATIC word GC_finalizer_latency_ms_max = 0;
+
+  /* Account count objects just enqueued.       */
+  STATIC void GC_add_finalizer_segment(word count)
+  {
+    CLOCK_TYPE now;
 
-    GC_push_all((ptr_t)(&GC_dl_hashtbl.head),
-                (ptr_t)(&GC_dl_hashtbl.head) + sizeof(word));
-    GC_push_all((ptr_t)(&GC_fo_head), (ptr_t)(&GC_fo_head) + sizeof(word));
-    GC_push_all((ptr_t)(&GC_finalize_now),
-                (ptr_t)(&GC_finalize_now) + sizeof(word));
-}
+    GET_TIME(now);
+    if (GC_finalizer_n_segments < FINALIZER_SEGMENTS) {
+      struct finalizer_segment *seg = &GC_finalizer_segments[
+                (GC_finalizer_first_segment + GC_finalizer_n_segments)
+                % FINALIZER_SEGMENTS];
 
-/* Double the size of a hash table. *size_ptr is the log of its current */
-/* size.  May be a no-op.                                               */
-/* *table is a pointer to an array of hash headers.  If we succeed, we  */
-/* update both *table and *log_size_ptr.  Lock is held.                 */
-STATIC void GC_grow_table(struct hash_chain_entry ***table,
-                          signed_word *log_size_ptr)
-{
-    register word i;
-    register struct hash_chain_entry *p;
-    signed_word log_old_size = *log_size_ptr;
-    signed_word log_new_size = log_old_size + 1;
-    word old_size = ((log_old_size == -1)? 0: (1 << log_old_size));
-    word new_size = (word)1 << log_new_size;
-    /* FIXME: Power of 2 size often gets rounded up to one more page. */
-    struct hash_chain_entry **new_table = (struct hash_chain_entry **)
-        GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
-                (size_t)new_size * sizeof(struct hash_chain_entry *), NORMAL);
-
-    if (new_table == 0) {
-        if (*table == 0) {
-            ABORT("Insufficient space for initial table allocation");
-        } else {
-            return;
-        }
+      seg -> fs_count = count;
+      seg -> fs_enqueue_time = now;
+      GC_finalizer_n_segments++;
+    } else {
+      GC_finalizer_segments[(GC_finalizer_first_segment
+                             + FINALIZER_SEGMENTS - 1)
+                            % FINALIZER_SEGMENTS].fs_count += count;
     }
-    for (i = 0; i < old_size; i++) {
-      p = (*table)[i];
-      while (p != 0) {
-        ptr_t real_key = GC_REVEAL_POINTER(p -> hidden_key);
-        struct hash_chain_entry *next = p -> next;
-        size_t new_hash = HASH3(real_key, new_size, log_new_size);
-
-        p -> next = new_table[new_hash];
-        new_table[new_hash] = p;
-        p = next;
+    if (GC_ready_count > GC_finalizer_queue_max_length)
+      GC_finalizer_queue_max_length = GC_ready_count;
+  }
+
+  /* Account count objects just taken from the head of the ring.        */
+  STATIC void GC_remove_finalizer_segments(word count)
+  {
+    while (count > 0 && GC_finalizer_n_segments > 0) {
+      struct finalizer_segment *seg =
+                        &GC_finalizer_segments[GC_finalizer_first_segment];
+
+      if (seg -> fs_count > count) {
+        seg -> fs_count -= count;
+        break;
       }
+      count -= seg -> fs_count;
+      GC_finalizer_first_segment =
+                (GC_finalizer_first_segment + 1) % FINALIZER_SEGMENTS;
+      GC_finalizer_n_segments--;
+    }
+  }
+#endif /* FINALIZER_THREADS */
+
+/* Append the given (unreachable) entry to the ring, which should not   */
+/* be full.                                                             */
+GC_INLINE void GC_enqueue_ready(const struct finalizable_object *curr_fo)
+{
+    struct finalizable_object *ready_fo;
+
+    GC_ASSERT(GC_ready_count < GC_ready_size);
+    ready_fo = &READY_SLOT(GC_ready_count);
+    *ready_fo = *curr_fo;
+    /* unhide object pointer so any future collections will see it.     */
+    ready_fo -> fo_hidden_base =
+                        (word)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+    GC_ready_count++;
+}
+
+/* Move up to n objects from the head of the ring to buf.  Returns the  */
+/* number of the objects moved.  Lock is held.                          */
+STATIC unsigned GC_take_ready(struct finalizable_object *buf, unsigned n)
+{
+    unsigned i;
+
+    if (n > GC_ready_count) n = (unsigned)GC_ready_count;
+    for (i = 0; i < n; i++) {
+        struct finalizable_object *curr_fo = &GC_ready[GC_ready_first];
+
+        buf[i] = *curr_fo;
+        BZERO(curr_fo, sizeof(struct finalizable_object));
+        GC_ready_first = (GC_ready_first + 1) % GC_ready_size;
     }
-    *log_size_ptr = log_new_size;
-    *table = new_table;
+    GC_ready_count -= n;
+#   ifdef FINALIZER_THREADS
+      GC_remove_finalizer_segments(n);
+#   endif
+    return n;
+}
+
+GC_INNER void GC_push_finalizer_structures(void)
+{
+    GC_ASSERT((word)&GC_dl_hashtbl.table.slots % sizeof(word) == 0);
+    GC_ASSERT((word)&GC_fo_table.slots % sizeof(word) == 0);
+    GC_ASSERT((word)&GC_ready % sizeof(word) == 0);
+
+# ifndef GC_LONG_REFS_NOT_NEEDED
+    GC_ASSERT((word)&GC_ll_hashtbl.table.slots % sizeof(word) == 0);
+    GC_push_all((ptr_t)(&GC_ll_hashtbl.table.slots),
+                (ptr_t)(&GC_ll_hashtbl.table.slots) + 2 * sizeof(word));
+# endif
+
+    GC_push_all((ptr_t)(&GC_dl_hashtbl.table.slots),
+                (ptr_t)(&GC_dl_hashtbl.table.slots) + 2 * sizeof(word));
+    GC_push_all((ptr_t)(&GC_eph_hashtbl.table.slots),
+                (ptr_t)(&GC_eph_hashtbl.table.slots) + 2 * sizeof(word));
+    GC_push_all((ptr_t)(&GC_fo_table.slots),
+                (ptr_t)(&GC_fo_table.slots) + 2 * sizeof(word));
+    GC_push_all((ptr_t)(&GC_ready), (ptr_t)(&GC_ready) + sizeof(word));
 }
 
 GC_API int GC_CALL GC_register_disappearing_link(void * * link)
@@ -149,60 +505,32 @@ STATIC int GC_register_disappearing_link_inner(
                         const void *obj)
 {
     struct disappearing_link *curr_dl;
-    size_t index;
-    struct disappearing_link * new_dl;
+    GC_bool may_retry = TRUE;
     DCL_LOCK_STATE;
 
     LOCK();
     GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
-    if (dl_hashtbl -> log_size == -1
-        || dl_hashtbl -> entries > ((word)1 << dl_hashtbl -> log_size)) {
-        GC_grow_table((struct hash_chain_entry ***)&dl_hashtbl -> head,
-                      &dl_hashtbl -> log_size);
-        GC_COND_LOG_PRINTF("Grew dl table to %u entries\n",
-                           1 << (unsigned)dl_hashtbl -> log_size);
-    }
-    index = HASH2(link, dl_hashtbl -> log_size);
-    for (curr_dl = dl_hashtbl -> head[index]; curr_dl != 0;
-         curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-            curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-            UNLOCK();
-            return GC_DUPLICATE;
-        }
-    }
-    new_dl = (struct disappearing_link *)
-        GC_INTERNAL_MALLOC(sizeof(struct disappearing_link),NORMAL);
-    if (0 == new_dl) {
-      GC_oom_func oom_fn = GC_oom_fn;
-      UNLOCK();
-      new_dl = (struct disappearing_link *)
-                (*oom_fn)(sizeof(struct disappearing_link));
-      if (0 == new_dl) {
+    for (;;) {
+      curr_dl = (struct disappearing_link *)GC_ht_find(&dl_hashtbl -> table,
+                                        GC_HIDE_POINTER(link), TRUE);
+      if (curr_dl != NULL) {
+        curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
+        UNLOCK();
+        return GC_DUPLICATE;
+      }
+      curr_dl = (struct disappearing_link *)GC_ht_insert(&dl_hashtbl -> table,
+                                GC_HIDE_POINTER(link), dl_hashtbl -> entries);
+      if (EXPECT(curr_dl != NULL, TRUE)) break;
+      if (!may_retry) {
+        UNLOCK();
         return GC_NO_MEMORY;
       }
+      may_retry = FALSE;
+      if (!GC_ht_oom_retry(&dl_hashtbl -> table)) return GC_NO_MEMORY;
       /* It's not likely we'll make it here, but ... */
-      LOCK();
-      /* Recalculate index since the table may grow.    */
-      index = HASH2(link, dl_hashtbl -> log_size);
-      /* Check again that our disappearing link not in the table. */
-      for (curr_dl = dl_hashtbl -> head[index]; curr_dl != 0;
-           curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-          curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-          UNLOCK();
-#         ifndef DBG_HDRS_ALL
-            /* Free unused new_dl returned by GC_oom_fn() */
-            GC_free((void *)new_dl);
-#         endif
-          return GC_DUPLICATE;
-        }
-      }
+      /* Check again that our disappearing link is not in the table. */
     }
-    new_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
-    new_dl -> dl_hidden_link = GC_HIDE_POINTER(link);
-    dl_set_next(new_dl, dl_hashtbl -> head[index]);
-    dl_hashtbl -> head[index] = new_dl;
+    curr_dl -> dl_hidden_obj = GC_HIDE_POINTER(obj);
     dl_hashtbl -> entries++;
     UNLOCK();
     return GC_SUCCESS;
@@ -216,51 +544,30 @@ GC_API int GC_CALL GC_general_register_disappearing_link(void * * link,
     return GC_register_disappearing_link_inner(&GC_dl_hashtbl, link, obj);
 }
 
-#ifdef DBG_HDRS_ALL
-# define FREE_DL_ENTRY(curr_dl) dl_set_next(curr_dl, NULL)
-#else
-# define FREE_DL_ENTRY(curr_dl) GC_free(curr_dl)
-#endif
-
-/* Unregisters given link and returns the link entry to free.   */
+/* Unregisters given link.  Returns 1 if it was registered.     */
 /* Assume the lock is held.                                     */
-GC_INLINE struct disappearing_link *GC_unregister_disappearing_link_inner(
+GC_INLINE int GC_unregister_disappearing_link_inner(
                                 struct dl_hashtbl_s *dl_hashtbl, void **link)
 {
-    struct disappearing_link *curr_dl;
-    struct disappearing_link *prev_dl = NULL;
-    size_t index = HASH2(link, dl_hashtbl->log_size);
-
-    for (curr_dl = dl_hashtbl -> head[index]; curr_dl;
-         curr_dl = dl_next(curr_dl)) {
-        if (curr_dl -> dl_hidden_link == GC_HIDE_POINTER(link)) {
-            /* Remove found entry from the table. */
-            if (NULL == prev_dl) {
-                dl_hashtbl -> head[index] = dl_next(curr_dl);
-            } else {
-                dl_set_next(prev_dl, dl_next(curr_dl));
-            }
-            dl_hashtbl -> entries--;
-            break;
-        }
-        prev_dl = curr_dl;
-    }
-    return curr_dl;
+    word *p = GC_ht_find(&dl_hashtbl -> table, GC_HIDE_POINTER(link), TRUE);
+
+    if (NULL == p) return 0;
+    GC_ht_delete(&dl_hashtbl -> table, p);
+    dl_hashtbl -> entries--;
+    return 1;
 }
 
 GC_API int GC_CALL GC_unregister_disappearing_link(void * * link)
 {
-    struct disappearing_link *curr_dl;
+    int result;
     DCL_LOCK_STATE;
 
     if (((word)link & (ALIGNMENT-1)) != 0) return(0); /* Nothing to do. */
 
     LOCK();
-    curr_dl = GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
+    result = GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
     UNLOCK();
-    if (NULL == curr_dl) return 0;
-    FREE_DL_ENTRY(curr_dl);
-    return 1;
+    return result;
 }
 
 #ifndef GC_LONG_REFS_NOT_NEEDED
@@ -273,43 +580,50 @@ GC_API int GC_CALL GC_unregister_disappearing_link(void * * link)
 
   GC_API int GC_CALL GC_unregister_long_link(void * * link)
   {
-    struct disappearing_link *curr_dl;
+    int result;
     DCL_LOCK_STATE;
 
     if (((word)link & (ALIGNMENT-1)) != 0) return(0); /* Nothing to do. */
 
     LOCK();
-    curr_dl = GC_unregister_disappearing_link_inner(&GC_ll_hashtbl, link);
+    result = GC_unregister_disappearing_link_inner(&GC_ll_hashtbl, link);
     UNLOCK();
-    if (NULL == curr_dl) return 0;
-    FREE_DL_ENTRY(curr_dl);
-    return 1;
+    return result;
   }
 #endif /* !GC_LONG_REFS_NOT_NEEDED */
 
+GC_API int GC_CALL GC_register_ephemeron(void * * link, const void * key)
+{
+    if (((word)link & (ALIGNMENT-1)) != 0)
+        ABORT("Bad arg to GC_register_ephemeron");
+    return GC_register_disappearing_link_inner(&GC_eph_hashtbl, link, key);
+}
+
+GC_API int GC_CALL GC_unregister_ephemeron(void * * link)
+{
+    int result;
+    DCL_LOCK_STATE;
+
+    if (((word)link & (ALIGNMENT-1)) != 0) return(0); /* Nothing to do. */
+
+    LOCK();
+    result = GC_unregister_disappearing_link_inner(&GC_eph_hashtbl, link);
+    UNLOCK();
+    return result;
+}
+
 #ifndef GC_MOVE_DISAPPEARING_LINK_NOT_NEEDED
   /* Moves a link.  Assume the lock is held.    */
   STATIC int GC_move_disappearing_link_inner(
                                 struct dl_hashtbl_s *dl_hashtbl,
                                 void **link, void **new_link)
   {
-    struct disappearing_link *curr_dl, *prev_dl, *new_dl;
-    size_t curr_index, new_index;
-    word curr_hidden_link;
+    struct disappearing_link *curr_dl, *new_dl;
+    word curr_hidden_link = GC_HIDE_POINTER(link);
     word new_hidden_link;
 
     /* Find current link.       */
-    curr_index = HASH2(link, dl_hashtbl -> log_size);
-    curr_hidden_link = GC_HIDE_POINTER(link);
-    prev_dl = NULL;
-    for (curr_dl = dl_hashtbl -> head[curr_index]; curr_dl;
-         curr_dl = dl_next(curr_dl)) {
-      if (curr_dl -> dl_hidden_link == curr_hidden_link)
-        break;
-      prev_dl = curr_dl;
-    }
-
-    if (NULL == curr_dl) {
+    if (NULL == GC_ht_find(&dl_hashtbl -> table, curr_hidden_link, TRUE)) {
       return GC_NOT_FOUND;
     }
 
@@ -318,25 +632,27 @@ GC_API int GC_CALL GC_unregister_disappearing_link(void * * link)
     }
 
     /* link found; now check new_link not present.      */
-    new_index = HASH2(new_link, dl_hashtbl -> log_size);
     new_hidden_link = GC_HIDE_POINTER(new_link);
-    for (new_dl = dl_hashtbl -> head[new_index]; new_dl;
-         new_dl = dl_next(new_dl)) {
-      if (new_dl -> dl_hidden_link == new_hidden_link) {
-        /* Target already registered; bail.     */
-        return GC_DUPLICATE;
-      }
+    if (GC_ht_find(&dl_hashtbl -> table, new_hidden_link, TRUE) != NULL) {
+      /* Target already registered; bail.     */
+      return GC_DUPLICATE;
     }
 
-    /* Remove from old, add to new, update link.        */
-    if (NULL == prev_dl) {
-      dl_hashtbl -> head[curr_index] = dl_next(curr_dl);
-    } else {
-      dl_set_next(prev_dl, dl_next(curr_dl));
+    /* Add new, then remove old (the insertion may move the entries).   */
+    new_dl = (struct disappearing_link *)GC_ht_insert(&dl_hashtbl -> table,
+                                new_hidden_link, dl_hashtbl -> entries);
+    if (NULL == new_dl) {
+      return GC_NO_MEMORY;
+    }
+    curr_dl = (struct disappearing_link *)GC_ht_find(&dl_hashtbl -> table,
+                                                curr_hidden_link, TRUE);
+    if (EXPECT(NULL == curr_dl, FALSE)) {
+      /* The link has been cleared by a collection during the   */
+      /* insertion; new_dl remains deleted.                     */
+      return GC_NOT_FOUND;
     }
-    curr_dl -> dl_hidden_link = new_hidden_link;
-    dl_set_next(curr_dl, dl_hashtbl -> head[new_index]);
-    dl_hashtbl -> head[new_index] = curr_dl;
+    new_dl -> dl_hidden_obj = curr_dl -> dl_hidden_obj;
+    GC_ht_delete(&dl_hashtbl -> table, (word *)curr_dl);
     return GC_SUCCESS;
   }
 
@@ -387,8 +703,10 @@ STATIC void GC_normal_finalize_mark_proc(ptr_t p)
 
 /* This only pays very partial attention to the mark descriptor.        */
 /* It does the right thing for normal and atomic objects, and treats    */
-/* most others as normal.                                               */
-STATIC void GC_ignore_self_finalize_mark_proc(ptr_t p)
+/* most others as normal.  Pushes onto the given mark stack, and        */
+/* returns the new top.                                                 */
+STATIC mse * GC_push_ignoring_self(ptr_t p, mse *mark_stack_top,
+                                   mse *mark_stack_limit)
 {
     hdr * hhdr = HDR(p);
     word descr = hhdr -> hb_descr;
@@ -405,9 +723,20 @@ STATIC void GC_ignore_self_finalize_mark_proc(ptr_t p)
     for (q = p; (word)q <= (word)scan_limit; q += ALIGNMENT) {
         r = *(word *)q;
         if (r < (word)p || r > (word)target_limit) {
-            GC_PUSH_ONE_HEAP(r, q, GC_mark_stack_top);
+            FIXUP_POINTER(r);
+            if (r >= (word)GC_least_plausible_heap_addr
+                && r < (word)GC_greatest_plausible_heap_addr)
+              mark_stack_top = GC_mark_and_push((void *)r, mark_stack_top,
+                                                mark_stack_limit, (void **)q);
         }
     }
+    return mark_stack_top;
+}
+
+STATIC void GC_ignore_self_finalize_mark_proc(ptr_t p)
+{
+    GC_mark_stack_top = GC_push_ignoring_self(p, GC_mark_stack_top,
+                                              GC_mark_stack_limit);
 }
 
 STATIC void GC_null_finalize_mark_proc(ptr_t p GC_ATTR_UNUSED) {}
@@ -436,119 +765,74 @@ STATIC void GC_register_finalizer_inner(void * obj,
                                         finalization_mark_proc mp)
 {
     ptr_t base;
-    struct finalizable_object * curr_fo, * prev_fo;
-    size_t index;
-    struct finalizable_object *new_fo = 0;
-    hdr *hhdr = NULL; /* initialized to prevent warning. */
-    GC_oom_func oom_fn;
+    struct finalizable_object * curr_fo;
+    hdr *hhdr;
+    GC_bool may_retry = TRUE;
     DCL_LOCK_STATE;
 
     LOCK();
-    if (log_fo_table_size == -1
-        || GC_fo_entries > ((word)1 << log_fo_table_size)) {
-        GC_grow_table((struct hash_chain_entry ***)&GC_fo_head,
-                      &log_fo_table_size);
-        GC_COND_LOG_PRINTF("Grew fo table to %u entries\n",
-                           1 << (unsigned)log_fo_table_size);
-    }
     /* in the THREADS case we hold allocation lock.             */
     base = (ptr_t)obj;
-    for (;;) {
-      index = HASH2(base, log_fo_table_size);
-      prev_fo = 0;
-      curr_fo = GC_fo_head[index];
-      while (curr_fo != 0) {
-        GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
-        if (curr_fo -> fo_hidden_base == GC_HIDE_POINTER(base)) {
-          /* Interruption by a signal in the middle of this     */
-          /* should be safe.  The client may see only *ocd      */
-          /* updated, but we'll declare that to be his problem. */
-          if (ocd) *ocd = (void *) (curr_fo -> fo_client_data);
-          if (ofn) *ofn = curr_fo -> fo_fn;
-          /* Delete the structure for base. */
-          if (prev_fo == 0) {
-            GC_fo_head[index] = fo_next(curr_fo);
-          } else {
-            fo_set_next(prev_fo, fo_next(curr_fo));
-          }
-          if (fn == 0) {
-            GC_fo_entries--;
-            /* May not happen if we get a signal.  But a high   */
-            /* estimate will only make the table larger than    */
-            /* necessary.                                       */
-#           if !defined(THREADS) && !defined(DBG_HDRS_ALL)
-              GC_free((void *)curr_fo);
-#           endif
-          } else {
-            curr_fo -> fo_fn = fn;
-            curr_fo -> fo_client_data = (ptr_t)cd;
-            curr_fo -> fo_mark_proc = mp;
-            /* Reinsert it.  We deleted it first to maintain    */
-            /* consistency in the event of a signal.            */
-            if (prev_fo == 0) {
-              GC_fo_head[index] = curr_fo;
-            } else {
-              fo_set_next(prev_fo, curr_fo);
-            }
-          }
-          UNLOCK();
-#         ifndef DBG_HDRS_ALL
-            if (EXPECT(new_fo != 0, FALSE)) {
-              /* Free unused new_fo returned by GC_oom_fn() */
-              GC_free((void *)new_fo);
-            }
-#         endif
-          return;
+  retry:
+    curr_fo = (struct finalizable_object *)GC_ht_find(&GC_fo_table,
+                                                GC_HIDE_POINTER(base), TRUE);
+    if (curr_fo != 0) {
+        /* Interruption by a signal in the middle of this     */
+        /* should be safe.  The client may see only *ocd      */
+        /* updated, but we'll declare that to be his problem. */
+        if (ocd) *ocd = (void *) (curr_fo -> fo_client_data);
+        if (ofn) *ofn = curr_fo -> fo_fn;
+        if (fn == 0) {
+          GC_ht_delete(&GC_fo_table, (word *)curr_fo);
+          GC_fo_entries--;
+        } else {
+          curr_fo -> fo_fn = fn;
+          curr_fo -> fo_client_data = (ptr_t)cd;
+          curr_fo -> fo_mark_proc = mp;
         }
-        prev_fo = curr_fo;
-        curr_fo = fo_next(curr_fo);
-      }
-      if (EXPECT(new_fo != 0, FALSE)) {
-        /* new_fo is returned by GC_oom_fn(), so fn != 0 and hhdr != 0. */
-        break;
-      }
-      if (fn == 0) {
-        if (ocd) *ocd = 0;
-        if (ofn) *ofn = 0;
-        UNLOCK();
-        return;
-      }
-      GET_HDR(base, hhdr);
-      if (EXPECT(0 == hhdr, FALSE)) {
-        /* We won't collect it, hence finalizer wouldn't be run. */
-        if (ocd) *ocd = 0;
-        if (ofn) *ofn = 0;
         UNLOCK();
         return;
-      }
-      new_fo = (struct finalizable_object *)
-        GC_INTERNAL_MALLOC(sizeof(struct finalizable_object),NORMAL);
-      if (EXPECT(new_fo != 0, TRUE))
-        break;
-      oom_fn = GC_oom_fn;
+    }
+    if (fn == 0) {
+      if (ocd) *ocd = 0;
+      if (ofn) *ofn = 0;
       UNLOCK();
-      new_fo = (struct finalizable_object *)
-                (*oom_fn)(sizeof(struct finalizable_object));
-      if (0 == new_fo) {
-        /* No enough memory.  *ocd and *ofn remains unchanged.  */
-        return;
+      return;
+    }
+    GET_HDR(base, hhdr);
+    if (EXPECT(0 == hhdr, FALSE)) {
+      /* We won't collect it, hence finalizer wouldn't be run. */
+      if (ocd) *ocd = 0;
+      if (ofn) *ofn = 0;
+      UNLOCK();
+      return;
+    }
+    curr_fo = (struct finalizable_object *)GC_ht_insert(&GC_fo_table,
+                                        GC_HIDE_POINTER(base), GC_fo_entries);
+    if (EXPECT(0 == curr_fo, FALSE)) {
+      if (may_retry) {
+        may_retry = FALSE;
+        if (GC_ht_oom_retry(&GC_fo_table)) {
+          /* It's not likely we'll make it here, but ...        */
+          /* Check again that our finalizer is not in the table. */
+          goto retry;
+        }
+      } else {
+        UNLOCK();
       }
-      /* It's not likely we'll make it here, but ... */
-      LOCK();
-      /* Recalculate index since the table may grow and         */
-      /* check again that our finalizer is not in the table.    */
+      /* No enough memory.  *ocd and *ofn remains unchanged.  */
+      return;
     }
-    GC_ASSERT(GC_size(new_fo) >= sizeof(struct finalizable_object));
     if (ocd) *ocd = 0;
     if (ofn) *ofn = 0;
-    new_fo -> fo_hidden_base = GC_HIDE_POINTER(base);
-    new_fo -> fo_fn = fn;
-    new_fo -> fo_client_data = (ptr_t)cd;
-    new_fo -> fo_object_size = hhdr -> hb_sz;
-    new_fo -> fo_mark_proc = mp;
-    fo_set_next(new_fo, GC_fo_head[index]);
+    curr_fo -> fo_fn = fn;
+    curr_fo -> fo_client_data = (ptr_t)cd;
+    curr_fo -> fo_object_size = hhdr -> hb_sz;
+    curr_fo -> fo_mark_proc = mp;
     GC_fo_entries++;
-    GC_fo_head[index] = new_fo;
+    /* Usually, a collection finds a fraction of the finalizable        */
+    /* objects unreachable, the rest is deferred (see GC_ready).        */
+    GC_reserve_ready(GC_fo_entries / 4 + 1);
     UNLOCK();
 }
 
@@ -593,28 +877,22 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
   STATIC void GC_dump_finalization_links(
                                 const struct dl_hashtbl_s *dl_hashtbl)
   {
-    struct disappearing_link *curr_dl;
+    word *p;
     ptr_t real_ptr, real_link;
-    size_t dl_size = dl_hashtbl->log_size == -1 ? 0 :
-                                1 << dl_hashtbl->log_size;
-    size_t i;
 
-    for (i = 0; i < dl_size; i++) {
-      for (curr_dl = dl_hashtbl -> head[i]; curr_dl != 0;
-           curr_dl = dl_next(curr_dl)) {
+    HT_ITERATE_BEGIN(&dl_hashtbl -> table, p)
+        struct disappearing_link *curr_dl = (struct disappearing_link *)p;
+
         real_ptr = GC_REVEAL_POINTER(curr_dl -> dl_hidden_obj);
         real_link = GC_REVEAL_POINTER(curr_dl -> dl_hidden_link);
         GC_printf("Object: %p, link: %p\n", real_ptr, real_link);
-      }
-    }
+    HT_ITERATE_END
   }
 
   void GC_dump_finalization(void)
   {
-    struct finalizable_object * curr_fo;
-    size_t fo_size = log_fo_table_size == -1 ? 0 : 1 << log_fo_table_size;
+    word *p;
     ptr_t real_ptr;
-    size_t i;
 
     GC_printf("Disappearing (short) links:\n");
     GC_dump_finalization_links(&GC_dl_hashtbl);
@@ -622,14 +900,14 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
       GC_printf("Disappearing long links:\n");
       GC_dump_finalization_links(&GC_ll_hashtbl);
 #   endif
+    GC_printf("Ephemerons (key, link):\n");
+    GC_dump_finalization_links(&GC_eph_hashtbl);
     GC_printf("Finalizers:\n");
-    for (i = 0; i < fo_size; i++) {
-      for (curr_fo = GC_fo_head[i]; curr_fo != 0;
-           curr_fo = fo_next(curr_fo)) {
-        real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+    HT_ITERATE_BEGIN(&GC_fo_table, p)
+        real_ptr = GC_REVEAL_POINTER(
+                        ((struct finalizable_object *)p) -> fo_hidden_base);
         GC_printf("Finalizable object: %p\n", real_ptr);
-      }
-    }
+    HT_ITERATE_END
   }
 #endif /* !NO_DEBUGGING */
 
@@ -668,67 +946,308 @@ GC_API void GC_CALL GC_register_finalizer_unreachable(void * obj,
   }
 #endif /* THREADS */
 
-#define ITERATE_DL_HASHTBL_BEGIN(dl_hashtbl, curr_dl, prev_dl) \
-  { \
-    size_t i; \
-    size_t dl_size = dl_hashtbl->log_size == -1 ? 0 : \
-                                1 << dl_hashtbl->log_size; \
-    for (i = 0; i < dl_size; i++) { \
-      curr_dl = dl_hashtbl -> head[i]; \
-      prev_dl = NULL; \
-      while (curr_dl) {
-
-#define ITERATE_DL_HASHTBL_END(curr_dl, prev_dl) \
-        prev_dl = curr_dl; \
-        curr_dl = dl_next(curr_dl); \
-      } \
-    } \
-  }
-
-#define DELETE_DL_HASHTBL_ENTRY(dl_hashtbl, curr_dl, prev_dl, next_dl) \
-  { \
-    next_dl = dl_next(curr_dl); \
-    if (NULL == prev_dl) { \
-        dl_hashtbl -> head[i] = next_dl; \
-    } else { \
-        dl_set_next(prev_dl, next_dl); \
-    } \
-    GC_clear_mark_bit(curr_dl); \
-    dl_hashtbl -> entries--; \
-    curr_dl = next_dl; \
-    continue; \
-  }
-
 GC_INLINE void GC_make_disappearing_links_disappear(
                                 struct dl_hashtbl_s* dl_hashtbl)
 {
-    struct disappearing_link *curr, *prev, *next;
+    word *p;
     ptr_t real_ptr, real_link;
 
-    ITERATE_DL_HASHTBL_BEGIN(dl_hashtbl, curr, prev)
+    HT_ITERATE_BEGIN(&dl_hashtbl -> table, p)
+        struct disappearing_link *curr = (struct disappearing_link *)p;
+
         real_ptr = GC_REVEAL_POINTER(curr -> dl_hidden_obj);
         real_link = GC_REVEAL_POINTER(curr -> dl_hidden_link);
         if (!GC_is_marked(real_ptr)) {
             *(word *)real_link = 0;
-            GC_clear_mark_bit(curr);
-            DELETE_DL_HASHTBL_ENTRY(dl_hashtbl, curr, prev, next);
+            GC_ht_delete(&dl_hashtbl -> table, p);
+            dl_hashtbl -> entries--;
         }
-    ITERATE_DL_HASHTBL_END(curr, prev)
+    HT_ITERATE_END
 }
 
 GC_INLINE void GC_remove_dangling_disappearing_links(
                                 struct dl_hashtbl_s* dl_hashtbl)
 {
-    struct disappearing_link *curr, *prev, *next;
+    word *p;
     ptr_t real_link;
 
-    ITERATE_DL_HASHTBL_BEGIN(dl_hashtbl, curr, prev)
+    HT_ITERATE_BEGIN(&dl_hashtbl -> table, p)
+        struct disappearing_link *curr = (struct disappearing_link *)p;
+
         real_link = GC_base(GC_REVEAL_POINTER(curr -> dl_hidden_link));
         if (NULL != real_link && !GC_is_marked(real_link)) {
-            GC_clear_mark_bit(curr);
-            DELETE_DL_HASHTBL_ENTRY(dl_hashtbl, curr, prev, next);
+            GC_ht_delete(&dl_hashtbl -> table, p);
+            dl_hashtbl -> entries--;
+        }
+    HT_ITERATE_END
+}
+
+/* If the key of the given ephemeron and the object containing its     */
+/* link (if any) are marked, but the value (*link) is not, then mark    */
+/* the value and push its contents onto the given mark stack (updating  */
+/* *ptop), and return TRUE.                                             */
+STATIC GC_bool GC_push_ephemeron_value(const struct disappearing_link *curr,
+                                       mse **ptop, mse *mark_stack_limit)
+{
+    ptr_t real_link = GC_REVEAL_POINTER(curr -> dl_hidden_link);
+    ptr_t holder, value, value_base;
+
+    if (!GC_is_marked(GC_REVEAL_POINTER(curr -> dl_hidden_obj)))
+        return FALSE;
+    holder = (ptr_t)GC_base(real_link);
+    if (holder != NULL && !GC_is_marked(holder))
+        return FALSE;
+    value = *(ptr_t *)real_link;
+    value_base = (ptr_t)GC_base(value);
+    if (NULL == value_base || GC_is_marked(value_base))
+        return FALSE;
+    *ptop = GC_mark_and_push(value, *ptop, mark_stack_limit,
+                             (void **)real_link);
+    return TRUE;
+}
+
+#if defined(PARALLEL_FINALIZE) && !defined(PARALLEL_MARK)
+# undef PARALLEL_FINALIZE
+#endif
+
+#ifdef PARALLEL_FINALIZE
+# ifndef PARALLEL_FINALIZE_MIN_ENTRIES
+#   define PARALLEL_FINALIZE_MIN_ENTRIES 4096
+# endif
+# define FO_CHUNK_SLOTS 1024
+                /* The number of GC_fo_table slots claimed at once.     */
+# define FO_MARK_STACK_SIZE HBLKSIZE
+                /* The number of entries in the mark stack of each      */
+                /* marker (the same as the local mark stack size).      */
+
+  STATIC mse *GC_fo_mark_stacks = NULL;
+                /* The mark stacks, one per marker (GC_markers_m1 + 1).  */
+                /* Allocated on the first use.                          */
+  STATIC unsigned GC_fo_n_mark_stacks = 0;
+
+  STATIC volatile AO_t GC_fo_next_mark_stack = 0;
+                /* The index of the first mark stack (and the header    */
+                /* cache of the same index) not claimed yet by a marker */
+                /* running the current task.                            */
+
+  STATIC volatile AO_t GC_fo_next_slot = 0;
+                /* The first GC_fo_table (or GC_eph_hashtbl) slot not   */
+                /* claimed yet (the slots of the old table follow the   */
+                /* current ones).                                       */
+
+  STATIC volatile AO_t GC_eph_value_marked = 0;
+                /* Some ephemeron value was marked by the markers.      */
+
+# define FO_MAX_CYCLE_REPORTS 64
+  STATIC word GC_fo_cycles[FO_MAX_CYCLE_REPORTS];
+                /* The (hidden) finalizable objects found marked after  */
+                /* marking from them, i.e. the finalization cycles; the */
+                /* markers do not call the warning procedure directly.  */
+  STATIC volatile AO_t GC_fo_n_cycles = 0;
+
+  /* Claim a mark stack and a header cache for the exclusive use of the */
+  /* calling marker during the current task.  These are not indexed by  */
+  /* the marker id, so that each one has a single owner whatever the    */
+  /* ids are.  Returns NULL if there is no one left.                    */
+  STATIC mse *GC_claim_fo_mark_stack(hdr_cache_t **phc)
+  {
+    word k = (word)AO_fetch_and_add1(&GC_fo_next_mark_stack);
+
+    if (k >= GC_fo_n_mark_stacks) return NULL;
+    *phc = GC_marker_hdr_cache((unsigned)k);
+    return GC_fo_mark_stacks + k * FO_MARK_STACK_SIZE;
+  }
+
+  /* Mark from the unmarked finalizable objects in the slot chunks      */
+  /* claimed by the marker, using its own mark stack.  The pointees     */
+  /* of each object are pushed the same way as its fo_mark_proc does.   */
+  /* Gives up once a mark stack overflow is signalled (by any marker).  */
+  STATIC void GC_mark_fo_slots(unsigned id GC_ATTR_UNUSED)
+  {
+    hdr_cache_t *hc;
+    mse *local_mark_stack = GC_claim_fo_mark_stack(&hc);
+    mse *local_limit;
+    word n_slots = HT_SIZE(GC_fo_table.log_size)
+                        + HT_SIZE(GC_fo_table.log_old_size);
+
+    if (NULL == local_mark_stack) return;
+    local_limit = local_mark_stack + FO_MARK_STACK_SIZE;
+    for (;;) {
+      word i = (word)AO_fetch_and_add(&GC_fo_next_slot, FO_CHUNK_SLOTS);
+      word end_slot = i + FO_CHUNK_SLOTS;
+
+      if (i >= n_slots) break;
+      if (end_slot > n_slots) end_slot = n_slots;
+      for (; i < end_slot; i++) {
+        struct finalizable_object * curr_fo =
+                (struct finalizable_object *)HT_SLOT_AT(&GC_fo_table, i);
+        ptr_t real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
+        finalization_mark_proc mark_proc = curr_fo -> fo_mark_proc;
+        mse *my_top = local_mark_stack - 1;
+
+        if (0 == curr_fo -> fo_fn) continue; /* empty, deleted or moved */
+        if (GC_mark_state != MS_NONE) return;
+        if (GC_is_marked(real_ptr)) continue;
+        GC_MARKED_FOR_FINALIZATION(real_ptr);
+        if (mark_proc == GC_null_finalize_mark_proc) continue;
+        if (mark_proc == GC_ignore_self_finalize_mark_proc) {
+          my_top = GC_push_ignoring_self(real_ptr, my_top, local_limit);
+        } else {
+          hdr * hhdr = HDR(real_ptr);
+
+          GC_ASSERT(mark_proc == GC_normal_finalize_mark_proc
+                    || mark_proc == GC_unreachable_finalize_mark_proc);
+          PUSH_OBJ(real_ptr, hhdr, my_top, local_limit);
+        }
+        while ((word)my_top >= (word)local_mark_stack) {
+          my_top = GC_mark_from(my_top, local_mark_stack, local_limit, hc);
+        }
+        if (GC_is_marked(real_ptr)) {
+          word k = (word)AO_fetch_and_add1(&GC_fo_n_cycles);
+
+          if (k < FO_MAX_CYCLE_REPORTS)
+            GC_fo_cycles[k] = GC_HIDE_POINTER(real_ptr);
+        }
+      }
+    }
+  }
+
+  /* Report the finalization cycles found by GC_mark_fo_slots the same  */
+  /* way as GC_finalize does.                                           */
+  STATIC void GC_report_fo_cycles(void)
+  {
+    word i;
+    word n = (word)AO_load(&GC_fo_n_cycles);
+
+    for (i = 0; i < n && i < FO_MAX_CYCLE_REPORTS; i++) {
+      WARN("Finalization cycle involving %p\n",
+           GC_REVEAL_POINTER(GC_fo_cycles[i]));
+    }
+    if (n > FO_MAX_CYCLE_REPORTS)
+      WARN("%" WARN_PRIdPTR " more finalization cycles not reported\n",
+           n - FO_MAX_CYCLE_REPORTS);
+    AO_store(&GC_fo_n_cycles, 0);
+  }
+
+  /* Same as GC_mark_fo_slots but for a round of the ephemeron values  */
+  /* marking.                                                           */
+  STATIC void GC_mark_eph_slots(unsigned id GC_ATTR_UNUSED)
+  {
+    hdr_cache_t *hc;
+    mse *local_mark_stack = GC_claim_fo_mark_stack(&hc);
+    mse *local_limit;
+    word n_slots = HT_SIZE(GC_eph_hashtbl.table.log_size)
+                        + HT_SIZE(GC_eph_hashtbl.table.log_old_size);
+
+    if (NULL == local_mark_stack) return;
+    local_limit = local_mark_stack + FO_MARK_STACK_SIZE;
+    for (;;) {
+      word i = (word)AO_fetch_and_add(&GC_fo_next_slot, FO_CHUNK_SLOTS);
+      word end_slot = i + FO_CHUNK_SLOTS;
+
+      if (i >= n_slots) break;
+      if (end_slot > n_slots) end_slot = n_slots;
+      for (; i < end_slot; i++) {
+        struct disappearing_link *curr = (struct disappearing_link *)
+                                HT_SLOT_AT(&GC_eph_hashtbl.table, i);
+        mse *my_top = local_mark_stack - 1;
+
+        if (0 == curr -> dl_hidden_obj) continue; /* empty or deleted */
+        if (GC_mark_state != MS_NONE) return;
+        if (!GC_push_ephemeron_value(curr, &my_top, local_limit)) continue;
+        AO_store(&GC_eph_value_marked, TRUE);
+        while ((word)my_top >= (word)local_mark_stack) {
+          my_top = GC_mark_from(my_top, local_mark_stack, local_limit, hc);
+        }
+      }
+    }
+  }
+
+  /* Do the reachability pass of GC_finalize (if task is                */
+  /* GC_mark_fo_slots) or a round of the ephemeron values marking (if   */
+  /* GC_mark_eph_slots) on the marker threads.  Marking from the        */
+  /* finalizable objects in any order yields the same set of marked     */
+  /* objects, thus the ordering is not affected.  Returns FALSE if the  */
+  /* pass should be redone sequentially (after a mark stack overflow,   */
+  /* the marking is completed first).                                   */
+  STATIC GC_bool GC_parallel_mark_fo(void (*task)(unsigned))
+  {
+#   ifndef SMALL_CONFIG
+      CLOCK_TYPE start_time = 0; /* initialized to prevent warning. */
+      CLOCK_TYPE done_time;
+#   endif
+
+    if (NULL == GC_fo_mark_stacks) {
+      GC_fo_mark_stacks = (mse *)GC_scratch_alloc(
+                                (GC_markers_m1 + 1) * FO_MARK_STACK_SIZE
+                                * sizeof(mse));
+      if (NULL == GC_fo_mark_stacks) return FALSE;
+      GC_fo_n_mark_stacks = (unsigned)GC_markers_m1 + 1;
+    }
+#   ifndef SMALL_CONFIG
+      if (GC_print_stats == VERBOSE)
+        GET_TIME(start_time);
+#   endif
+    AO_store(&GC_fo_next_slot, 0);
+    AO_store(&GC_fo_next_mark_stack, 0);
+    GC_run_on_markers(task);
+    GC_report_fo_cycles();
+#   ifndef SMALL_CONFIG
+      if (GC_print_stats == VERBOSE) {
+        GET_TIME(done_time);
+        GC_verbose_log_printf(
+                        "Parallel finalization marking took %lu msecs\n",
+                        MS_TIME_DIFF(done_time,start_time));
+      }
+#   endif
+    if (GC_mark_state != MS_NONE) {
+      /* Some pointees were dropped; rescan the marked objects.  The    */
+      /* finalizable object being processed may be left unmarked (with  */
+      /* some of its pointees not pushed), so the pass is redone.       */
+      while (!GC_mark_some((ptr_t)0)) { /* empty */ }
+      return FALSE;
+    }
+    return TRUE;
+  }
+#endif /* PARALLEL_FINALIZE */
+
+/* Mark the values of the ephemerons whose keys (and the objects        */
+/* holding the links) are marked, repeating until no more values are    */
+/* marked (as a value may hold the key of another ephemeron).           */
+STATIC void GC_mark_ephemeron_values(void)
+{
+    GC_bool marked_some;
+    word *p;
+
+    if (0 == GC_eph_hashtbl.entries) return;
+    GC_ASSERT(GC_mark_state == MS_NONE);
+    do {
+      marked_some = FALSE;
+#     ifdef PARALLEL_FINALIZE
+        if (GC_parallel
+            && GC_eph_hashtbl.entries >= PARALLEL_FINALIZE_MIN_ENTRIES) {
+          AO_store(&GC_eph_value_marked, FALSE);
+          if (!GC_parallel_mark_fo(GC_mark_eph_slots)
+              || AO_load(&GC_eph_value_marked)) {
+            marked_some = TRUE;
+          }
+          continue;
         }
-    ITERATE_DL_HASHTBL_END(curr, prev)
+#     endif
+      HT_ITERATE_BEGIN(&GC_eph_hashtbl.table, p)
+        mse *top = GC_mark_stack_top;
+
+        if (GC_push_ephemeron_value((struct disappearing_link *)p, &top,
+                                    GC_mark_stack_limit)) {
+          marked_some = TRUE;
+          GC_mark_stack_top = top;
+          while (!GC_mark_stack_empty()) MARK_FROM_MARK_STACK();
+          if (GC_mark_state != MS_NONE) {
+            while (!GC_mark_some((ptr_t)0)) { /* empty */ }
+          }
+        }
+      HT_ITERATE_END
+    } while (marked_some);
 }
 
 /* Called with held lock (but the world is running).                    */
@@ -736,10 +1255,11 @@ GC_INLINE void GC_remove_dangling_disappearing_links(
 /* enqueued for finalization.                                           */
 GC_INNER void GC_finalize(void)
 {
-    struct finalizable_object * curr_fo, * prev_fo, * next_fo;
+    struct finalizable_object * curr_fo;
     ptr_t real_ptr;
-    size_t i;
-    size_t fo_size = log_fo_table_size == -1 ? 0 : 1 << log_fo_table_size;
+    word *p;
+    word ready_before = GC_ready_count;
+    word i, j;
 
 #   ifndef SMALL_CONFIG
       /* Save current GC_[dl/ll]_entries value for stats printing */
@@ -749,15 +1269,22 @@ GC_INNER void GC_finalize(void)
 #     endif
 #   endif
 
+    /* The values of the ephemerons with the reachable keys are        */
+    /* reachable, thus the short links to them are not cleared.        */
+    GC_mark_ephemeron_values();
     GC_make_disappearing_links_disappear(&GC_dl_hashtbl);
 
   /* Mark all objects reachable via chains of 1 or more pointers        */
   /* from finalizable objects.                                          */
     GC_ASSERT(GC_mark_state == MS_NONE);
-    for (i = 0; i < fo_size; i++) {
-      for (curr_fo = GC_fo_head[i]; curr_fo != 0;
-           curr_fo = fo_next(curr_fo)) {
-        GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
+#   ifdef PARALLEL_FINALIZE
+      if (GC_parallel && GC_fo_entries >= PARALLEL_FINALIZE_MIN_ENTRIES
+          && GC_parallel_mark_fo(GC_mark_fo_slots)) {
+        /* Done, including the finalization cycles report.      */
+      } else
+#   endif
+    /* else */ HT_ITERATE_BEGIN(&GC_fo_table, p)
+        curr_fo = (struct finalizable_object *)p;
         real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
         if (!GC_is_marked(real_ptr)) {
             GC_MARKED_FOR_FINALIZATION(real_ptr);
@@ -766,52 +1293,39 @@ GC_INNER void GC_finalize(void)
                 WARN("Finalization cycle involving %p\n", real_ptr);
             }
         }
-      }
-    }
+    HT_ITERATE_END
   /* Enqueue for finalization all objects that are still                */
   /* unreachable.                                                       */
     GC_bytes_finalized = 0;
-    for (i = 0; i < fo_size; i++) {
-      curr_fo = GC_fo_head[i];
-      prev_fo = 0;
-      while (curr_fo != 0) {
+    HT_ITERATE_BEGIN(&GC_fo_table, p)
+        curr_fo = (struct finalizable_object *)p;
         real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
         if (!GC_is_marked(real_ptr)) {
+            if (GC_ready_count == GC_ready_size) {
+              /* No room; keep the object (and everything reachable     */
+              /* from it) till the next collection.                     */
+              GC_MARK_FO(real_ptr, GC_normal_finalize_mark_proc);
+              GC_set_mark_bit(real_ptr);
+              GC_ready_deferred++;
+              continue;
+            }
             if (!GC_java_finalization) {
               GC_set_mark_bit(real_ptr);
             }
-            /* Delete from hash table */
-              next_fo = fo_next(curr_fo);
-              if (prev_fo == 0) {
-                GC_fo_head[i] = next_fo;
-              } else {
-                fo_set_next(prev_fo, next_fo);
-              }
-              GC_fo_entries--;
-            /* Add to list of objects awaiting finalization.    */
-              fo_set_next(curr_fo, GC_finalize_now);
-              GC_finalize_now = curr_fo;
-              /* unhide object pointer so any future collections will   */
-              /* see it.                                                */
-              curr_fo -> fo_hidden_base =
-                        (word)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
-              GC_bytes_finalized +=
+            GC_enqueue_ready(curr_fo);
+            GC_bytes_finalized +=
                         curr_fo -> fo_object_size
                         + sizeof(struct finalizable_object);
-            GC_ASSERT(GC_is_marked(GC_base(curr_fo)));
-            curr_fo = next_fo;
-        } else {
-            prev_fo = curr_fo;
-            curr_fo = fo_next(curr_fo);
+            GC_ht_delete(&GC_fo_table, p);
+            GC_fo_entries--;
         }
-      }
-    }
+    HT_ITERATE_END
 
   if (GC_java_finalization) {
     /* make sure we mark everything reachable from objects finalized
        using the no_order mark_proc */
-      for (curr_fo = GC_finalize_now;
-         curr_fo != NULL; curr_fo = fo_next(curr_fo)) {
+      for (i = ready_before; i < GC_ready_count; i++) {
+        curr_fo = &READY_SLOT(i);
         real_ptr = (ptr_t)curr_fo -> fo_hidden_base;
         if (!GC_is_marked(real_ptr)) {
             if (curr_fo -> fo_mark_proc == GC_null_finalize_mark_proc) {
@@ -826,37 +1340,44 @@ GC_INNER void GC_finalize(void)
     /* now revive finalize-when-unreachable objects reachable from
        other finalizable objects */
       if (need_unreachable_finalization) {
-        curr_fo = GC_finalize_now;
-        prev_fo = 0;
-        while (curr_fo != 0) {
-          next_fo = fo_next(curr_fo);
+        for (i = j = ready_before; i < GC_ready_count; i++) {
+          curr_fo = &READY_SLOT(i);
           if (curr_fo -> fo_mark_proc == GC_unreachable_finalize_mark_proc) {
             real_ptr = (ptr_t)curr_fo -> fo_hidden_base;
             if (!GC_is_marked(real_ptr)) {
               GC_set_mark_bit(real_ptr);
             } else {
-              if (prev_fo == 0)
-                GC_finalize_now = next_fo;
-              else
-                fo_set_next(prev_fo, next_fo);
-
-              curr_fo -> fo_hidden_base =
-                                GC_HIDE_POINTER(curr_fo -> fo_hidden_base);
-              GC_bytes_finalized -=
+              /* Put it back to its (deleted) slot.     */
+              p = GC_ht_find(&GC_fo_table, GC_HIDE_POINTER(real_ptr), FALSE);
+              GC_ASSERT(p != NULL);
+              if (EXPECT(p != NULL, TRUE)) {
+                curr_fo -> fo_hidden_base = GC_HIDE_POINTER(real_ptr);
+                *(struct finalizable_object *)p = *curr_fo;
+                GC_bytes_finalized -=
                   curr_fo->fo_object_size + sizeof(struct finalizable_object);
-
-              i = HASH2(real_ptr, log_fo_table_size);
-              fo_set_next (curr_fo, GC_fo_head[i]);
-              GC_fo_entries++;
-              GC_fo_head[i] = curr_fo;
-              curr_fo = prev_fo;
+                GC_fo_entries++;
+                continue;
+              }
             }
           }
-          prev_fo = curr_fo;
-          curr_fo = next_fo;
+          if (j != i) READY_SLOT(j) = *curr_fo;
+          j++;
         }
+        for (i = j; i < GC_ready_count; i++)
+          BZERO(&READY_SLOT(i), sizeof(struct finalizable_object));
+        GC_ready_count = j;
       }
   }
+# ifdef FINALIZER_THREADS
+    if (GC_ready_count > ready_before)
+      GC_add_finalizer_segment(GC_ready_count - ready_before);
+# endif
+
+  /* The keys could be resurrected by the finalization, their values    */
+  /* are kept too.  The rest of the ephemerons are cleared.             */
+  GC_mark_ephemeron_values();
+  GC_make_disappearing_links_disappear(&GC_eph_hashtbl);
+  GC_remove_dangling_disappearing_links(&GC_eph_hashtbl);
 
   GC_remove_dangling_disappearing_links(&GC_dl_hashtbl);
 # ifndef GC_LONG_REFS_NOT_NEEDED
@@ -877,46 +1398,38 @@ GC_INNER void GC_finalize(void)
 
 #ifndef JAVA_FINALIZATION_NOT_NEEDED
 
-  /* Enqueue all remaining finalizers to be run - Assumes lock is held. */
+  /* Enqueue all remaining finalizers to be run (as many as the ring    */
+  /* can hold) - Assumes lock is held.                                  */
   STATIC void GC_enqueue_all_finalizers(void)
   {
-    struct finalizable_object * curr_fo, * prev_fo, * next_fo;
-    ptr_t real_ptr;
-    register int i;
-    int fo_size;
+    word *p;
+#   ifdef FINALIZER_THREADS
+      word ready_before;
+#   endif
 
-    fo_size = log_fo_table_size == -1 ? 0 : 1 << log_fo_table_size;
+    GC_reserve_ready(GC_fo_entries);
+#   ifdef FINALIZER_THREADS
+      ready_before = GC_ready_count;
+#   endif
     GC_bytes_finalized = 0;
-    for (i = 0; i < fo_size; i++) {
-        curr_fo = GC_fo_head[i];
-        prev_fo = 0;
-      while (curr_fo != 0) {
-          real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
-          GC_MARK_FO(real_ptr, GC_normal_finalize_mark_proc);
-          GC_set_mark_bit(real_ptr);
-
-          /* Delete from hash table */
-          next_fo = fo_next(curr_fo);
-          if (prev_fo == 0) {
-              GC_fo_head[i] = next_fo;
-          } else {
-              fo_set_next(prev_fo, next_fo);
-          }
-          GC_fo_entries--;
+    HT_ITERATE_BEGIN(&GC_fo_table, p)
+        struct finalizable_object * curr_fo = (struct finalizable_object *)p;
+        ptr_t real_ptr = GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
 
-          /* Add to list of objects awaiting finalization.      */
-          fo_set_next(curr_fo, GC_finalize_now);
-          GC_finalize_now = curr_fo;
+        if (GC_ready_count == GC_ready_size) break;
+        GC_MARK_FO(real_ptr, GC_normal_finalize_mark_proc);
+        GC_set_mark_bit(real_ptr);
 
-          /* unhide object pointer so any future collections will       */
-          /* see it.                                                    */
-          curr_fo -> fo_hidden_base =
-                        (word)GC_REVEAL_POINTER(curr_fo -> fo_hidden_base);
-          GC_bytes_finalized +=
+        GC_enqueue_ready(curr_fo);
+        GC_bytes_finalized +=
                 curr_fo -> fo_object_size + sizeof(struct finalizable_object);
-          curr_fo = next_fo;
-        }
-    }
+        GC_ht_delete(&GC_fo_table, p);
+        GC_fo_entries--;
+    HT_ITERATE_END
+#   ifdef FINALIZER_THREADS
+      if (GC_ready_count > ready_before)
+        GC_add_finalizer_segment(GC_ready_count - ready_before);
+#   endif
   }
 
   /* Invoke all remaining finalizers that haven't yet been run.
@@ -940,6 +1453,8 @@ GC_INNER void GC_finalize(void)
     LOCK();
     while (GC_fo_entries > 0) {
       GC_enqueue_all_finalizers();
+      if (EXPECT(0 == GC_ready_count, FALSE))
+        break; /* Out of memory.        */
       UNLOCK();
       GC_invoke_finalizers();
       /* Running the finalizers in this thread is arguably not a good   */
@@ -958,19 +1473,38 @@ GC_INNER void GC_finalize(void)
 /* getting into that safe state is expensive.)                          */
 GC_API int GC_CALL GC_should_invoke_finalizers(void)
 {
-    return GC_finalize_now != 0;
+    return GC_ready_count != 0;
+}
+
+/* Run the finalizers of the given objects (taken from the ring).  The  */
+/* rest of the objects are kept visible to the collector (by the        */
+/* caller stack) while a finalizer runs.                                */
+STATIC void GC_run_finalizers(struct finalizable_object *batch, unsigned n)
+{
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        struct finalizable_object * curr_fo = &batch[i];
+
+        (*(curr_fo -> fo_fn))((ptr_t)(curr_fo -> fo_hidden_base),
+                              curr_fo -> fo_client_data);
+        curr_fo -> fo_hidden_base = 0;
+        curr_fo -> fo_client_data = 0;
+    }
 }
 
 /* Invoke finalizers for all objects that are ready to be finalized.    */
 /* Should be called without allocation lock.                            */
 GC_API int GC_CALL GC_invoke_finalizers(void)
 {
-    struct finalizable_object * curr_fo;
+    struct finalizable_object batch[FINALIZER_BATCH_SIZE];
     int count = 0;
     word bytes_freed_before = 0; /* initialized to prevent warning. */
     DCL_LOCK_STATE;
 
-    while (GC_finalize_now != 0) {
+    while (GC_ready_count != 0) {
+        unsigned n;
+
 #       ifdef THREADS
             LOCK();
 #       endif
@@ -978,25 +1512,12 @@ GC_API int GC_CALL GC_invoke_finalizers(void)
             bytes_freed_before = GC_bytes_freed;
             /* Don't do this outside, since we need the lock. */
         }
-        curr_fo = GC_finalize_now;
+        n = GC_take_ready(batch, FINALIZER_BATCH_SIZE);
 #       ifdef THREADS
-            if (curr_fo != 0) GC_finalize_now = fo_next(curr_fo);
             UNLOCK();
-            if (curr_fo == 0) break;
-#       else
-            GC_finalize_now = fo_next(curr_fo);
-#       endif
-        fo_set_next(curr_fo, 0);
-        (*(curr_fo -> fo_fn))((ptr_t)(curr_fo -> fo_hidden_base),
-                              curr_fo -> fo_client_data);
-        curr_fo -> fo_client_data = 0;
-        ++count;
-#       ifdef UNDEFINED
-            /* This is probably a bad idea.  It throws off accounting if */
-            /* nearly all objects are finalizable.  O.w. it shouldn't    */
-            /* matter.                                                   */
-            GC_free((void *)curr_fo);
 #       endif
+        GC_run_finalizers(batch, n);
+        count += (int)n;
     }
     /* bytes_freed_before is initialized whenever count != 0 */
     if (count != 0 && bytes_freed_before != GC_bytes_freed) {
@@ -1020,7 +1541,7 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
 #   if defined(THREADS) && !defined(KEEP_BACK_PTRS) \
        && !defined(MAKE_BACK_GRAPH)
       /* Quick check (while unlocked) for an empty finalization queue.  */
-      if (GC_finalize_now == 0) return;
+      if (GC_ready_count == 0 && GC_ready_deferred == 0) return;
 #   endif
     LOCK();
 
@@ -1052,11 +1573,29 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
 #       endif
       }
 #   endif
-    if (GC_finalize_now == 0) {
+    if (GC_ready_deferred > 0) {
+      /* Make room for the objects left by the last collection.         */
+      word n = GC_ready_deferred;
+
+      GC_ready_deferred = 0;
+      GC_reserve_ready(n);
+    }
+    if (GC_ready_count == 0) {
       UNLOCK();
       return;
     }
 
+#   ifdef FINALIZER_THREADS
+      if (GC_finalizer_threads > 0) {
+        UNLOCK();
+        pthread_mutex_lock(&GC_finalizer_lock);
+        GC_finalizer_work_wanted = TRUE;
+        pthread_cond_signal(&GC_finalizer_cv);
+        pthread_mutex_unlock(&GC_finalizer_lock);
+        return;
+      }
+#   endif
+
     if (!GC_finalize_on_demand) {
       unsigned char *pnested = GC_check_finalizer_nested();
       UNLOCK();
@@ -1065,7 +1604,7 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
         (void) GC_invoke_finalizers();
         *pnested = 0; /* Reset since no more finalizers. */
 #       ifndef THREADS
-          GC_ASSERT(GC_finalize_now == 0);
+          GC_ASSERT(GC_ready_count == 0);
 #       endif   /* Otherwise GC can run concurrently and add more */
       }
       return;
@@ -1081,6 +1620,127 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
         (*notifier_fn)(); /* Invoke the notifier */
 }
 
+#ifdef FINALIZER_THREADS
+  STATIC void * GC_CALLBACK GC_finalizer_thread_inner(
+                                        struct GC_stack_base *sb,
+                                        void *arg GC_ATTR_UNUSED)
+  {
+    DCL_LOCK_STATE;
+
+    /* The thread is already registered unless pthread_create is not    */
+    /* redirected.                                                      */
+    (void)GC_register_my_thread(sb);
+    for (;;) {
+      struct finalizable_object batch[FINALIZER_BATCH_SIZE];
+      word bytes_freed_before;
+      unsigned count;
+      unsigned long latency = 0;
+
+      LOCK();
+      if (0 == GC_ready_count) {
+        pthread_mutex_lock(&GC_finalizer_lock);
+        GC_finalizer_work_wanted = FALSE;
+        UNLOCK();
+        while (!GC_finalizer_work_wanted)
+          pthread_cond_wait(&GC_finalizer_cv, &GC_finalizer_lock);
+        pthread_mutex_unlock(&GC_finalizer_lock);
+        continue;
+      }
+      if (GC_finalizer_n_segments > 0) {
+        CLOCK_TYPE now;
+
+        GET_TIME(now);
+        latency = MS_TIME_DIFF(now, GC_finalizer_segments[
+                                  GC_finalizer_first_segment].fs_enqueue_time);
+      }
+      count = GC_take_ready(batch, FINALIZER_BATCH_SIZE);
+      GC_finalizer_batches++;
+      GC_finalizer_latency_ms_sum += latency;
+      if (latency > GC_finalizer_latency_ms_max)
+        GC_finalizer_latency_ms_max = latency;
+      if (GC_ready_count > 0) {
+        /* Let another thread take the next batch.      */
+        pthread_mutex_lock(&GC_finalizer_lock);
+        pthread_cond_signal(&GC_finalizer_cv);
+        pthread_mutex_unlock(&GC_finalizer_lock);
+      }
+      bytes_freed_before = GC_bytes_freed;
+      UNLOCK();
+
+      GC_run_finalizers(batch, count);
+
+      LOCK();
+      GC_finalizer_thread_runs += count;
+      GC_finalizer_bytes_freed += (GC_bytes_freed - bytes_freed_before);
+      UNLOCK();
+    }
+    return NULL; /* unreachable */
+  }
+
+  STATIC void * GC_finalizer_thread(void *arg)
+  {
+    return GC_call_with_stack_base(GC_finalizer_thread_inner, arg);
+  }
+
+  GC_INNER void GC_fill_finalizer_stats(struct GC_prof_stats_s *pstats)
+  {
+    pstats->finalizer_queue_length = GC_ready_count;
+    pstats->finalizer_queue_max_length = GC_finalizer_queue_max_length;
+    pstats->finalizer_thread_runs = GC_finalizer_thread_runs;
+    pstats->finalizer_batches = GC_finalizer_batches;
+    pstats->finalizer_latency_ms_sum = GC_finalizer_latency_ms_sum;
+    pstats->finalizer_latency_ms_max = GC_finalizer_latency_ms_max;
+  }
+
+  /* Called (with the allocation lock held) in the child after fork.    */
+  /* The finalizer threads are gone, so the finalizers of the ready     */
+  /* objects are left for GC_invoke_finalizers.                         */
+  GC_INNER void GC_finalizer_threads_fork_child(void)
+  {
+    (void)pthread_mutex_init(&GC_finalizer_lock, NULL);
+    (void)pthread_cond_init(&GC_finalizer_cv, NULL);
+    GC_finalizer_threads = 0;
+    GC_finalizer_work_wanted = FALSE;
+  }
+#endif /* FINALIZER_THREADS */
+
+#ifdef FINALIZER_THREADS
+  GC_API unsigned GC_CALL GC_start_finalizer_threads(unsigned n)
+  {
+    unsigned started = 0;
+    pthread_attr_t attr;
+    DCL_LOCK_STATE;
+
+    GC_allow_register_threads();
+    if (pthread_attr_init(&attr) != 0)
+      ABORT("pthread_attr_init failed");
+    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0)
+      ABORT("pthread_attr_setdetachstate failed");
+    for (; started < n; started++) {
+      pthread_t t;
+      int err = pthread_create(&t, &attr, GC_finalizer_thread, NULL);
+
+      if (err != 0) {
+        WARN("Finalizer thread creation failed, errno = %" WARN_PRIdPTR "\n",
+             (signed_word)err);
+        break;
+      }
+      LOCK();
+      GC_finalizer_threads++;
+      UNLOCK();
+    }
+    (void)pthread_attr_destroy(&attr);
+    GC_COND_LOG_PRINTF("Started %u finalizer threads\n", started);
+    return started;
+  }
+#else
+  GC_API unsigned GC_CALL GC_start_finalizer_threads(
+                                        unsigned n GC_ATTR_UNUSED)
+  {
+    return 0;
+  }
+#endif /* !FINALIZER_THREADS */
+
 #ifndef SMALL_CONFIG
 # ifndef GC_LONG_REFS_NOT_NEEDED
 #   define IF_LONG_REFS_PRESENT_ELSE(x,y) (x)
@@ -1090,21 +1750,18 @@ GC_INNER void GC_notify_or_invoke_finalizers(void)
 
   GC_INNER void GC_print_finalization_stats(void)
   {
-    struct finalizable_object *fo;
-    unsigned long ready = 0;
-
     GC_log_printf("%lu finalization entries;"
-                  " %lu/%lu short/long disappearing links alive\n",
+                  " %lu/%lu short/long disappearing links alive;"
+                  " %lu ephemerons\n",
                   (unsigned long)GC_fo_entries,
                   (unsigned long)GC_dl_hashtbl.entries,
                   (unsigned long)IF_LONG_REFS_PRESENT_ELSE(
-                                                GC_ll_hashtbl.entries, 0));
+                                                GC_ll_hashtbl.entries, 0),
+                  (unsigned long)GC_eph_hashtbl.entries);
 
-    for (fo = GC_finalize_now; 0 != fo; fo = fo_next(fo))
-      ++ready;
     GC_log_printf("%lu finalization-ready objects;"
                   " %ld/%ld short/long links cleared\n",
-                  ready,
+                  (unsigned long)GC_ready_count,
                   (long)GC_old_dl_entries - (long)GC_dl_hashtbl.entries,
                   (long)IF_LONG_REFS_PRESENT_ELSE(
                               GC_old_ll_entries - GC_ll_hashtbl.entries, 0));
@@ -99,7 +99,8 @@ GC_API void GC_CALL GC_register_disclaim_proc(int kind, GC_disclaim_proc proc,
         GC_DBG_COLLECT_AT_MALLOC(lb);
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_finalized_objfreelist[lg];
+        op = GC_fl_pop((void **)&GC_finalized_objfreelist[lg],
+                       GC_finalized_kind, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             op = GC_generic_malloc(lb, GC_finalized_kind);
@@ -108,7 +109,6 @@ GC_API void GC_CALL GC_register_disclaim_proc(int kind, GC_disclaim_proc proc,
             /* GC_generic_malloc has extended the size map for us.      */
             lg = GC_size_map[lb];
         } else {
-            GC_finalized_objfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             UNLOCK();
@@ -171,7 +171,8 @@ static void maybe_finalize(void)
     if(SMALL_OBJ(lb)) {
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_gcjobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_gcjobjfreelist[lg],
+                       GC_gcj_kind, lg);
         if(EXPECT(0 == op, FALSE)) {
             maybe_finalize();
             op = (ptr_t)GENERAL_MALLOC_INNER((word)lb, GC_gcj_kind);
@@ -181,7 +182,6 @@ static void maybe_finalize(void)
                 return((*oom_fn)(lb));
             }
         } else {
-            GC_gcjobjfreelist[lg] = obj_link(op);
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
         }
         *(void **)op = ptr_to_struct_containing_descr;
@@ -243,7 +243,8 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_gcj_malloc_ignore_off_page(size_t lb,
     if(SMALL_OBJ(lb)) {
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_gcjobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_gcjobjfreelist[lg],
+                       GC_gcj_kind, lg);
         if (EXPECT(0 == op, FALSE)) {
             maybe_finalize();
             op = (ptr_t)GENERAL_MALLOC_INNER_IOP(lb, GC_gcj_kind);
@@ -253,7 +254,6 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_gcj_malloc_ignore_off_page(size_t lb,
                 return((*oom_fn)(lb));
             }
         } else {
-            GC_gcjobjfreelist[lg] = obj_link(op);
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
         }
     } else {
@@ -50,7 +50,8 @@ GC_INNER hdr * GC_find_header(ptr_t h)
 /* GUARANTEED to return 0 for a pointer past the first page     */
 /* of an object unless both GC_all_interior_pointers is set     */
 /* and p is in fact a valid object pointer.                     */
-/* Never returns a pointer to a free hblk.                      */
+/* Never returns a pointer to a free hblk.  hce is the set of   */
+/* the cache to insert the found header into.                   */
 GC_INNER hdr *
 #ifdef PRINT_BLACK_LIST
   GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce, ptr_t source)
@@ -59,7 +60,6 @@ GC_INNER hdr *
 #endif
 {
   hdr *hhdr;
-  HC_MISS();
   GET_HDR(p, hhdr);
   if (IS_FORWARDING_ADDR_OR_NIL(hhdr)) {
     if (GC_all_interior_pointers) {
@@ -100,6 +100,11 @@ GC_INNER hdr *
       GC_ADD_TO_BLACK_LIST_NORMAL(p, source);
       return 0;
     } else {
+      int i;
+
+      /* Insert as the most recently used entry of the set hce. */
+      for (i = HDR_CACHE_WAYS - 1; i > 0; i--)
+        hce[i] = hce[i - 1];
       hce -> block_addr = (word)(p) >> LOG_HBLKSIZE;
       hce -> hce_hdr = hhdr;
       return hhdr;
@@ -184,10 +189,10 @@ GC_INLINE void free_hdr(hdr * hhdr)
     hdr_free_list = hhdr;
 }
 
-#ifdef COUNT_HDR_CACHE_HITS
-  /* Used for debugging/profiling (the symbols are externally visible). */
-  word GC_hdr_cache_hits = 0;
-  word GC_hdr_cache_misses = 0;
+GC_INNER word GC_hdr_cache_epoch = 1;
+
+#ifdef FLAT_HDR_TABLE
+  GC_INNER hdr **GC_flat_hdrs = NULL;
 #endif
 
 GC_INNER void GC_init_headers(void)
@@ -203,6 +208,14 @@ GC_INNER void GC_init_headers(void)
     for (i = 0; i < TOP_SZ; i++) {
         GC_top_index[i] = GC_all_nils;
     }
+#   ifdef FLAT_HDR_TABLE
+      GC_flat_hdrs = (hdr **)GC_get_sparse_mem(
+                ((word)1 << (FLAT_HDR_ADDR_BITS - LOG_HBLKSIZE)) * sizeof(hdr *));
+      if (NULL == GC_flat_hdrs) {
+        GC_err_printf("Cannot reserve the flat header table\n");
+        EXIT();
+      }
+#   endif
 }
 
 /* Make sure that there is a bottom level index block for address addr  */
@@ -218,7 +231,16 @@ static GC_bool get_index(word addr)
 #   ifdef HASH_TL
       word i = TL_HASH(hi);
       bottom_index * old;
+#   endif
 
+#   ifdef FLAT_HDR_TABLE
+      if (!FLAT_HDR_IN_RANGE(addr)) {
+        WARN("Heap block at %p is beyond the flat header table\n",
+             (void *)addr);
+        return FALSE;
+      }
+#   endif
+#   ifdef HASH_TL
       old = p = GC_top_index[i];
       while(p != GC_all_nils) {
           if (p -> key == hi) return(TRUE);
@@ -266,7 +288,8 @@ GC_INNER struct hblkhdr * GC_install_header(struct hblk *h)
     result = alloc_hdr();
     if (result) {
       SET_HDR(h, result);
-#     ifdef USE_MUNMAP
+      GC_hdr_cache_epoch++;
+#     if defined(USE_MUNMAP) || defined(LAZY_ZEROING)
         result -> hb_last_reclaimed = (unsigned short)GC_gc_no;
 #     endif
     }
@@ -293,10 +316,12 @@ GC_INNER GC_bool GC_install_counts(struct hblk *h, size_t sz/* bytes */)
 /* Remove the header for block h */
 GC_INNER void GC_remove_header(struct hblk *h)
 {
-    hdr **ha;
-    GET_HDR_ADDR(h, ha);
-    free_hdr(*ha);
-    *ha = 0;
+    hdr *hhdr;
+
+    GET_HDR(h, hhdr);
+    free_hdr(hhdr);
+    SET_HDR(h, 0);
+    GC_hdr_cache_epoch++;
 }
 
 /* Remove forwarding counts for h */
@@ -659,6 +659,40 @@ struct GC_prof_stats_s {
   GC_word reclaimed_bytes_before_gc;
             /* Approximate number of bytes reclaimed before the recent  */
             /* garbage collection.  The value may wrap.                 */
+  GC_word protect_calls;
+            /* Number of system calls made to write-protect the heap    */
+            /* (by the incremental mode), in total.  Zero unless the    */
+            /* virtual dirty bits are based on the page protection.     */
+  GC_word unprotect_calls;
+            /* Number of system calls made to unprotect the heap blocks */
+            /* being allocated (the write faults are not counted).      */
+  GC_word hdr_cache_hits;
+            /* Number of block header lookups by the markers satisfied  */
+            /* by their header caches, in total.                        */
+  GC_word hdr_cache_misses;
+            /* Number of the marker header lookups which missed the     */
+            /* cache (including those of non-heap pointer candidates).  */
+  GC_word lock_acquisitions;
+            /* Number of times the allocation lock was acquired by the  */
+            /* collector (zero unless multi-threaded).  The value may   */
+            /* wrap.                                                    */
+  GC_word finalizer_queue_length;
+            /* Number of objects ready for finalization but not taken   */
+            /* yet (by the finalizer threads, see                       */
+            /* GC_start_finalizer_threads, or GC_invoke_finalizers).    */
+  GC_word finalizer_queue_max_length;
+            /* Maximum value of finalizer_queue_length seen so far.     */
+  GC_word finalizer_thread_runs;
+            /* Number of finalizers run by the finalizer threads.       */
+  GC_word finalizer_batches;
+            /* Number of batches of objects taken by the finalizer      */
+            /* threads.                                                 */
+  GC_word finalizer_latency_ms_sum;
+            /* Sum (over the batches) of the time from enqueueing the   */
+            /* first object of a batch for finalization (by the         */
+            /* collector) to taking the batch, in milliseconds.         */
+  GC_word finalizer_latency_ms_max;
+            /* Maximum of the above latencies, in milliseconds.         */
 };
 
 /* Atomically get GC statistics (various global counters).  Clients     */
@@ -1124,6 +1158,30 @@ GC_API int GC_CALL GC_unregister_long_link(void ** /* link */);
         /* Similar to GC_unregister_disappearing_link but for a */
         /* registration by either of the above two routines.    */
 
+GC_API int GC_CALL GC_register_ephemeron(void ** /* link */,
+                                         const void * /* key */)
+                        GC_ATTR_NONNULL(1) GC_ATTR_NONNULL(2);
+        /* Register an ephemeron: *link holds the value (a      */
+        /* plain, not disguised, pointer which should be hidden */
+        /* from the collector by storing it in an "atomic"      */
+        /* object) which is kept alive by the collector as long */
+        /* as key (and the object containing link) is           */
+        /* reachable, even if the value itself references key.  */
+        /* *link is cleared when key becomes truly inaccessible */
+        /* (as for GC_register_long_link), thus the value may   */
+        /* be reclaimed then.  A value may be the key of        */
+        /* another ephemeron.  key must be a pointer to the     */
+        /* first word of an object allocated by GC_malloc or    */
+        /* friends.  *link should be accessed with the          */
+        /* allocation lock held (see GC_call_with_alloc_lock).  */
+        /* The return values are the same as for                */
+        /* GC_general_register_disappearing_link.               */
+
+GC_API int GC_CALL GC_unregister_ephemeron(void ** /* link */);
+        /* Undoes a registration by GC_register_ephemeron.      */
+        /* Returns 0 if link was not actually registered        */
+        /* (otherwise returns 1).                               */
+
 /* Returns !=0 if GC_invoke_finalizers has something to do.     */
 GC_API int GC_CALL GC_should_invoke_finalizers(void);
 
@@ -1135,6 +1193,22 @@ GC_API int GC_CALL GC_invoke_finalizers(void);
         /* GC_finalize_on_demand is nonzero, it must be called  */
         /* explicitly.                                          */
 
+GC_API unsigned GC_CALL GC_start_finalizer_threads(unsigned /* n */);
+        /* Start n dedicated threads running the finalizers.    */
+        /* Once any is started, the objects ready for           */
+        /* finalization are handed to these threads instead of  */
+        /* being finalized by the allocating thread or          */
+        /* announced by GC_finalizer_notifier                   */
+        /* (GC_finalize_on_demand is ignored).  The threads     */
+        /* take the objects in batches (from the same queue)    */
+        /* and run the finalizers concurrently, thus the        */
+        /* finalizers should be thread-safe.  The threads never */
+        /* exit.  Should be called from a registered thread     */
+        /* (implies GC_allow_register_threads).  Returns the    */
+        /* number of threads started (0 if unsupported, e.g.    */
+        /* the library is single-threaded or on Win32).  The    */
+        /* queue statistics are in GC_prof_stats_s.             */
+
 /* Explicitly tell the collector that an object is reachable    */
 /* at a particular program point.  This prevents the argument   */
 /* pointer from being optimized away, even it is otherwise no   */
@@ -1402,6 +1476,38 @@ GC_API void * GC_CALL GC_is_valid_displacement(void * /* p */);
 /* Defined only if the library has been compiled without NO_DEBUGGING.  */
 GC_API void GC_CALL GC_dump(void);
 
+/* Print the size classes of small objects: the range of the requested  */
+/* sizes mapped to each class, the number of objects per heap block,    */
+/* the maximum and average (for uniformly distributed requests)         */
+/* internal fragmentation, and the number of heap blocks in use and     */
+/* objects marked by the last collection.  Only the classes computed so */
+/* far are printed (all of them if the library is built with            */
+/* SIZE_CLASS_TABLE).  Defined only if the library has been compiled    */
+/* without NO_DEBUGGING.                                                */
+GC_API void GC_CALL GC_print_size_classes(void);
+
+/* Allocation sampling heap profiler.  If the interval is non-zero,     */
+/* roughly one GC_malloc or GC_malloc_atomic call per the given number  */
+/* of allocated bytes (chosen at random, so that larger objects are     */
+/* more likely to be sampled) records the call stack of the allocation. */
+/* Samples of the objects found unreachable by a collection (or         */
+/* deallocated explicitly) are counted as dead.  The interval could     */
+/* also be set by GC_HEAP_PROFILE_INTERVAL environment variable.        */
+/* The default is 0 (disabled).  Ignored unless the library has been    */
+/* compiled with HEAP_PROFILE (Linux only).  The setter and the getter  */
+/* are unsynchronized.                                                  */
+GC_API void GC_CALL GC_set_heap_profile_interval(GC_word /* bytes */);
+GC_API GC_word GC_CALL GC_get_heap_profile_interval(void);
+
+/* Write the sampled live (and all the sampled allocated) objects       */
+/* grouped by their allocation call stacks to the given file in the     */
+/* format understood by pprof (the legacy text "heap_v2" profile;       */
+/* the counts are those of the samples, pprof scales them using the     */
+/* sampling interval).  For the up-to-date live numbers, a collection   */
+/* should precede the call.  Returns 0 on success, -1 on failure or if  */
+/* the profiler is not supported.  Acquires the allocation lock.        */
+GC_API int GC_CALL GC_dump_heap_profile(const char * /* file_name */);
+
 /* Safer, but slow, pointer addition.  Probably useful mainly with      */
 /* a preprocessor.  Useful only for heap pointers.                      */
 /* Only the macros without trailing digits are meant to be used         */
@@ -1458,6 +1564,18 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_many(size_t /* lb */);
 #define GC_NEXT(p) (*(void * *)(p))     /* Retrieve the next element    */
                                         /* in returned list.            */
 
+/* Allocate n objects of lb bytes each (like GC_malloc or               */
+/* GC_malloc_atomic), storing them to out[0] .. out[n-1].  The lock     */
+/* (and, if applicable, thread-local free list lookup) costs are paid   */
+/* about once per heap block of objects rather than once per object.    */
+/* The out array should be visible to the collector (e.g., be on the    */
+/* stack or in the collected heap).  Returns the number of the stored   */
+/* objects, which is less than n only if out of memory.                 */
+GC_API size_t GC_CALL GC_malloc_n(size_t /* lb */, size_t /* n */,
+                                  void ** /* out */);
+GC_API size_t GC_CALL GC_malloc_atomic_n(size_t /* lb */, size_t /* n */,
+                                         void ** /* out */);
+
 /* A filter function to control the scanning of dynamic libraries.      */
 /* If implemented, called by GC before registering a dynamic library    */
 /* (discovered by GC) section as a static data root (called only as     */
@@ -95,6 +95,20 @@ inline void * GC_selective_alloc<GC_true_type>(size_t n, GC_true_type,
                           : GC_MALLOC_ATOMIC(n);
 }
 
+// The same for allocation of GC_n objects of GC_lb bytes at once.
+template <class GC_Tp>
+inline size_t GC_selective_alloc_n(size_t GC_lb, size_t GC_n, void **GC_out,
+                                   GC_Tp) {
+    return GC_malloc_n(GC_lb, GC_n, GC_out);
+}
+
+template <>
+inline size_t GC_selective_alloc_n<GC_true_type>(size_t GC_lb, size_t GC_n,
+                                                 void **GC_out,
+                                                 GC_true_type) {
+    return GC_malloc_atomic_n(GC_lb, GC_n, GC_out);
+}
+
 /* Now the public gc_allocator<T> class:
  */
 template <class GC_Tp>
@@ -245,6 +259,114 @@ inline bool operator!=(const gc_allocator_ignore_off_page<GC_T1>&, const gc_allo
   return false;
 }
 
+/* Now the public gc_batch_allocator<T> class: the same as gc_allocator<T>
+ * except that single objects (e.g. the nodes of list, set, map and other
+ * node-based containers) are taken from a small cache in the allocator
+ * instance, which is refilled by one GC_malloc_n() call.  A copy of an
+ * allocator starts with an empty cache.  As with gc_allocator, the
+ * container (and hence its allocator) should be visible to the collector.
+ */
+#ifndef GC_BATCH_ALLOCATOR_CNT
+# define GC_BATCH_ALLOCATOR_CNT 16
+#endif
+
+template <class GC_Tp>
+class gc_batch_allocator {
+public:
+  typedef size_t     size_type;
+  typedef ptrdiff_t  difference_type;
+  typedef GC_Tp*       pointer;
+  typedef const GC_Tp* const_pointer;
+  typedef GC_Tp&       reference;
+  typedef const GC_Tp& const_reference;
+  typedef GC_Tp        value_type;
+
+  template <class GC_Tp1> struct rebind {
+    typedef gc_batch_allocator<GC_Tp1> other;
+  };
+
+  gc_batch_allocator() throw() : GC_cache_cnt(0) {}
+    gc_batch_allocator(const gc_batch_allocator&) throw() : GC_cache_cnt(0) {}
+# if !(GC_NO_MEMBER_TEMPLATES || 0 < _MSC_VER && _MSC_VER <= 1200)
+  // MSVC++ 6.0 do not support member templates
+  template <class GC_Tp1>
+    gc_batch_allocator(const gc_batch_allocator<GC_Tp1>&) throw()
+        : GC_cache_cnt(0) {}
+# endif
+  ~gc_batch_allocator() throw() {}
+
+  // The cache is never shared.
+  gc_batch_allocator& operator=(const gc_batch_allocator&) throw()
+    { return *this; }
+
+  pointer address(reference GC_x) const { return &GC_x; }
+  const_pointer address(const_reference GC_x) const { return &GC_x; }
+
+  // GC_n is permitted to be 0.  The C++ standard says nothing about what
+  // the return value is when GC_n == 0.
+  GC_Tp* allocate(size_type GC_n, const void* = 0) {
+    GC_type_traits<GC_Tp> traits;
+#   ifndef GC_DEBUG
+      // GC_malloc_n() has no debugging counterpart.
+      if (GC_n == 1) {
+        if (0 == GC_cache_cnt)
+          GC_cache_cnt = GC_selective_alloc_n(sizeof(GC_Tp),
+                                              GC_BATCH_ALLOCATOR_CNT,
+                                              GC_cache,
+                                              traits.GC_is_ptr_free);
+        if (GC_cache_cnt != 0) {
+          void *GC_p = GC_cache[--GC_cache_cnt];
+
+          GC_cache[GC_cache_cnt] = 0;
+          return static_cast<GC_Tp *>(GC_p);
+        }
+      }
+#   endif
+    return static_cast<GC_Tp *>
+            (GC_selective_alloc(GC_n * sizeof(GC_Tp),
+                                traits.GC_is_ptr_free, false));
+  }
+
+  // __p is not permitted to be a null pointer.
+  void deallocate(pointer __p, size_type GC_ATTR_UNUSED GC_n)
+    { GC_FREE(__p); }
+
+  size_type max_size() const throw()
+    { return size_t(-1) / sizeof(GC_Tp); }
+
+  void construct(pointer __p, const GC_Tp& __val) { new(__p) GC_Tp(__val); }
+  void destroy(pointer __p) { __p->~GC_Tp(); }
+
+private:
+  void *GC_cache[GC_BATCH_ALLOCATOR_CNT];
+  size_t GC_cache_cnt;
+};
+
+template<>
+class gc_batch_allocator<void> {
+  typedef size_t      size_type;
+  typedef ptrdiff_t   difference_type;
+  typedef void*       pointer;
+  typedef const void* const_pointer;
+  typedef void        value_type;
+
+  template <class GC_Tp1> struct rebind {
+    typedef gc_batch_allocator<GC_Tp1> other;
+  };
+};
+
+template <class GC_T1, class GC_T2>
+inline bool operator==(const gc_batch_allocator<GC_T1>&, const gc_batch_allocator<GC_T2>&)
+{
+  return true;
+}
+
+template <class GC_T1, class GC_T2>
+inline bool operator!=(const gc_batch_allocator<GC_T1>&, const gc_batch_allocator<GC_T2>&)
+{
+  return false;
+}
+
 /*
  * And the public traceable_allocator class.
  */
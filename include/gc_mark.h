@@ -183,6 +183,34 @@ GC_API unsigned GC_CALL GC_new_kind_inner(void ** /* free_list */,
 GC_API unsigned GC_CALL GC_new_proc(GC_mark_proc);
 GC_API unsigned GC_CALL GC_new_proc_inner(GC_mark_proc);
 
+/* Type of a reclaim notifier.  It is passed an array of "count"        */
+/* objects of the kind which have been found unreachable, just before   */
+/* they are put on a free list (or their block is returned to the       */
+/* heap).  Pointers stored in the objects may refer to objects already  */
+/* reclaimed, so only the non-pointer data (e.g. a handle of a native   */
+/* resource) should be examined.  Each allocated object is passed at    */
+/* most once: the free lists of a kind having a notifier are kept (and  */
+/* marked) across collections, so the objects not allocated since, or   */
+/* deallocated explicitly by GC_free, are not passed.                   */
+typedef void (GC_CALLBACK * GC_reclaim_notify_proc)(void ** /* objs */,
+                                                    size_t /* count */,
+                                                    void * /* client_data */);
+
+/* Register "proc" as the reclaim notifier of "kind" (0 to unregister). */
+/* The notifier is invoked lazily, while the blocks of the kind are     */
+/* swept (by the allocator, or at the start of the next collection at   */
+/* the latest), usually with the allocation lock held, but possibly     */
+/* concurrently by several threads building free lists (see             */
+/* GC_malloc_many), so it should just record or release the resources;  */
+/* it must not allocate from the collector, nor block.  This is cheaper */
+/* than a disclaim procedure or a per-object finalizer, and does not    */
+/* need ENABLE_DISCLAIM.  Not allowed for a kind having a disclaim      */
+/* procedure.  Should be called before any object of the kind is        */
+/* allocated.                                                           */
+GC_API void GC_CALL GC_register_reclaim_notifier(int /* kind */,
+                                        GC_reclaim_notify_proc /* proc */,
+                                        void * /* client_data */);
+
 /* Allocate an object of a given kind.  By default, there are only      */
 /* a few kinds: composite (pointer-free), atomic, uncollectible, etc.   */
 /* We claim it is possible for clever client code that understands the  */
@@ -30,8 +30,10 @@ typedef struct hblkhdr hdr;
  * retrieve and set object headers.
  *
  * We take advantage of a header lookup
- * cache.  This is a locally declared direct mapped cache, used inside
- * the marker.  The HC_GET_HDR macro uses and maintains this
+ * cache.  This is a set associative cache, used inside the marker.
+ * Each marker has its own cache which survives across GC_mark_from
+ * calls (and collections); the typed mark procedure uses a small
+ * locally declared one.  The HC_GET_HDR macro uses and maintains this
  * cache.  Assuming we get reasonable hit rates, this shaves a few
  * memory references from each pointer validation.
  */
@@ -56,36 +58,67 @@ typedef struct hblkhdr hdr;
 #endif
 #define TOP_SZ (1 << LOG_TOP_SZ)
 
-/* #define COUNT_HDR_CACHE_HITS  */
-
-#ifdef COUNT_HDR_CACHE_HITS
-  extern word GC_hdr_cache_hits; /* used for debugging/profiling */
-  extern word GC_hdr_cache_misses;
-# define HC_HIT() ++GC_hdr_cache_hits
-# define HC_MISS() ++GC_hdr_cache_misses
-#else
-# define HC_HIT()
-# define HC_MISS()
-#endif
-
 typedef struct hce {
   word block_addr;    /* right shifted by LOG_HBLKSIZE */
   hdr * hce_hdr;
 } hdr_cache_entry;
 
-#define HDR_CACHE_SIZE 8  /* power of 2 */
+#ifndef HDR_CACHE_WAYS
+# ifdef SMALL_CONFIG
+#   define HDR_CACHE_WAYS 1
+# else
+#   define HDR_CACHE_WAYS 4
+# endif
+#endif
+
+#ifndef HDR_CACHE_SETS
+# ifdef SMALL_CONFIG
+#   define HDR_CACHE_SETS 8     /* power of 2 */
+# else
+#   define HDR_CACHE_SETS 64
+# endif
+#endif
 
-#define DECLARE_HDR_CACHE \
-        hdr_cache_entry hdr_cache[HDR_CACHE_SIZE]
+/* A header cache consisting of the given number of sets.  The entries  */
+/* of a set are kept in the most-recently-used-first order.             */
+#define HDR_CACHE_STRUCT(sets) \
+        struct { \
+          word hc_epoch;    /* GC_hdr_cache_epoch value the entries    */ \
+                            /* are valid for.                          */ \
+          word hc_hits;     /* Lookup statistics.                      */ \
+          word hc_misses; \
+          hdr_cache_entry hc_sets[sets][HDR_CACHE_WAYS]; \
+        }
 
-#define INIT_HDR_CACHE BZERO(hdr_cache, sizeof(hdr_cache))
+typedef HDR_CACHE_STRUCT(HDR_CACHE_SETS) hdr_cache_t;
 
-#define HCE(h) hdr_cache + (((word)(h) >> LOG_HBLKSIZE) & (HDR_CACHE_SIZE-1))
+GC_EXTERN word GC_hdr_cache_epoch;
+                /* Incremented whenever a header is installed or        */
+                /* removed, or a block is freed.  A cache with a stale  */
+                /* epoch is cleared before use (by VALIDATE_HDR_CACHE). */
 
-#define HCE_VALID_FOR(hce,h) ((hce) -> block_addr == \
-                                ((word)(h) >> LOG_HBLKSIZE))
+/* Use the given (persistent) cache in the current scope.       */
+#define USE_HDR_CACHE(hc) hdr_cache_t *hdr_cache = (hc)
 
-#define HCE_HDR(h) ((hce) -> hce_hdr)
+#define VALIDATE_HDR_CACHE \
+        if (EXPECT(hdr_cache -> hc_epoch != GC_hdr_cache_epoch, FALSE)) { \
+          BZERO(hdr_cache -> hc_sets, sizeof(hdr_cache -> hc_sets)); \
+          hdr_cache -> hc_epoch = GC_hdr_cache_epoch; \
+        }
+
+/* Declare a small cache local to the current scope.            */
+#define LOCAL_HDR_CACHE_SETS \
+                (HDR_CACHE_WAYS < 8 ? 8 / HDR_CACHE_WAYS : 1)
+#define DECLARE_HDR_CACHE \
+        HDR_CACHE_STRUCT(LOCAL_HDR_CACHE_SETS) local_hdr_cache, \
+                                *hdr_cache = &local_hdr_cache
+
+#define INIT_HDR_CACHE BZERO(&local_hdr_cache, sizeof(local_hdr_cache))
+
+/* The set (an array of HDR_CACHE_WAYS entries) for the block of h.     */
+#define HCE(h) (hdr_cache -> hc_sets[((word)(h) >> LOG_HBLKSIZE) \
+                        & (sizeof(hdr_cache -> hc_sets) \
+                           / sizeof(hdr_cache -> hc_sets[0]) - 1)])
 
 #ifdef PRINT_BLACK_LIST
   GC_INNER hdr * GC_header_cache_miss(ptr_t p, hdr_cache_entry *hce,
@@ -103,13 +136,35 @@ typedef struct hce {
 /* is set.                                                              */
 /* Returns zero if p points to somewhere other than the first page      */
 /* of an object, and it is not a valid pointer to the object.           */
+#ifdef HEAP_MAP
+  /* On a header cache miss, reject p at once if it is not in a chunk   */
+  /* containing a heap section (as GC_header_cache_miss would do).      */
+# define HC_HEAP_MAP_CHECK(p, source, exit_label) \
+          if (EXPECT(!HEAP_MAP_TEST(p), FALSE)) { \
+            GC_ADD_TO_BLACK_LIST_NORMAL(p, source); \
+            goto exit_label; \
+          }
+#else
+# define HC_HEAP_MAP_CHECK(p, source, exit_label) /* empty */
+#endif
+
 #define HC_GET_HDR(p, hhdr, source, exit_label) \
         do { \
           hdr_cache_entry * hce = HCE(p); \
-          if (EXPECT(HCE_VALID_FOR(hce, p), TRUE)) { \
-            HC_HIT(); \
-            hhdr = hce -> hce_hdr; \
+          word hc_blk = (word)(p) >> LOG_HBLKSIZE; \
+          int hc_way = 0; \
+          while (hc_way < HDR_CACHE_WAYS \
+                 && hce[hc_way].block_addr != hc_blk) hc_way++; \
+          if (EXPECT(hc_way < HDR_CACHE_WAYS, TRUE)) { \
+            hdr_cache -> hc_hits++; \
+            hhdr = hce[hc_way].hce_hdr; \
+            for (; hc_way > 0; hc_way--) \
+              hce[hc_way] = hce[hc_way - 1]; \
+            hce[0].block_addr = hc_blk; \
+            hce[0].hce_hdr = hhdr; \
           } else { \
+            hdr_cache -> hc_misses++; \
+            HC_HEAP_MAP_CHECK(p, source, exit_label) \
             hhdr = HEADER_CACHE_MISS(p, hce, source); \
             if (0 == hhdr) goto exit_label; \
           } \
@@ -170,6 +225,18 @@ typedef struct bi {
 #else /* hash */
   /* Hash function for tree top level */
 # define TL_HASH(hi) ((hi) & (TOP_SZ - 1))
+# ifdef FLAT_HDR_TABLE
+    /* Besides the tree (used to enumerate the blocks), the header      */
+    /* pointers are stored in an array indexed directly by the block    */
+    /* number, so that a lookup needs neither hashing nor a chain walk. */
+    /* The array covers the first 2**FLAT_HDR_ADDR_BITS bytes of the    */
+    /* address space; it is reserved at initialization and committed    */
+    /* lazily by the OS.                                                */
+    GC_EXTERN hdr **GC_flat_hdrs;
+#   define FLAT_HDR_IN_RANGE(p) \
+                (((word)(p) >> FLAT_HDR_ADDR_BITS) == 0)
+#   define FLAT_HDR(p) GC_flat_hdrs[(word)(p) >> LOG_HBLKSIZE]
+# endif
   /* Set bottom_indx to point to the bottom index for address p */
 # define GET_BI(p, bottom_indx) \
         do { \
@@ -186,19 +253,31 @@ typedef struct bi {
           GET_BI(p, bi); \
           (ha) = &HDR_FROM_BI(bi, p); \
         } while (0)
-# define GET_HDR(p, hhdr) \
+# ifdef FLAT_HDR_TABLE
+#   define HDR(p) (FLAT_HDR_IN_RANGE(p) ? FLAT_HDR(p) : (hdr *)0)
+#   define GET_HDR(p, hhdr) (void)((hhdr) = HDR(p))
+    /* The caller ensures p is in range (get_index fails otherwise).    */
+#   define SET_HDR(p, hhdr) \
+        do { \
+          register hdr ** _ha; \
+          GET_HDR_ADDR(p, _ha); \
+          *_ha = FLAT_HDR(p) = (hhdr); \
+        } while (0)
+# else
+#   define GET_HDR(p, hhdr) \
         do { \
           register hdr ** _ha; \
           GET_HDR_ADDR(p, _ha); \
           (hhdr) = *_ha; \
         } while (0)
-# define SET_HDR(p, hhdr) \
+#   define SET_HDR(p, hhdr) \
         do { \
           register hdr ** _ha; \
           GET_HDR_ADDR(p, _ha); \
           *_ha = (hhdr); \
         } while (0)
-# define HDR(p) GC_find_header((ptr_t)(p))
+#   define HDR(p) GC_find_header((ptr_t)(p))
+# endif
 #endif
 
 /* Is the result a forwarding address to someplace closer to the        */
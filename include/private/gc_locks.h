@@ -207,15 +207,32 @@
 # endif /* !THREADS */
 
 #if defined(UNCOND_LOCK) && !defined(LOCK)
+  GC_EXTERN word GC_lock_acquisitions;
+                /* Number of times the allocation lock has been acquired */
+                /* by LOCK().  Updated while holding the lock.          */
+# ifdef LOCK_HOLD_STATS
+    GC_INNER void GC_lock_hold_begin(void);
+    GC_INNER void GC_lock_hold_end(void);
+                /* Record the time the allocation lock is held by       */
+                /* LOCK()/UNLOCK() in a histogram (see GC_dump).        */
+    GC_INNER void GC_print_lock_hold_stats(void);
+#   define COUNTED_LOCK() \
+                { UNCOND_LOCK(); GC_lock_acquisitions++; \
+                  GC_lock_hold_begin(); }
+#   define COUNTED_UNLOCK() { GC_lock_hold_end(); UNCOND_UNLOCK(); }
+# else
+#   define COUNTED_LOCK() { UNCOND_LOCK(); GC_lock_acquisitions++; }
+#   define COUNTED_UNLOCK() UNCOND_UNLOCK()
+# endif
 # if defined(LINT2) || defined(GC_ALWAYS_MULTITHREADED)
     /* Instruct code analysis tools not to care about GC_need_to_lock   */
     /* influence to LOCK/UNLOCK semantic.                               */
-#   define LOCK() UNCOND_LOCK()
-#   define UNLOCK() UNCOND_UNLOCK()
+#   define LOCK() COUNTED_LOCK()
+#   define UNLOCK() COUNTED_UNLOCK()
 # else
                 /* At least two thread running; need to lock.   */
-#   define LOCK() do { if (GC_need_to_lock) UNCOND_LOCK(); } while (0)
-#   define UNLOCK() do { if (GC_need_to_lock) UNCOND_UNLOCK(); } while (0)
+#   define LOCK() do { if (GC_need_to_lock) COUNTED_LOCK(); } while (0)
+#   define UNLOCK() do { if (GC_need_to_lock) COUNTED_UNLOCK(); } while (0)
 # endif
 #endif
 
@@ -90,23 +90,30 @@ GC_EXTERN size_t GC_mark_stack_size;
      *             it may be profitable to copy it back.
      *          6) If necessary, copy local stack to global one,
      *             holding mark lock.
-     *    7) Stop when the global mark stack is empty.
-     *    8) decrement helper_count (holding mark_lock).
+     *    7) Stop when no work is visible and no helper is active (i.e.
+     *       holds some entries, as counted atomically in active_count).
+     *    8) decrement helper_count (atomically).
      *
      * This is an experiment to see if we can do something along the lines
      * of the University of Tokyo SGC in a less intrusive, though probably
      * also less performant, way.
+     *
+     * If USE_MARK_DEQUES is defined, step 6 normally moves the surplus
+     * local entries to a per-marker work-stealing deque instead, and
+     * markers which run out of work steal from the deques of randomly
+     * chosen peers.
      */
 
     /* GC_mark_stack_top is protected by mark lock.     */
 
     /*
-     * GC_notify_all_marker() is used when GC_help_wanted is first set,
-     * when the last helper becomes inactive,
-     * when something is added to the global mark stack, and just after
-     * GC_mark_no is incremented.
-     * This could be split into multiple CVs (and probably should be to
-     * scale to really large numbers of processors.)
+     * GC_unpark_markers() is used when GC_help_wanted is first set,
+     * when the mark phase is found to be over, when the last helper
+     * exits, when something is added to the global mark stack (or to a
+     * deque), and just after GC_mark_no is incremented.  The waiting
+     * threads spin briefly before parking (on a futex if available,
+     * otherwise on the mark condition variable), and the wake-up is
+     * skipped entirely if nobody is parked.
      */
 #endif /* PARALLEL_MARK */
 
@@ -396,13 +403,25 @@ GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp);
 /* Mark starting at mark stack entry top (incl.) down to        */
 /* mark stack entry bottom (incl.).  Stop after performing      */
 /* about one page worth of work.  Return the new mark stack     */
-/* top entry.                                                   */
-GC_INNER mse * GC_mark_from(mse * top, mse * bottom, mse *limit);
+/* top entry.  hc is the header cache of the calling marker.    */
+GC_INNER mse * GC_mark_from(mse * top, mse * bottom, mse *limit,
+                            hdr_cache_t *hc);
+
+GC_EXTERN hdr_cache_t GC_main_hdr_cache;
+                /* The header cache used by the thread holding the      */
+                /* allocation lock (the marker 0).                      */
+
+#ifdef PARALLEL_MARK
+  GC_INNER hdr_cache_t *GC_marker_hdr_cache(unsigned id);
+                /* The header cache of the marker id (as passed to the  */
+                /* task by GC_run_on_markers).                          */
+#endif
 
 #define MARK_FROM_MARK_STACK() \
         GC_mark_stack_top = GC_mark_from(GC_mark_stack_top, \
                                          GC_mark_stack, \
-                                         GC_mark_stack + GC_mark_stack_size);
+                                         GC_mark_stack + GC_mark_stack_size, \
+                                         &GC_main_hdr_cache);
 
 #define GC_mark_stack_empty() ((word)GC_mark_stack_top < (word)GC_mark_stack)
 
@@ -266,6 +266,16 @@ typedef char * ptr_t;   /* A generic pointer to which we can add        */
                         /* for processing by GC_invoke_finalizers.      */
                         /* Invoked with lock.                           */
 
+#  if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) \
+      && !defined(NO_FINALIZER_THREADS)
+#    ifndef FINALIZER_THREADS
+#      define FINALIZER_THREADS
+#    endif
+     GC_INNER void GC_fill_finalizer_stats(struct GC_prof_stats_s *);
+                        /* Fill in the finalizer thread fields.         */
+     GC_INNER void GC_finalizer_threads_fork_child(void);
+#  endif
+
 #  ifndef SMALL_CONFIG
      GC_INNER void GC_print_finalization_stats(void);
 #  endif
@@ -827,6 +837,28 @@ typedef word page_hash_table[PHT_SIZE];
 # define set_pht_entry_from_index_safe(bl, index) \
                 (bl)[divWORDSZ(index)] = ONES
 
+/* The heap map is a coarse summary of the address space taken by the   */
+/* heap sections: one bit per HEAP_MAP_GRANULE-sized chunk, hashed      */
+/* (like the page hash tables above) into a fixed-size bitmap, thus a   */
+/* set bit could be a false positive.  A clear bit means no heap        */
+/* section intersects the chunk, so a candidate pointer to it could be  */
+/* rejected without the (two-level) header lookup.                      */
+#ifndef NO_HEAP_MAP
+# define HEAP_MAP
+# ifndef LOG_HEAP_MAP_GRANULE
+#   define LOG_HEAP_MAP_GRANULE 20  /* 1 MiB */
+# endif
+# ifndef LOG_HEAP_MAP_ENTRIES
+#   define LOG_HEAP_MAP_ENTRIES 15  /* 4 KiB bitmap (32 GiB w/o aliasing) */
+# endif
+# define HEAP_MAP_ENTRIES ((word)1 << LOG_HEAP_MAP_ENTRIES)
+# define HEAP_MAP_SIZE (HEAP_MAP_ENTRIES >> LOGWL)
+# define HEAP_MAP_HASH(addr) \
+        ((((word)(addr)) >> LOG_HEAP_MAP_GRANULE) & (HEAP_MAP_ENTRIES - 1))
+# define HEAP_MAP_TEST(addr) \
+        get_pht_entry_from_index(GC_heap_map, HEAP_MAP_HASH(addr))
+#endif
+
 
 /********************************************/
 /*                                          */
@@ -901,15 +933,20 @@ struct hblkhdr {
 #       endif
 #       ifdef MARK_BIT_PER_GRANULE
 #         define LARGE_BLOCK 0x20
+#       endif
+#       ifdef LAZY_ZEROING
+#         define ZEROED_BLK 0x40
+                                /* This is a free block, whose memory   */
+                                /* is known to be all zero.             */
 #       endif
     unsigned short hb_last_reclaimed;
                                 /* Value of GC_gc_no when block was     */
                                 /* last allocated or swept. May wrap.   */
                                 /* For a free block, this is maintained */
-                                /* only for USE_MUNMAP, and indicates   */
-                                /* when the header was allocated, or    */
-                                /* when the size of the block last      */
-                                /* changed.                             */
+                                /* only for USE_MUNMAP and LAZY_ZEROING */
+                                /* and indicates when the header was    */
+                                /* allocated, or when the size of the   */
+                                /* block last changed.                  */
 #   ifdef MARK_BIT_PER_OBJ
       unsigned32 hb_inv_sz;     /* A good upper bound for 2**32/hb_sz.  */
                                 /* For large objects, we use            */
@@ -1235,7 +1272,7 @@ struct _GC_arrays {
         /* GC_read_changed.                                             */
 # endif
 # if defined(PROC_VDB) || defined(MPROTECT_VDB) \
-     || defined(GWW_VDB) || defined(MANUAL_VDB)
+     || defined(GWW_VDB) || defined(MANUAL_VDB) || defined(SOFT_VDB)
 #   define GC_grungy_pages GC_arrays._grungy_pages
     page_hash_table _grungy_pages; /* Pages that were dirty at last     */
                                    /* GC_read_dirty.                    */
@@ -1245,10 +1282,15 @@ struct _GC_arrays {
     volatile page_hash_table _dirty_pages;
                         /* Pages dirtied since last GC_read_dirty. */
 # endif
-# if defined(PROC_VDB) || defined(GWW_VDB)
+# if defined(PROC_VDB) || defined(GWW_VDB) || defined(SOFT_VDB)
 #   define GC_written_pages GC_arrays._written_pages
     page_hash_table _written_pages;     /* Pages ever dirtied   */
 # endif
+# ifdef HEAP_MAP
+#   define GC_heap_map GC_arrays._heap_map
+    word _heap_map[HEAP_MAP_SIZE];
+                        /* The chunks containing heap sections.         */
+# endif
 # define GC_heap_sects GC_arrays._heap_sects
   struct HeapSect {
     ptr_t hs_start;
@@ -1331,6 +1373,11 @@ GC_EXTERN struct obj_kind {
                         /* template to obtain descriptor.  Otherwise    */
                         /* template is used as is.                      */
    GC_bool ok_init;   /* Clear objects before putting them on the free list. */
+   GC_reclaim_notify_proc ok_reclaim_notify;
+                        /* Called with batches of unmarked objects of   */
+                        /* this kind before they are reclaimed.         */
+   void *ok_reclaim_notify_data;
+                        /* The client data passed to the above.         */
 #  ifdef ENABLE_DISCLAIM
      GC_bool ok_mark_unconditionally;
                         /* Mark from all, including unmarked, objects   */
@@ -1350,6 +1397,52 @@ GC_EXTERN struct obj_kind {
 #define beginGC_obj_kinds ((ptr_t)(&GC_obj_kinds))
 #define endGC_obj_kinds (beginGC_obj_kinds + (sizeof GC_obj_kinds))
 
+#ifdef FINE_GRAINED_LOCKS
+  /* Each free list of small objects (per kind and size in granules)    */
+  /* has its own spin lock, so that an object could be taken off a      */
+  /* nonempty free list without acquiring the allocation lock.  Any     */
+  /* thread modifying a free list should hold its lock, in addition to  */
+  /* the allocation lock (if the thread needs it), which is always      */
+  /* acquired first.  A collection acquires all the free list locks     */
+  /* (by GC_fl_lock_all) before stopping the world, and releases them   */
+  /* when the free lists have been rebuilt.                             */
+  GC_EXTERN volatile AO_TS_t GC_fl_locks[MAXOBJKINDS][MAXOBJGRANULES+1];
+  GC_INNER void GC_fl_lock_slow(volatile AO_TS_t *lock);
+  GC_INNER void GC_fl_lock_all(void);
+  GC_INNER void GC_fl_unlock_all(void);
+# ifdef LOCK_HOLD_STATS
+    GC_INNER void GC_fl_lock_hold_begin(volatile AO_TS_t *lock);
+    GC_INNER void GC_fl_lock_hold_end(volatile AO_TS_t *lock);
+# else
+#   define GC_fl_lock_hold_begin(lock) (void)0
+#   define GC_fl_lock_hold_end(lock) (void)0
+# endif
+# define FL_LOCK(k, lg) \
+        do { \
+          if (AO_test_and_set_acquire(&GC_fl_locks[k][lg]) == AO_TS_SET) \
+            GC_fl_lock_slow(&GC_fl_locks[k][lg]); \
+          GC_fl_lock_hold_begin(&GC_fl_locks[k][lg]); \
+        } while (0)
+# define FL_TRYLOCK(k, lg) \
+        (AO_test_and_set_acquire(&GC_fl_locks[k][lg]) == AO_TS_CLEAR \
+         && (GC_fl_lock_hold_begin(&GC_fl_locks[k][lg]), TRUE))
+# define FL_UNLOCK(k, lg) \
+        do { \
+          GC_fl_lock_hold_end(&GC_fl_locks[k][lg]); \
+          AO_CLEAR(&GC_fl_locks[k][lg]); \
+        } while (0)
+
+  GC_EXTERN volatile AO_t GC_fl_bytes_allocd;
+                /* Number of bytes allocated without the allocation     */
+                /* lock, not yet added to GC_bytes_allocd.              */
+  GC_INNER void GC_flush_fl_bytes_allocd(void);
+                /* Add GC_fl_bytes_allocd to GC_bytes_allocd.  Called   */
+                /* with the allocation lock held.                       */
+#else
+# define FL_LOCK(k, lg) (void)0
+# define FL_UNLOCK(k, lg) (void)0
+#endif /* !FINE_GRAINED_LOCKS */
+
 /* Variables that used to be in GC_arrays, but need to be accessed by   */
 /* inline allocation code.  If they were in GC_arrays, the inlined      */
 /* allocation code would include GC_arrays offsets (as it did), which   */
@@ -1547,6 +1640,9 @@ GC_INNER struct hblk * GC_prev_block(struct hblk * h);
                         /* is managed by GC, but may or may not be in   */
                         /* use.                                         */
 GC_INNER void GC_mark_init(void);
+GC_INNER void GC_get_hdr_cache_stats(word *phits, word *pmisses);
+                        /* Sum the statistics of the header caches of   */
+                        /* all the markers.                             */
 GC_INNER void GC_clear_marks(void);
                         /* Clear mark bits for all heap objects.        */
 GC_INNER void GC_invalidate_mark_state(void);
@@ -1648,6 +1744,12 @@ GC_INNER void GC_set_hdr_marks(hdr * hhdr);
 GC_INNER void GC_set_fl_marks(ptr_t p);
                                     /* Set all mark bits associated with */
                                     /* a free list.                      */
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  GC_INNER void GC_set_region_marks(ptr_t p, ptr_t limit);
+                                    /* Set the mark bits of the objects  */
+                                    /* from p (inclusive) to limit in a  */
+                                    /* single block.                     */
+#endif
 #if defined(GC_ASSERTIONS) && defined(THREADS) && defined(THREAD_LOCAL_ALLOC)
   void GC_check_fl_marks(void **);
                                     /* Check that all mark bits         */
@@ -1741,6 +1843,16 @@ GC_INNER void GC_new_hblk(size_t size_in_granules, int kind);
                                 /* Allocate a new heap block, and build */
                                 /* a free list in it.                   */
 
+#ifdef SIMD_CLEAR
+  GC_INNER void GC_init_clear_kernel(void);
+  GC_INNER void GC_clear_mem(void *p, size_t bytes);
+                                /* The same as BZERO but large ranges   */
+                                /* are cleared bypassing the cache.     */
+                                /* Used to clear the heap memory.       */
+#else
+# define GC_clear_mem(p, bytes) BZERO(p, bytes)
+#endif
+
 GC_INNER ptr_t GC_build_fl(struct hblk *h, size_t words, GC_bool clear,
                            ptr_t list);
                                 /* Build a free list for objects of     */
@@ -1756,6 +1868,23 @@ GC_INNER struct hblk * GC_allochblk(size_t size_in_bytes, int kind,
                                 /* the marker that block is valid       */
                                 /* for objects of indicated size.       */
 
+#ifdef LAZY_ZEROING
+  GC_EXTERN GC_bool GC_last_hblk_zeroed;
+                        /* Whether the block returned by the last       */
+                        /* successful GC_allochblk call is known to be  */
+                        /* all zero, thus needs no clearing.  Valid     */
+                        /* only until the allocation lock is released.  */
+# define LAST_HBLK_ZEROED() GC_last_hblk_zeroed
+  GC_INNER void GC_discard_free_blocks(void);
+                        /* Release the pages of the large enough free   */
+                        /* blocks to the OS, making them all zero.      */
+  GC_INNER GC_bool GC_discard_pages(ptr_t start, size_t bytes);
+                        /* Release the pages of the range (keeping it   */
+                        /* mapped) so that they read as zero.           */
+#else
+# define LAST_HBLK_ZEROED() FALSE
+#endif
+
 GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags);
                         /* Allocate a large block of size lb bytes.     */
                         /* The block is not cleared.                    */
@@ -1766,6 +1895,49 @@ GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags);
                         /* Does not update GC_bytes_allocd, but does    */
                         /* other accounting.                            */
 
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  GC_INNER unsigned GC_split_inuse_hblk(struct hblk *h, word n_blocks,
+                                        unsigned count,
+                                        struct hblk **result);
+                        /* Split the block h just allocated by          */
+                        /* GC_allochblk for count*n_blocks blocks into  */
+                        /* count objects of n_blocks blocks each (as    */
+                        /* if allocated separately), storing them to    */
+                        /* result.  Returns the number of objects; the  */
+                        /* last one gets all the remaining blocks if a  */
+                        /* header could not be allocated.               */
+
+  GC_INNER unsigned GC_alloc_large_many(size_t lb, int k, unsigned count,
+                                        struct hblk **result);
+                        /* Allocate up to count uncleared large objects */
+                        /* of lb bytes (a multiple of HBLKSIZE) from a  */
+                        /* single free block run, storing them to       */
+                        /* result.  Unlike GC_alloc_large, never        */
+                        /* collects or expands the heap.  Returns the   */
+                        /* number of the allocated objects (0 on        */
+                        /* failure).                                    */
+#endif
+
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  /* A part of a fresh block of objects of a single size, the objects   */
+  /* of which are handed out (by a thread) by incrementing cur.         */
+  struct bump_region {
+    ptr_t cur;          /* The next object to allocate.                 */
+    ptr_t limit;        /* The end of the last object.                  */
+  };
+
+  GC_INNER void GC_generic_malloc_many_or_region(size_t lb, int k,
+                                                void **result,
+                                                struct bump_region *region);
+                        /* Same as GC_generic_malloc_many but, instead  */
+                        /* of threading a free list through a new       */
+                        /* block of objects, make it the new region (if */
+                        /* region is not null) and store 0 to *result.  */
+                        /* The region is updated while holding the      */
+                        /* allocation lock, so it should be visible to  */
+                        /* the collector (as a thread-local one).       */
+#endif
+
 GC_INNER void GC_freehblk(struct hblk * p);
                                 /* Deallocate a heap block and mark it  */
                                 /* as invalid.                          */
@@ -1784,6 +1956,13 @@ GC_INNER void GC_continue_reclaim(size_t sz, int kind);
                                 /* as long as the corr. free list is    */
                                 /* empty.  Sz is in granules.           */
 
+GC_INNER struct hblk * GC_pop_reclaim_list(struct hblk **rlh);
+                                /* Remove the first block from the      */
+                                /* given reclaim list, or return NULL.  */
+                                /* Safe to call concurrently (without   */
+                                /* the GC lock) if PARALLEL_MARK and    */
+                                /* the reclaim lists are not frozen.    */
+
 GC_INNER GC_bool GC_reclaim_all(GC_stop_func stop_func, GC_bool ignore_old);
                                 /* Reclaim all blocks.  Abort (in a     */
                                 /* consistent state) if f returns TRUE. */
@@ -1837,6 +2016,20 @@ GC_INNER ptr_t GC_allocobj(size_t sz, int kind);
                                 /* free list nonempty, and return its   */
                                 /* head.  Sz is in granules.            */
 
+/* Remove the first object from the free list flh (of objects of kind  */
+/* k and size lg granules).  Return NULL if the list is empty.          */
+GC_INLINE void *GC_fl_pop(void **flh, int k GC_ATTR_UNUSED,
+                          size_t lg GC_ATTR_UNUSED)
+{
+    void *op;
+
+    FL_LOCK(k, lg);
+    op = *flh;
+    if (op != NULL) *flh = obj_link(op);
+    FL_UNLOCK(k, lg);
+    return op;
+}
+
 #ifdef GC_ADD_CALLER
   /* GC_DBG_EXTRAS is used by GC debug API functions (unlike GC_EXTRAS  */
   /* used by GC debug API macros) thus GC_RETURN_ADDR_PARENT (pointing  */
@@ -1867,16 +2060,57 @@ GC_INNER ptr_t GC_allocobj(size_t sz, int kind);
 # define GC_DBG_COLLECT_AT_MALLOC(lb) (void)0
 #endif /* !GC_COLLECT_AT_MALLOC */
 
+GC_INNER size_t GC_generic_malloc_n(size_t lb, int k, size_t n,
+                                    void **out);
+                /* Allocate n objects of kind k (not requiring any      */
+                /* special initialization), storing them to out.        */
+                /* Returns the number of the objects (n unless out of   */
+                /* memory).  Bypasses the thread local cache.           */
+
 /* Allocation routines that bypass the thread local cache.      */
-#ifdef THREAD_LOCAL_ALLOC
+#if defined(THREAD_LOCAL_ALLOC) || defined(HEAP_PROFILE)
   GC_INNER void * GC_core_malloc(size_t);
   GC_INNER void * GC_core_malloc_atomic(size_t);
-# ifdef GC_GCJ_SUPPORT
-    GC_INNER void * GC_core_gcj_malloc(size_t, void *);
-# endif
-#endif /* THREAD_LOCAL_ALLOC */
+#endif
+#if defined(THREAD_LOCAL_ALLOC) && defined(GC_GCJ_SUPPORT)
+  GC_INNER void * GC_core_gcj_malloc(size_t, void *);
+#endif
+
+#ifdef HEAP_PROFILE
+  GC_EXTERN word GC_heap_profile_interval;
+                /* The mean distance (in bytes) between the sampled     */
+                /* allocations; 0 if the sampling is disabled.          */
+
+  GC_INNER void * GC_sample_alloc(signed_word *pcountdown, word *prnd,
+                                  void *p, size_t lb);
+                /* Called when *pcountdown (the number of bytes to      */
+                /* allocate before the next sample, decremented by lb   */
+                /* already) becomes negative.  Record the just          */
+                /* allocated object p of lb bytes (if not NULL) with    */
+                /* the current call stack, reset *pcountdown (using     */
+                /* the random generator state *prnd) and return p.      */
+                /* Acquires the allocation lock.                        */
+
+# define GC_SAMPLE_ALLOC(pcountdown, prnd, p, lb) \
+        (EXPECT((*(pcountdown) -= (signed_word)(lb)) >= 0, TRUE) ? (p) \
+         : GC_sample_alloc(pcountdown, prnd, p, lb))
+
+  GC_INNER void GC_heap_profile_free(ptr_t p);
+                /* Forget the sample of the deallocated object p (if    */
+                /* any).  Lock is held.                                 */
+
+  GC_INNER void GC_heap_profile_prune(void);
+                /* Drop the samples of the objects left unmarked by     */
+                /* the just completed mark phase.  Lock is held.        */
+#endif /* HEAP_PROFILE */
 
 GC_INNER void GC_init_headers(void);
+#ifdef FLAT_HDR_TABLE
+  GC_INNER ptr_t GC_get_sparse_mem(size_t bytes);
+                                /* Reserve zero-filled memory which is  */
+                                /* committed only when written to.      */
+                                /* Return 0 on failure.                 */
+#endif
 GC_INNER struct hblkhdr * GC_install_header(struct hblk *h);
                                 /* Install a header for block h.        */
                                 /* Return 0 on failure, or the header   */
@@ -1891,8 +2125,10 @@ GC_INNER void GC_remove_counts(struct hblk * h, size_t sz);
                                 /* Remove forwarding counts for h.      */
 GC_INNER hdr * GC_find_header(ptr_t h);
 
-GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes);
+GC_INNER void GC_add_to_heap(struct hblk *p, size_t bytes, GC_bool zeroed);
                         /* Add a HBLKSIZE aligned chunk to the heap.    */
+                        /* zeroed tells whether the chunk is known to   */
+                        /* be all zero (i.e. fresh from the OS).        */
 
 #ifdef USE_PROC_FOR_LIBRARIES
   GC_INNER void GC_add_to_our_memory(ptr_t p, size_t bytes);
@@ -2034,6 +2270,20 @@ GC_EXTERN GC_bool GC_print_back_height;
                         /* dirty bit implementation.                        */
 
   GC_INNER void GC_dirty_init(void);
+
+# ifdef MPROTECT_VDB
+    GC_EXTERN word GC_protect_calls;
+                        /* Number of calls protecting the heap ranges.  */
+    GC_EXTERN word GC_unprotect_calls;
+                        /* Same for GC_remove_protection (the write     */
+                        /* fault handler is not counted).               */
+# endif
+
+# ifdef UFFD_VDB
+    GC_INNER void GC_uffd_add_heap_range(ptr_t start, size_t bytes);
+                        /* Register a new heap section with userfaultfd */
+                        /* (if it is used for the write protection).    */
+# endif
 #endif /* !GC_DISABLE_INCREMENTAL */
 
 /* Same as GC_base but excepts and returns a pointer to const object.   */
@@ -2192,6 +2442,13 @@ GC_EXTERN signed_word GC_bytes_found;
 #ifdef THREAD_LOCAL_ALLOC
   GC_EXTERN GC_bool GC_world_stopped; /* defined in alloc.c */
   GC_INNER void GC_mark_thread_local_free_lists(void);
+# ifdef THREAD_LOCAL_LARGE_CACHE
+    GC_INNER void GC_drop_thread_local_large_caches(void);
+                /* Forget the contents of the thread-local caches of    */
+                /* large objects.  Called with the world stopped before */
+                /* marking, so that the cached objects are reclaimed    */
+                /* (returned to the global free lists) by the sweep.    */
+# endif
 #endif
 
 #ifdef GC_GCJ_SUPPORT
@@ -2360,10 +2617,13 @@ GC_INNER ptr_t GC_store_debug_info(ptr_t p, word sz, const char *str,
   /* marker, and to protect GC_fl_builder_count, below.                 */
   /* GC_notify_all_marker() is called when                              */
   /* the state of the parallel marker changes                           */
-  /* in some significant way (see gc_mark.h for details).  The          */
-  /* latter set of events includes incrementing GC_mark_no.             */
+  /* in some significant way (see gc_pmark.h for details), unless       */
+  /* USE_MARKER_FUTEX.  The latter set of events includes incrementing  */
+  /* GC_mark_no.                                                        */
   /* GC_notify_all_builder() is called when GC_fl_builder_count         */
-  /* reaches 0.                                                         */
+  /* reaches 0.  GC_wait_for_reclaim() also sets                        */
+  /* GC_reclaim_lists_frozen, so that no new free list builder pops     */
+  /* the reclaim lists without the GC lock until GC_start_reclaim.      */
 
   GC_INNER void GC_acquire_mark_lock(void);
   GC_INNER void GC_release_mark_lock(void);
@@ -2371,6 +2631,8 @@ GC_INNER ptr_t GC_store_debug_info(ptr_t p, word sz, const char *str,
   GC_INNER void GC_wait_for_reclaim(void);
 
   GC_EXTERN word GC_fl_builder_count;   /* Protected by mark lock.      */
+  GC_EXTERN GC_bool GC_reclaim_lists_frozen;
+                                        /* Protected by mark lock.      */
 
   GC_INNER void GC_notify_all_marker(void);
   GC_INNER void GC_wait_marker(void);
@@ -2381,6 +2643,26 @@ GC_INNER ptr_t GC_store_debug_info(ptr_t p, word sz, const char *str,
               /* my_mark_no.  Returns if the mark cycle finishes or     */
               /* was already done, or there was nothing to do for       */
               /* some other reason.                                     */
+
+  GC_INNER void GC_run_on_markers(void (*fn)(unsigned));
+              /* Call fn(id) in the current thread (with id 0) and,     */
+              /* concurrently, in the marker threads which are able to  */
+              /* join (with distinct ids from 1 to GC_markers_m1), and  */
+              /* wait for all the calls to return.  The caller holds    */
+              /* the GC lock, not the mark lock.                        */
+
+# if defined(GC_LINUX_THREADS) && !defined(NACL) \
+     && !defined(NO_MARKER_FUTEX) && !defined(USE_MARKER_FUTEX)
+#   define USE_MARKER_FUTEX
+# endif
+# ifdef USE_MARKER_FUTEX
+    /* Idle marker threads park on a futex rather than on the mark      */
+    /* condition variable, thus waking them up does not require the     */
+    /* mark lock.                                                       */
+    GC_INNER void GC_futex_wait(volatile AO_t *addr, AO_t expected);
+                /* Block while *addr == expected (or until woken up).   */
+    GC_INNER void GC_futex_wake_all(volatile AO_t *addr);
+# endif
 #endif /* PARALLEL_MARK */
 
 #if defined(GC_PTHREADS) && !defined(GC_WIN32_THREADS) && !defined(NACL) \
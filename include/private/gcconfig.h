@@ -722,6 +722,11 @@
  *   MPROTECT_VDB: Write protect the heap and catch faults.
  *   GWW_VDB: Use win32 GetWriteWatch primitive.
  *   PROC_VDB: Use the SVR4 /proc primitives to read dirty bits.
+ *   SOFT_VDB: Use the Linux /proc/self/pagemap soft-dirty bits (never
+ *             defined by default, the client may choose it explicitly).
+ *   UFFD_VDB: Use the Linux userfaultfd write protection if available
+ *             at runtime, otherwise MPROTECT_VDB (never defined by
+ *             default, requires MPROTECT_VDB and Linux threads).
  *
  * The first and second one may be combined, in which case a runtime
  * selection will be made, based on GetWriteWatch availability.
@@ -2620,11 +2625,16 @@
 # define MMAP_SUPPORTED
 #endif
 
+#if defined(SOFT_VDB) && !defined(LINUX)
+# undef SOFT_VDB
+#endif
+
 #if defined(GC_DISABLE_INCREMENTAL) || defined(MANUAL_VDB)
 # undef GWW_VDB
 # undef MPROTECT_VDB
 # undef PCR_VDB
 # undef PROC_VDB
+# undef SOFT_VDB
 #endif
 
 #ifdef GC_DISABLE_INCREMENTAL
@@ -2647,16 +2657,23 @@
   /* Choose MPROTECT_VDB manually (if multiple strategies available).   */
 # undef PCR_VDB
 # undef PROC_VDB
+# undef SOFT_VDB
   /* #undef GWW_VDB - handled in os_dep.c       */
 #endif
 
-#ifdef PROC_VDB
+#if defined(PROC_VDB) || defined(SOFT_VDB)
   /* Multi-VDB mode is not implemented. */
 # undef MPROTECT_VDB
 #endif
 
+#if defined(UFFD_VDB) \
+    && (!defined(MPROTECT_VDB) || !defined(GC_LINUX_THREADS))
+  /* UFFD_VDB is only a runtime alternative to mprotect in MPROTECT_VDB. */
+# undef UFFD_VDB
+#endif
+
 #if !defined(PCR_VDB) && !defined(PROC_VDB) && !defined(MPROTECT_VDB) \
-    && !defined(GWW_VDB) && !defined(MANUAL_VDB) \
+    && !defined(GWW_VDB) && !defined(MANUAL_VDB) && !defined(SOFT_VDB) \
     && !defined(GC_DISABLE_INCREMENTAL)
 # define DEFAULT_VDB
 #endif
@@ -2926,6 +2943,68 @@
 # define FIXUP_POINTER(p)
 #endif
 
+#if defined(X86_64) && ALIGNMENT == 8 && !NEED_FIXUP_POINTER \
+    && !defined(SIMD_SCAN) && !defined(NO_SIMD_SCAN) \
+    && !defined(SMALL_CONFIG) \
+    && ((defined(__GNUC__) && !defined(__clang__) \
+         && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+        || (defined(__clang__) && __clang_major__ >= 8))
+  /* Use SSE2/AVX2/AVX-512 (selected at runtime) to test several words */
+  /* at once in GC_mark_from and GC_push_all_eager.                    */
+# define SIMD_SCAN
+#endif
+
+#if defined(X86_64) && !defined(SIMD_CLEAR) && !defined(NO_SIMD_CLEAR) \
+    && !defined(SMALL_CONFIG) \
+    && ((defined(__GNUC__) && !defined(__clang__) \
+         && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+        || (defined(__clang__) && __clang_major__ >= 8))
+  /* Clear the large ranges of the heap with non-temporal SSE2/AVX2     */
+  /* stores (selected at runtime).                                      */
+# define SIMD_CLEAR
+#endif
+
+#if defined(FLAT_HDR_TABLE) && (!defined(LINUX) || CPP_WORDSZ != 64 \
+                                || !(defined(X86_64) || defined(AARCH64)))
+  /* The table is a sparse (lazily committed) mapping covering all the  */
+  /* user address space, so it is feasible only with a known VA size.   */
+# undef FLAT_HDR_TABLE
+#endif
+#if defined(FLAT_HDR_TABLE) && !defined(FLAT_HDR_ADDR_BITS)
+# ifdef X86_64
+#   define FLAT_HDR_ADDR_BITS 47
+# else
+#   define FLAT_HDR_ADDR_BITS 48
+# endif
+#endif
+
+#if (defined(FINE_GRAINED_LOCKS) || defined(LOCK_HOLD_STATS)) \
+    && (!defined(GC_PTHREADS) || defined(GC_WIN32_THREADS) \
+        || defined(SN_TARGET_PS3))
+  /* The free list locks and the lock statistics are implemented only  */
+  /* in pthread_support.c.                                              */
+# undef FINE_GRAINED_LOCKS
+# undef LOCK_HOLD_STATS
+#endif
+
+#if !defined(THREAD_LOCAL_ALLOC)
+# undef THREAD_LOCAL_BUMP_ALLOC
+# undef THREAD_LOCAL_LARGE_CACHE
+#endif
+
+#if defined(HEAP_PROFILE) && (!defined(LINUX) || defined(REDIRECT_MALLOC) \
+                              || !defined(GC_HAVE_BUILTIN_BACKTRACE))
+  /* The allocation sampling relies on backtrace() which might call    */
+  /* malloc(), and the profile is written in the Linux format.          */
+# undef HEAP_PROFILE
+#endif
+
+#if defined(LAZY_ZEROING) && !defined(LINUX)
+  /* Relies on madvise(MADV_DONTNEED) zero-filling private anonymous   */
+  /* pages, and on the heap memory got from the OS being zeroed.       */
+# undef LAZY_ZEROING
+#endif
+
 #if !defined(MARK_BIT_PER_GRANULE) && !defined(MARK_BIT_PER_OBJ)
 # define MARK_BIT_PER_GRANULE   /* Usually faster       */
 #endif
@@ -2960,8 +3039,8 @@
         /* In case of MMAP_SUPPORTED, the argument must also be         */
         /* a multiple of a physical page size.                          */
         /* GET_MEM is currently not assumed to retrieve 0 filled space, */
-        /* though we should perhaps take advantage of the case in which */
-        /* does.                                                        */
+        /* except for LAZY_ZEROING (Linux only), where the space is     */
+        /* fresh sbrk'ed or mmap'ed pages.                              */
         struct hblk;    /* See gc_priv.h.       */
 # if defined(PCR)
     char * real_malloc(size_t bytes);
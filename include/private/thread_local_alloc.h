@@ -74,11 +74,72 @@
 
 #include <stdlib.h>
 
+#ifndef NO_MEDIUM_THREAD_LOCAL_ALLOC
+  /* Also keep per-thread free lists for the normal and pointer-free    */
+  /* objects of TINY_FREELISTS to MAXOBJGRANULES granules (indexed by   */
+  /* the size class minus TINY_FREELISTS).  Each one is refilled with   */
+  /* (typically) a whole block of objects by GC_generic_malloc_many.    */
+# define MEDIUM_FREELISTS (MAXOBJGRANULES + 1 - TINY_FREELISTS)
+#endif
+
+#ifdef THREAD_LOCAL_LARGE_CACHE
+# include "atomic_ops.h"
+
+  /* Per-thread caches of large normal and pointer-free objects of up   */
+  /* to LARGE_CACHE_BLOCKS heap blocks, indexed by the block count      */
+  /* minus one.  Each bucket holds up to LARGE_CACHE_SLOTS objects      */
+  /* (pointers to allocated but not yet handed out blocks, or zero).    */
+  /* A bucket is refilled (under the lock) by splitting a single free   */
+  /* run of up to LARGE_CACHE_REFILL_BLOCKS blocks, as long as the      */
+  /* thread caches at most LARGE_CACHE_MAX_BLOCKS blocks in total.      */
+  /* The collector zeroes all the slots with the world stopped, so the  */
+  /* owner takes an object with a compare-and-swap, and the cached      */
+  /* objects are reclaimed by the next sweep.                           */
+# ifndef LARGE_CACHE_BLOCKS
+#   define LARGE_CACHE_BLOCKS 64
+# endif
+# ifndef LARGE_CACHE_SLOTS
+#   define LARGE_CACHE_SLOTS 3
+# endif
+# ifndef LARGE_CACHE_REFILL_BLOCKS
+#   define LARGE_CACHE_REFILL_BLOCKS (2 * LARGE_CACHE_BLOCKS)
+# endif
+# ifndef LARGE_CACHE_MAX_BLOCKS
+#   define LARGE_CACHE_MAX_BLOCKS (4 * LARGE_CACHE_BLOCKS)
+# endif
+#endif
+
 /* One of these should be declared as the tlfs field in the     */
 /* structure pointed to by a GC_thread.                         */
 typedef struct thread_local_freelists {
   void * ptrfree_freelists[TINY_FREELISTS];
   void * normal_freelists[TINY_FREELISTS];
+# ifdef MEDIUM_FREELISTS
+    void * ptrfree_medium_freelists[MEDIUM_FREELISTS];
+    void * normal_medium_freelists[MEDIUM_FREELISTS];
+# endif
+# ifdef THREAD_LOCAL_LARGE_CACHE
+    volatile AO_t ptrfree_large_cache[LARGE_CACHE_BLOCKS * LARGE_CACHE_SLOTS];
+    volatile AO_t normal_large_cache[LARGE_CACHE_BLOCKS * LARGE_CACHE_SLOTS];
+    volatile AO_t large_cached_blocks;
+                /* Total size (in blocks) of the objects in the caches. */
+    volatile AO_t large_bytes_allocd;
+                /* Bytes handed out from the caches, not yet added to   */
+                /* GC_bytes_allocd.                                     */
+# endif
+# ifdef THREAD_LOCAL_BUMP_ALLOC
+    struct bump_region ptrfree_regions[TINY_FREELISTS];
+    struct bump_region normal_regions[TINY_FREELISTS];
+                /* Fresh blocks of objects (indexed the same way as the */
+                /* tiny free lists) used once the free list is empty;   */
+                /* the free lists hold only the objects of the swept    */
+                /* blocks.                                              */
+# endif
+# ifdef HEAP_PROFILE
+    signed_word bytes_until_sample;
+    word sample_rnd;
+                /* The allocation sampling state (see GC_sample_alloc). */
+# endif
 # ifdef GC_GCJ_SUPPORT
     void * gcj_freelists[TINY_FREELISTS];
 #   define ERROR_FL ((void *)(word)-1)
@@ -155,6 +216,14 @@ GC_INNER void GC_destroy_thread_local(GC_tlfs p);
 /* we take care of an individual thread freelist structure.     */
 GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p);
 
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  /* Forget the cached large objects of a thread (and account the      */
+  /* bytes handed out from the caches).  We hold the allocator lock,    */
+  /* and either the world is stopped or p belongs to the current        */
+  /* thread.                                                            */
+  GC_INNER void GC_drop_large_cache_for(GC_tlfs p);
+#endif
+
 #ifdef ENABLE_DISCLAIM
   GC_EXTERN ptr_t * GC_finalized_objfreelist;
 #endif
@@ -78,6 +78,35 @@ GC_INNER ptr_t GC_alloc_large(size_t lb, int k, unsigned flags)
     return result;
 }
 
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  GC_INNER unsigned GC_alloc_large_many(size_t lb, int k, unsigned count,
+                                        struct hblk **result)
+  {
+    word n_blocks = OBJ_SZ_TO_BLOCKS(lb);
+    struct hblk * h;
+    unsigned i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    GC_ASSERT(lb % HBLKSIZE == 0 && count > 0);
+    /* Do our share of marking work for all the objects at once.        */
+    if (GC_incremental && !GC_dont_gc)
+      GC_collect_a_little_inner((int)(n_blocks * count));
+    h = GC_allochblk(lb * count, k, 0);
+    if (0 == h) return 0;
+    count = GC_split_inuse_hblk(h, n_blocks, count, result);
+    for (i = 0; i < count; ++i) {
+      size_t sz = HDR(result[i]) -> hb_sz;
+
+      if (sz > HBLKSIZE) {
+        GC_large_allocd_bytes += sz;
+        if (GC_large_allocd_bytes > GC_max_large_allocd_bytes)
+          GC_max_large_allocd_bytes = GC_large_allocd_bytes;
+      }
+    }
+    return count;
+  }
+#endif /* THREAD_LOCAL_LARGE_CACHE */
+
 /* Allocate a large block of size lb bytes.  Clear if appropriate.      */
 /* We hold the allocation lock.                                         */
 /* EXTRA_BYTES were already added to lb.                                */
@@ -87,9 +116,10 @@ STATIC ptr_t GC_alloc_large_and_clear(size_t lb, int k, unsigned flags)
     word n_blocks = OBJ_SZ_TO_BLOCKS(lb);
 
     if (0 == result) return 0;
-    if (GC_debugging_started || GC_obj_kinds[k].ok_init) {
+    if ((GC_debugging_started || GC_obj_kinds[k].ok_init)
+        && !LAST_HBLK_ZEROED()) {
         /* Clear the whole block, in case of GC_realloc call. */
-        BZERO(result, n_blocks * HBLKSIZE);
+        GC_clear_mem(result, n_blocks * HBLKSIZE);
     }
     return result;
 }
@@ -109,7 +139,7 @@ GC_INNER void * GC_generic_malloc_inner(size_t lb, int k)
         size_t lg = GC_size_map[lb];
         void ** opp = &(kind -> ok_freelist[lg]);
 
-        op = *opp;
+        op = GC_fl_pop(opp, k, lg);
         if (EXPECT(0 == op, FALSE)) {
           if (lg == 0) {
             if (!EXPECT(GC_is_initialized, TRUE)) {
@@ -123,18 +153,19 @@ GC_INNER void * GC_generic_malloc_inner(size_t lb, int k)
             }
             /* Retry */
             opp = &(kind -> ok_freelist[lg]);
-            op = *opp;
+            op = GC_fl_pop(opp, k, lg);
           }
-          if (0 == op) {
+          while (0 == op) {
             if (0 == kind -> ok_reclaim_list &&
                 !GC_alloc_reclaim_list(kind))
               return NULL;
-            op = GC_allocobj(lg, k);
-            if (0 == op)
+            if (0 == GC_allocobj(lg, k))
               return NULL;
+            /* The list might be emptied by other threads meanwhile     */
+            /* if FINE_GRAINED_LOCKS.                                   */
+            op = GC_fl_pop(opp, k, lg);
           }
         }
-        *opp = obj_link(op);
         obj_link(op) = 0;
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
     } else {
@@ -195,8 +226,10 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
         LOCK();
         result = (ptr_t)GC_alloc_large(lb_rounded, k, 0);
         if (0 != result) {
-          if (GC_debugging_started) {
-            BZERO(result, n_blocks * HBLKSIZE);
+          if (LAST_HBLK_ZEROED()) {
+            init = FALSE; /* nothing to clear */
+          } else if (GC_debugging_started) {
+            GC_clear_mem(result, n_blocks * HBLKSIZE);
           } else {
 #           ifdef THREADS
               /* Clear any memory that might be used for GC descriptors */
@@ -211,7 +244,7 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
         GC_bytes_allocd += lb_rounded;
         UNLOCK();
         if (init && !GC_debugging_started && 0 != result) {
-            BZERO(result, n_blocks * HBLKSIZE);
+            GC_clear_mem(result, n_blocks * HBLKSIZE);
         }
     }
     if (0 == result) {
@@ -221,8 +254,29 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
     }
 }
 
+#ifdef FINE_GRAINED_LOCKS
+  /* Take an object off the free list flh (of objects of kind k and     */
+  /* size lg granules) without acquiring the allocation lock.  Return   */
+  /* NULL if the list is empty or its lock is busy (e.g., the list is   */
+  /* being refilled, or a collection is in progress); the caller should */
+  /* then take the usual path.                                          */
+  GC_INLINE void *GC_fl_try_pop(void **flh, int k, size_t lg)
+  {
+    void *op;
+
+    if (!FL_TRYLOCK(k, lg)) return NULL;
+    op = *flh;
+    if (op != NULL) *flh = obj_link(op);
+    FL_UNLOCK(k, lg);
+    if (op != NULL)
+      (void)AO_fetch_and_add(&GC_fl_bytes_allocd,
+                             (AO_t)GRANULES_TO_BYTES(lg));
+    return op;
+  }
+#endif /* FINE_GRAINED_LOCKS */
+
 /* Allocate lb bytes of atomic (pointer-free) data. */
-#ifdef THREAD_LOCAL_ALLOC
+#if defined(THREAD_LOCAL_ALLOC) || defined(HEAP_PROFILE)
   GC_INNER void * GC_core_malloc_atomic(size_t lb)
 #else
   GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_atomic(size_t lb)
@@ -235,13 +289,16 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
     if(SMALL_OBJ(lb)) {
         GC_DBG_COLLECT_AT_MALLOC(lb);
         lg = GC_size_map[lb];
+#       ifdef FINE_GRAINED_LOCKS
+          op = GC_fl_try_pop((void **)&GC_aobjfreelist[lg], PTRFREE, lg);
+          if (EXPECT(op != NULL, TRUE)) return op;
+#       endif
         LOCK();
-        op = GC_aobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_aobjfreelist[lg], PTRFREE, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             return(GENERAL_MALLOC((word)lb, PTRFREE));
         }
-        GC_aobjfreelist[lg] = obj_link(op);
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
         UNLOCK();
         return((void *) op);
@@ -251,7 +308,7 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
 }
 
 /* Allocate lb bytes of composite (pointerful) data */
-#ifdef THREAD_LOCAL_ALLOC
+#if defined(THREAD_LOCAL_ALLOC) || defined(HEAP_PROFILE)
   GC_INNER void * GC_core_malloc(size_t lb)
 #else
   GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc(size_t lb)
@@ -264,8 +321,15 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
     if(SMALL_OBJ(lb)) {
         GC_DBG_COLLECT_AT_MALLOC(lb);
         lg = GC_size_map[lb];
+#       ifdef FINE_GRAINED_LOCKS
+          op = GC_fl_try_pop((void **)&GC_objfreelist[lg], NORMAL, lg);
+          if (EXPECT(op != NULL, TRUE)) {
+            obj_link(op) = 0;
+            return op;
+          }
+#       endif
         LOCK();
-        op = GC_objfreelist[lg];
+        op = GC_fl_pop((void **)&GC_objfreelist[lg], NORMAL, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             return (GENERAL_MALLOC((word)lb, NORMAL));
@@ -275,7 +339,6 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
                         <= (word)GC_greatest_plausible_heap_addr
                      && (word)obj_link(op)
                         >= (word)GC_least_plausible_heap_addr));
-        GC_objfreelist[lg] = obj_link(op);
         obj_link(op) = 0;
         GC_bytes_allocd += GRANULES_TO_BYTES(lg);
         UNLOCK();
@@ -285,6 +348,26 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_generic_malloc(size_t lb, int k)
    }
 }
 
+#if defined(HEAP_PROFILE) && !defined(THREAD_LOCAL_ALLOC)
+  /* The allocation sampling state (see GC_sample_alloc).  Updated      */
+  /* without synchronization, so the sampling is only approximate if    */
+  /* several threads allocate at once.                                  */
+  STATIC signed_word GC_bytes_until_sample = 0;
+  STATIC word GC_sample_rnd = 0;
+
+  GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_atomic(size_t lb)
+  {
+    return GC_SAMPLE_ALLOC(&GC_bytes_until_sample, &GC_sample_rnd,
+                           GC_core_malloc_atomic(lb), lb);
+  }
+
+  GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc(size_t lb)
+  {
+    return GC_SAMPLE_ALLOC(&GC_bytes_until_sample, &GC_sample_rnd,
+                           GC_core_malloc(lb), lb);
+  }
+#endif /* HEAP_PROFILE && !THREAD_LOCAL_ALLOC */
+
 /* Allocate lb bytes of pointerful, traced, but not collectible data.   */
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_uncollectable(size_t lb)
 {
@@ -299,9 +382,8 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_uncollectable(size_t lb)
                   /* collected anyway.                                  */
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_uobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_uobjfreelist[lg], UNCOLLECTABLE, lg);
         if (EXPECT(op != 0, TRUE)) {
-            GC_uobjfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             /* Mark bit ws already set on free list.  It will be        */
@@ -504,6 +586,9 @@ GC_API void GC_CALL GC_free(void * p)
     ok = &GC_obj_kinds[knd];
     if (EXPECT(ngranules <= MAXOBJGRANULES, TRUE)) {
         LOCK();
+#       ifdef HEAP_PROFILE
+          GC_heap_profile_free((ptr_t)p);
+#       endif
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
                 /* Its unnecessary to clear the mark bit.  If the       */
@@ -513,12 +598,17 @@ GC_API void GC_CALL GC_free(void * p)
             BZERO((word *)p + 1, sz-sizeof(word));
         }
         flh = &(ok -> ok_freelist[ngranules]);
+        FL_LOCK(knd, ngranules);
         obj_link(p) = *flh;
         *flh = (ptr_t)p;
+        FL_UNLOCK(knd, ngranules);
         UNLOCK();
     } else {
         size_t nblocks = OBJ_SZ_TO_BLOCKS(sz);
         LOCK();
+#       ifdef HEAP_PROFILE
+          GC_heap_profile_free((ptr_t)p);
+#       endif
         GC_bytes_freed += sz;
         if (IS_UNCOLLECTABLE(knd)) GC_non_gc_bytes -= sz;
         if (nblocks > 1) {
@@ -556,8 +646,10 @@ GC_API void GC_CALL GC_free(void * p)
             BZERO((word *)p + 1, sz-sizeof(word));
         }
         flh = &(ok -> ok_freelist[ngranules]);
+        FL_LOCK(knd, ngranules);
         obj_link(p) = *flh;
         *flh = (ptr_t)p;
+        FL_UNLOCK(knd, ngranules);
     } else {
         size_t nblocks = OBJ_SZ_TO_BLOCKS(sz);
         GC_bytes_freed += sz;
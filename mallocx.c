@@ -201,8 +201,10 @@ GC_API GC_ATTR_MALLOC void * GC_CALL
     LOCK();
     result = (ptr_t)GC_alloc_large(ADD_SLOP(lb), k, IGNORE_OFF_PAGE);
     if (0 != result) {
-        if (GC_debugging_started) {
-            BZERO(result, n_blocks * HBLKSIZE);
+        if (LAST_HBLK_ZEROED()) {
+            init = FALSE; /* nothing to clear */
+        } else if (GC_debugging_started) {
+            GC_clear_mem(result, n_blocks * HBLKSIZE);
         } else {
 #           ifdef THREADS
               /* Clear any memory that might be used for GC descriptors */
@@ -222,7 +224,7 @@ GC_API GC_ATTR_MALLOC void * GC_CALL
     } else {
         UNLOCK();
         if (init && !GC_debugging_started) {
-            BZERO(result, n_blocks * HBLKSIZE);
+            GC_clear_mem(result, n_blocks * HBLKSIZE);
         }
         return(result);
     }
@@ -262,6 +264,53 @@ GC_API void GC_CALL GC_incr_bytes_freed(size_t n)
                         /* work, since we would have to atomically      */
                         /* update it in GC_malloc, which is too         */
                         /* expensive.)                                  */
+
+  /* Sweep a block from the reclaim list of the given size and kind     */
+  /* without acquiring the GC lock (the list is popped atomically, so   */
+  /* the threads refilling their free lists of different, or even the   */
+  /* same, size classes do not contend).  Returns NULL if the reclaim   */
+  /* lists are frozen by a pending collection or contain no block with  */
+  /* a free object; the caller should then take the slow path.          */
+  STATIC void *GC_reclaim_many_unlocked(size_t lb, struct obj_kind *ok)
+  {
+    struct hblk ** rlh = ok -> ok_reclaim_list;
+    struct hblk * hbp;
+    void *op = NULL;
+
+    if (NULL == rlh) return NULL;
+    rlh += BYTES_TO_GRANULES(lb);
+    if (NULL == (struct hblk *)AO_load((volatile AO_t *)rlh))
+      return NULL; /* Avoid acquiring the mark lock in vain.    */
+    GC_acquire_mark_lock();
+    if (GC_reclaim_lists_frozen) {
+      GC_release_mark_lock();
+      return NULL;
+    }
+    ++ GC_fl_builder_count;
+    GC_release_mark_lock();
+
+    while ((hbp = GC_pop_reclaim_list(rlh)) != NULL) {
+      hdr * hhdr = HDR(hbp);
+      signed_word my_bytes_allocd = 0;
+
+      GC_ASSERT(hhdr -> hb_sz == lb);
+      hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+      op = GC_reclaim_generic(hbp, hhdr, lb, ok -> ok_init, 0,
+                              &my_bytes_allocd);
+      if (op != NULL) {
+        /* See the comment in GC_generic_malloc_many.   */
+        GC_bytes_found += my_bytes_allocd;
+        (void)AO_fetch_and_add(&GC_bytes_allocd_tmp, (AO_t)my_bytes_allocd);
+        break;
+      }
+    }
+
+    GC_acquire_mark_lock();
+    -- GC_fl_builder_count;
+    if (GC_fl_builder_count == 0) GC_notify_all_builder();
+    GC_release_mark_lock();
+    return op;
+  }
 # endif /* PARALLEL_MARK */
 
 /* Return a list of 1 or more objects of the indicated size, linked     */
@@ -279,7 +328,13 @@ GC_API void GC_CALL GC_incr_bytes_freed(size_t n)
 /* since the collector would not retain the entire list if it were      */
 /* invoked just as we were returning.                                   */
 /* Note that the client should usually clear the link field.            */
-GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  GC_INNER void GC_generic_malloc_many_or_region(size_t lb, int k,
+                                                void **result,
+                                                struct bump_region *region)
+#else
+  GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
+#endif
 {
     void *op;
     void *p;
@@ -292,7 +347,9 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     DCL_LOCK_STATE;
 
     GC_ASSERT(lb != 0 && (lb & (GRANULE_BYTES-1)) == 0);
-    if (!SMALL_OBJ(lb)) {
+    /* lb is the size of the objects in the block (i.e., it already     */
+    /* includes EXTRA_BYTES), thus SMALL_OBJ() is not applicable here.  */
+    if (lb > MAXOBJBYTES) {
         op = GC_generic_malloc(lb, k);
         if (EXPECT(0 != op, TRUE))
             obj_link(op) = 0;
@@ -305,6 +362,18 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
       GC_print_all_errors();
     GC_INVOKE_FINALIZERS();
     GC_DBG_COLLECT_AT_MALLOC(lb);
+#   ifdef PARALLEL_MARK
+      /* In the incremental mode, we should do our share of marking     */
+      /* work instead.                                                  */
+      if (GC_parallel && !GC_incremental) {
+        op = GC_reclaim_many_unlocked(lb, ok);
+        if (op != NULL) {
+          *result = op;
+          (void) GC_clear_stack(0);
+          return;
+        }
+      }
+#   endif
     LOCK();
     if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
     /* Do our share of marking work */
@@ -321,9 +390,8 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
         hdr * hhdr;
 
         rlh += lg;
-        while ((hbp = *rlh) != 0) {
+        while ((hbp = GC_pop_reclaim_list(rlh)) != 0) {
             hhdr = HDR(hbp);
-            *rlh = hhdr -> hb_next;
             GC_ASSERT(hhdr -> hb_sz == lb);
             hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
 #           ifdef PARALLEL_MARK
@@ -388,6 +456,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     /* We don't refill it, but we need to use it up before allocating   */
     /* a new block ourselves.                                           */
       opp = &(GC_obj_kinds[k].ok_freelist[lg]);
+      FL_LOCK(k, lg);
       if ( (op = *opp) != 0 ) {
         *opp = 0;
         my_bytes_allocd = 0;
@@ -399,15 +468,35 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
             break;
           }
         }
+        FL_UNLOCK(k, lg);
         GC_bytes_allocd += my_bytes_allocd;
         goto out;
       }
+      FL_UNLOCK(k, lg);
     /* Next try to allocate a new block worth of objects of this size.  */
     {
         struct hblk *h = GC_allochblk(lb, k, 0);
         if (h != 0) {
+          GC_bool clear = (ok -> ok_init || GC_debugging_started)
+                          && !LAST_HBLK_ZEROED();
+
           if (IS_UNCOLLECTABLE(k)) GC_set_hdr_marks(HDR(h));
           GC_bytes_allocd += HBLKSIZE - HBLKSIZE % lb;
+#         ifdef THREAD_LOCAL_BUMP_ALLOC
+            if (region != NULL) {
+              GC_ASSERT(!IS_UNCOLLECTABLE(k));
+              region -> cur = (ptr_t)h;
+              region -> limit = (ptr_t)h + (HBLKSIZE - HBLKSIZE % lb);
+              *result = 0;
+              UNLOCK();
+              /* A collection only sets the mark bits of the region     */
+              /* objects, so the block can be cleared without the lock. */
+              if (clear)
+                GC_clear_mem(h, HBLKSIZE);
+              (void) GC_clear_stack(0);
+              return;
+            }
+#         endif
 #         ifdef PARALLEL_MARK
             if (GC_parallel) {
               GC_acquire_mark_lock();
@@ -415,8 +504,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               UNLOCK();
               GC_release_mark_lock();
 
-              op = GC_build_fl(h, lw,
-                        (ok -> ok_init || GC_debugging_started), 0);
+              op = GC_build_fl(h, lw, clear, 0);
 
               *result = op;
               GC_acquire_mark_lock();
@@ -427,7 +515,7 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
               return;
             }
 #         endif
-          op = GC_build_fl(h, lw, (ok -> ok_init || GC_debugging_started), 0);
+          op = GC_build_fl(h, lw, clear, 0);
           goto out;
         }
     }
@@ -443,6 +531,13 @@ GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
     (void) GC_clear_stack(0);
 }
 
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  GC_API void GC_CALL GC_generic_malloc_many(size_t lb, int k, void **result)
+  {
+    GC_generic_malloc_many_or_region(lb, k, result, NULL);
+  }
+#endif
+
 /* Note that the "atomic" version of this would be unsafe, since the    */
 /* links would not be seen by the collector.                            */
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_many(size_t lb)
@@ -454,6 +549,59 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_many(size_t lb)
     return result;
 }
 
+GC_INNER size_t GC_generic_malloc_n(size_t lb, int k, size_t n, void **out)
+{
+    size_t i = 0;
+    size_t batch;
+    DCL_LOCK_STATE;
+
+    if (EXPECT(GC_have_errors, FALSE))
+      GC_print_all_errors();
+    GC_INVOKE_FINALIZERS();
+    GC_DBG_COLLECT_AT_MALLOC(lb);
+    if (!SMALL_OBJ(lb)) {
+      /* Large objects are cleared without the lock.    */
+      for (; i < n; ++i) {
+        out[i] = GC_generic_malloc(lb, k);
+        if (EXPECT(NULL == out[i], FALSE)) break;
+      }
+      return i;
+    }
+    /* Do not hold the lock for longer than allocating about a block    */
+    /* of objects takes.                                                */
+    batch = HBLKSIZE / (lb > GRANULE_BYTES ? lb : GRANULE_BYTES);
+    while (i < n) {
+      size_t batch_end = n - i > batch ? i + batch : n;
+      void *op = NULL;
+
+      LOCK();
+      for (; i < batch_end; ++i) {
+        op = GC_generic_malloc_inner(lb, k);
+        if (EXPECT(NULL == op, FALSE)) break;
+        out[i] = op;
+      }
+      UNLOCK();
+      if (EXPECT(NULL == op, FALSE)) {
+        op = (*GC_get_oom_fn())(lb);
+        if (NULL == op) break;
+        out[i++] = op;
+      }
+    }
+    return i;
+}
+
+#ifndef THREAD_LOCAL_ALLOC
+  GC_API size_t GC_CALL GC_malloc_n(size_t lb, size_t n, void **out)
+  {
+    return GC_generic_malloc_n(lb, NORMAL, n, out);
+  }
+
+  GC_API size_t GC_CALL GC_malloc_atomic_n(size_t lb, size_t n, void **out)
+  {
+    return GC_generic_malloc_n(lb, PTRFREE, n, out);
+  }
+#endif /* !THREAD_LOCAL_ALLOC */
+
 /* Not well tested nor integrated.      */
 /* Debug version is tricky and currently missing.       */
 #include <limits.h>
@@ -531,9 +679,8 @@ GC_API int GC_CALL GC_posix_memalign(void **memptr, size_t align, size_t lb)
                   /* collected anyway.                                  */
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_auobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_auobjfreelist[lg], AUNCOLLECTABLE, lg);
         if (EXPECT(op != 0, TRUE)) {
-            GC_auobjfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             /* Mark bit was already set while object was on free list. */
@@ -48,25 +48,25 @@ GC_INNER unsigned GC_n_mark_procs = GC_RESERVED_MARK_PROCS;
 /* It's done here, since we need to deal with mark descriptors.         */
 GC_INNER struct obj_kind GC_obj_kinds[MAXOBJKINDS] = {
 /* PTRFREE */ { &GC_aobjfreelist[0], 0 /* filled in dynamically */,
-                0 | GC_DS_LENGTH, FALSE, FALSE
+                0 | GC_DS_LENGTH, FALSE, FALSE, 0, 0
                 /*, */ OK_DISCLAIM_INITZ },
 /* NORMAL  */ { &GC_objfreelist[0], 0,
                 0 | GC_DS_LENGTH,  /* Adjusted in GC_init for EXTRA_BYTES */
-                TRUE /* add length to descr */, TRUE
+                TRUE /* add length to descr */, TRUE, 0, 0
                 /*, */ OK_DISCLAIM_INITZ },
 /* UNCOLLECTABLE */
               { &GC_uobjfreelist[0], 0,
-                0 | GC_DS_LENGTH, TRUE /* add length to descr */, TRUE
+                0 | GC_DS_LENGTH, TRUE /* add length to descr */, TRUE, 0, 0
                 /*, */ OK_DISCLAIM_INITZ },
 # ifdef ATOMIC_UNCOLLECTABLE
    /* AUNCOLLECTABLE */
               { &GC_auobjfreelist[0], 0,
-                0 | GC_DS_LENGTH, FALSE /* add length to descr */, FALSE
+                0 | GC_DS_LENGTH, FALSE /* add length to descr */, FALSE, 0, 0
                 /*, */ OK_DISCLAIM_INITZ },
 # endif
 # ifdef STUBBORN_ALLOC
 /*STUBBORN*/ { (void **)&GC_sobjfreelist[0], 0,
-                0 | GC_DS_LENGTH, TRUE /* add length to descr */, TRUE
+                0 | GC_DS_LENGTH, TRUE /* add length to descr */, TRUE, 0, 0
                 /*, */ OK_DISCLAIM_INITZ },
 # endif
 };
@@ -590,6 +590,142 @@ GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp)
     return(msp - GC_MARK_STACK_DISCARDS);
 }
 
+#ifdef SIMD_SCAN
+# include <immintrin.h>
+
+  /* The conservative scan kernels.  Each returns the address of the   */
+  /* first word in [p, lim] (both are word-aligned) which passes the   */
+  /* preliminary pointer validity test (i.e. lo <= value < hi), or an  */
+  /* address greater than lim if there is none.  The test is done as  */
+  /* an unsigned comparison of value - lo against hi - lo.             */
+  typedef ptr_t (*GC_scan_kernel_t)(ptr_t p, ptr_t lim, word lo, word hi);
+
+  STATIC ptr_t GC_scan_kernel_scalar(ptr_t p, ptr_t lim, word lo, word hi)
+  {
+    word range = hi - lo;
+
+    for (; (word)p <= (word)lim; p += sizeof(word)) {
+      if (*(word *)p - lo < range) break;
+    }
+    return p;
+  }
+
+  /* SSE2 lacks the 64-bit comparison, so only the high halves of     */
+  /* value - lo are compared (as signed after biasing) to those of     */
+  /* hi - lo; the words passing this coarser test are checked again.  */
+  STATIC ptr_t GC_scan_kernel_sse2(ptr_t p, ptr_t lim, word lo, word hi)
+  {
+    word range = hi - lo;
+    const __m128i bias = _mm_set1_epi32((int)0x80000000UL);
+    const __m128i vlo = _mm_set1_epi64x((long long)lo);
+    const __m128i vrange = _mm_xor_si128(_mm_set1_epi64x((long long)range),
+                                         bias);
+
+    /* Test 4 words per iteration (2 vectors).  */
+    for (; (word)p + 3 * sizeof(word) <= (word)lim; p += 4 * sizeof(word)) {
+      __m128i gt0 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi64(
+                        _mm_loadu_si128((__m128i *)p), vlo), bias), vrange);
+      __m128i gt1 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi64(
+                        _mm_loadu_si128((__m128i *)p + 1), vlo), bias),
+                        vrange);
+      /* Bits 1, 3, 5 and 7 correspond to the high halves.      */
+      int mask = ~(_mm_movemask_ps(_mm_castsi128_ps(gt0))
+                   | (_mm_movemask_ps(_mm_castsi128_ps(gt1)) << 4)) & 0xaa;
+
+      while (mask != 0) {
+        int i = __builtin_ctz((unsigned)mask) >> 1;
+
+        if (((word *)p)[i] - lo < range)
+          return p + i * sizeof(word);
+        mask &= mask - 1;
+      }
+    }
+    return GC_scan_kernel_scalar(p, lim, lo, hi);
+  }
+
+  __attribute__((__target__("avx2")))
+  STATIC ptr_t GC_scan_kernel_avx2(ptr_t p, ptr_t lim, word lo, word hi)
+  {
+    const __m256i sign = _mm256_set1_epi64x((long long)SIGNB);
+    const __m256i vlo = _mm256_set1_epi64x((long long)lo);
+    const __m256i vrange = _mm256_set1_epi64x((long long)((hi - lo)
+                                                          ^ SIGNB));
+
+    /* Test 8 words per iteration (2 vectors).  */
+    for (; (word)p + 7 * sizeof(word) <= (word)lim; p += 8 * sizeof(word)) {
+      __m256i d0 = _mm256_xor_si256(_mm256_sub_epi64(
+                        _mm256_loadu_si256((__m256i *)p), vlo), sign);
+      __m256i d1 = _mm256_xor_si256(_mm256_sub_epi64(
+                        _mm256_loadu_si256((__m256i *)p + 1), vlo), sign);
+      int mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+                                        _mm256_cmpgt_epi64(vrange, d0)))
+                 | (_mm256_movemask_pd(_mm256_castsi256_pd(
+                                        _mm256_cmpgt_epi64(vrange, d1))) << 4);
+
+      if (mask != 0)
+        return p + __builtin_ctz((unsigned)mask) * sizeof(word);
+    }
+    return GC_scan_kernel_scalar(p, lim, lo, hi);
+  }
+
+  __attribute__((__target__("avx512f")))
+  STATIC ptr_t GC_scan_kernel_avx512(ptr_t p, ptr_t lim, word lo, word hi)
+  {
+    const __m512i vlo = _mm512_set1_epi64((long long)lo);
+    const __m512i vrange = _mm512_set1_epi64((long long)(hi - lo));
+
+    for (; (word)p + 7 * sizeof(word) <= (word)lim; p += 8 * sizeof(word)) {
+      __mmask8 mask = _mm512_cmplt_epu64_mask(
+                        _mm512_sub_epi64(_mm512_loadu_si512((void *)p), vlo),
+                        vrange);
+
+      if (mask != 0)
+        return p + __builtin_ctz((unsigned)mask) * sizeof(word);
+    }
+    return GC_scan_kernel_scalar(p, lim, lo, hi);
+  }
+
+  STATIC GC_scan_kernel_t GC_scan_kernel = GC_scan_kernel_sse2;
+
+  /* Choose the widest kernel supported by the CPU, unless a narrower   */
+  /* one is requested by GC_SCAN_KERNEL environment variable.           */
+  STATIC void GC_init_scan_kernel(void)
+  {
+    static const char * const names[] = {
+                "scalar", "sse2", "avx2", "avx512" };
+    static const GC_scan_kernel_t kernels[] = {
+                GC_scan_kernel_scalar, GC_scan_kernel_sse2,
+                GC_scan_kernel_avx2, GC_scan_kernel_avx512 };
+    char * str = GETENV("GC_SCAN_KERNEL");
+    int i = 1; /* SSE2 is always available on x86_64 */
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      i = 2;
+      if (__builtin_cpu_supports("avx512f")) i = 3;
+    }
+    if (str != NULL) {
+      int j;
+
+      for (j = 0; j < i; j++) {
+        if (strcmp(str, names[j]) == 0) {
+          i = j;
+          break;
+        }
+      }
+    }
+    GC_scan_kernel = kernels[i];
+    GC_COND_LOG_PRINTF("Using %s conservative scan kernel\n", names[i]);
+  }
+
+# ifndef SIMD_SCAN_MIN_BYTES
+    /* The shorter ranges are scanned by the generic code.      */
+#   define SIMD_SCAN_MIN_BYTES (8 * sizeof(word))
+# endif
+#endif /* SIMD_SCAN */
+
+GC_INNER hdr_cache_t GC_main_hdr_cache;
+
 /*
  * Mark objects pointed to by the regions described by
  * mark stack entries between mark_stack and mark_stack_top,
@@ -605,7 +741,7 @@ GC_INNER mse * GC_signal_mark_stack_overflow(mse *msp)
  * header mapping, we prefetch when an object is "grayed", etc.
  */
 GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
-                            mse *mark_stack_limit)
+                            mse *mark_stack_limit, hdr_cache_t *hc)
 {
   signed_word credit = HBLKSIZE;  /* Remaining credit for marking work  */
   ptr_t current_p;      /* Pointer to current candidate ptr.    */
@@ -614,12 +750,12 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
   word descr;
   ptr_t greatest_ha = GC_greatest_plausible_heap_addr;
   ptr_t least_ha = GC_least_plausible_heap_addr;
-  DECLARE_HDR_CACHE;
+  USE_HDR_CACHE(hc);
 
 # define SPLIT_RANGE_WORDS 128  /* Must be power of 2.          */
 
   GC_objects_are_marked = TRUE;
-  INIT_HDR_CACHE;
+  VALIDATE_HDR_CACHE;
 # ifdef OS2 /* Use untweaked version to circumvent compiler problem */
     while ((word)mark_stack_top >= (word)mark_stack && credit >= 0)
 # else
@@ -791,6 +927,30 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
     GC_ASSERT(!((word)current_p & (ALIGNMENT-1)));
     credit -= limit - current_p;
     limit -= sizeof(word);
+#   ifdef SIMD_SCAN
+      if ((word)limit - (word)current_p >= SIMD_SCAN_MIN_BYTES) {
+        /* Skip the words failing the preliminary pointer validity     */
+        /* test several at a time, only the candidates are examined    */
+        /* individually.                                               */
+        for (;;) {
+          current_p = GC_scan_kernel(current_p, limit, (word)least_ha,
+                                     (word)greatest_ha);
+          if ((word)current_p > (word)limit) break;
+          current = *(word *)current_p;
+          PREFETCH((ptr_t)current);
+#         ifdef ENABLE_TRACE
+            if (GC_trace_addr == current_p) {
+              GC_log_printf("GC #%u: considering(3) %p -> %p\n",
+                            (unsigned)GC_gc_no, current_p, (ptr_t)current);
+            }
+#         endif /* ENABLE_TRACE */
+          PUSH_CONTENTS((ptr_t)current, mark_stack_top,
+                        mark_stack_limit, current_p, exit5);
+          current_p += ALIGNMENT;
+        }
+        continue;
+      }
+#   endif
     {
 #     define PREF_DIST 4
 
@@ -872,22 +1032,130 @@ GC_INNER mse * GC_mark_from(mse *mark_stack_top, mse *mark_stack,
 #ifdef PARALLEL_MARK
 
 STATIC GC_bool GC_help_wanted = FALSE;  /* Protected by mark lock       */
-STATIC unsigned GC_helper_count = 0;    /* Number of running helpers.   */
-                                        /* Protected by mark lock       */
-STATIC unsigned GC_active_count = 0;    /* Number of active helpers.    */
-                                        /* Protected by mark lock       */
-                                        /* May increase and decrease    */
-                                        /* within each mark cycle.  But */
-                                        /* once it returns to 0, it     */
-                                        /* stays zero for the cycle.    */
+STATIC volatile AO_t GC_helper_count = 0;
+                        /* Number of running helpers.  Incremented      */
+                        /* (atomically) holding mark lock, decremented  */
+                        /* atomically.                                  */
+STATIC unsigned GC_helper_next_id = 0;
+                        /* The id to give to the next helper joining    */
+                        /* the current phase.  Only increases during a  */
+                        /* phase, so that the ids are never reused by   */
+                        /* the helpers of the same phase.  Protected by */
+                        /* mark lock.                                   */
+STATIC volatile AO_t GC_active_count = 0;
+                        /* Number of helpers holding some mark work.    */
+                        /* Updated atomically.  A helper increments it  */
+                        /* before taking an entry from a shared place,  */
+                        /* and decrements it only once it has nothing   */
+                        /* left (and all its surplus entries are        */
+                        /* visible to the others).                      */
+STATIC volatile AO_t GC_mark_done = FALSE;
+                        /* Set once there is neither an active helper   */
+                        /* nor visible work.  Then it stays set for     */
+                        /* the rest of the mark phase.                  */
+STATIC void (*GC_helper_task)(unsigned) = 0;
+                        /* What the helpers joining the current phase   */
+                        /* should do instead of marking (see            */
+                        /* GC_run_on_markers), or 0.  Protected by mark */
+                        /* lock.                                        */
 
 GC_INNER word GC_mark_no = 0;
 
+STATIC hdr_cache_t *GC_helper_hdr_caches = NULL;
+                        /* The header caches of the markers 1 .. n.     */
+                        /* Allocated by GC_do_parallel_mark.            */
+STATIC unsigned GC_n_helper_hdr_caches = 0;
+
+GC_INNER hdr_cache_t *GC_marker_hdr_cache(unsigned id)
+{
+    if (0 == id) return &GC_main_hdr_cache;
+    GC_ASSERT(id <= GC_n_helper_hdr_caches);
+    return GC_helper_hdr_caches + (id - 1);
+}
+
 #define LOCAL_MARK_STACK_SIZE HBLKSIZE
         /* Under normal circumstances, this is big enough to guarantee  */
         /* we don't overflow half of it in a single call to             */
         /* GC_mark_from.                                                */
 
+/* A waiting marker thread (a helper waiting for a mark phase to start, */
+/* an idle helper waiting for more work or for termination, and the     */
+/* initiating thread waiting for helpers to finish) spins for a while   */
+/* first, and then parks until GC_mark_epoch is changed.  The spin      */
+/* limit is adjusted depending on whether spinning paid off recently.   */
+/* Whoever changes the state somebody might wait for should call        */
+/* GC_unpark_markers after the change; it increments the epoch, and     */
+/* wakes up the parked threads (there are usually none).  On Linux,     */
+/* parking is done with futex directly, otherwise the mark lock and     */
+/* condition variable are used.                                         */
+STATIC volatile AO_t GC_mark_epoch = 0;
+STATIC volatile AO_t GC_parked_markers = 0;
+
+#ifndef MARKER_SPIN_MAX
+# define MARKER_SPIN_MAX 8192
+#endif
+#define MARKER_SPIN_MIN 32
+
+STATIC volatile AO_t GC_marker_spin_limit = MARKER_SPIN_MAX;
+
+#if defined(__GNUC__) && (defined(I386) || defined(X86_64))
+# define MARKER_PAUSE() __asm__ __volatile__ ("pause" : : : "memory")
+#else
+# define MARKER_PAUSE() AO_compiler_barrier()
+#endif
+
+STATIC void GC_unpark_markers(void)
+{
+    AO_nop_full(); /* The state change should be visible first.    */
+    if (AO_load(&GC_parked_markers) == 0) return;
+    (void)AO_fetch_and_add1(&GC_mark_epoch);
+#   ifdef USE_MARKER_FUTEX
+      GC_futex_wake_all(&GC_mark_epoch);
+#   else
+      /* Acquiring the mark lock ensures that a thread which has seen   */
+      /* the old epoch is already waiting on the condition variable.    */
+      GC_acquire_mark_lock();
+      GC_release_mark_lock();
+      GC_notify_all_marker();
+#   endif
+}
+
+/* Wait until ready(arg) returns true.  Caller does not hold mark lock. */
+STATIC void GC_marker_wait(GC_bool (*ready)(void *), void *arg)
+{
+    word spin_limit = AO_load(&GC_marker_spin_limit);
+    word i;
+
+    for (i = 0; i < spin_limit; ++i) {
+      if (ready(arg)) {
+        if (spin_limit < MARKER_SPIN_MAX)
+          AO_store(&GC_marker_spin_limit, spin_limit * 2);
+        return;
+      }
+      MARKER_PAUSE();
+    }
+    if (spin_limit > MARKER_SPIN_MIN)
+      AO_store(&GC_marker_spin_limit, spin_limit / 2);
+
+    (void)AO_fetch_and_add1(&GC_parked_markers);
+    for (;;) {
+      AO_t epoch;
+
+      AO_nop_full(); /* Order the counter update before state reads.   */
+      epoch = AO_load(&GC_mark_epoch);
+      if (ready(arg)) break;
+#     ifdef USE_MARKER_FUTEX
+        GC_futex_wait(&GC_mark_epoch, epoch);
+#     else
+        GC_acquire_mark_lock();
+        while (AO_load(&GC_mark_epoch) == epoch) {
+          GC_wait_marker();
+        }
+        GC_release_mark_lock();
+#     endif
+    }
+    (void)AO_fetch_and_sub1(&GC_parked_markers);
+}
 
 /* Steal mark stack entries starting at mse low into mark stack local   */
 /* until we either steal mse high, or we have max entries.              */
@@ -954,14 +1222,286 @@ STATIC void GC_return_mark_stack(mse * low, mse * high)
                 /* Ensures visibility of previously written stack contents. */
     }
     GC_release_mark_lock();
-    GC_notify_all_marker();
+    GC_unpark_markers();
+}
+
+#define ENTRIES_TO_GET 5
+
+/* Take a few entries from the global mark stack (above                 */
+/* *pmy_first_nonempty) to the local one.  Return the local stack top   */
+/* (which is below local_mark_stack if nothing was found).  Caller      */
+/* should be counted in GC_active_count.                                */
+STATIC mse * GC_steal_global_mark_stack(mse *local_mark_stack,
+                                        mse **pmy_first_nonempty)
+{
+    mse * my_first_nonempty = *pmy_first_nonempty;
+    mse * global_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
+    mse * my_top;
+    mse * local_top = local_mark_stack - 1;
+    size_t n_on_stack;
+
+    GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
+              (word)my_first_nonempty <=
+                    (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
+                    + sizeof(mse));
+    GC_ASSERT((word)global_first_nonempty >= (word)GC_mark_stack &&
+              (word)global_first_nonempty <=
+                    (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
+                    + sizeof(mse));
+    if ((word)my_first_nonempty < (word)global_first_nonempty) {
+        my_first_nonempty = global_first_nonempty;
+    } else if ((word)global_first_nonempty < (word)my_first_nonempty) {
+        AO_compare_and_swap(&GC_first_nonempty,
+                            (AO_t) global_first_nonempty,
+                            (AO_t) my_first_nonempty);
+        /* If this fails, we just go ahead, without updating    */
+        /* GC_first_nonempty.                                   */
+    }
+    /* Perhaps we should also update GC_first_nonempty, if it */
+    /* is less.  But that would require using atomic updates. */
+    my_top = (mse *)AO_load_acquire((volatile AO_t *)(&GC_mark_stack_top));
+    n_on_stack = my_top - my_first_nonempty + 1;
+    if ((signed_word)n_on_stack > 0) {
+        unsigned n_to_get = ENTRIES_TO_GET;
+
+        if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
+        local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
+                                        local_mark_stack, n_to_get,
+                                        &my_first_nonempty);
+        GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
+                  (word)my_first_nonempty <=
+                        (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
+                        + sizeof(mse));
+    }
+    *pmy_first_nonempty = my_first_nonempty;
+    return local_top;
+}
+
+#ifdef USE_MARK_DEQUES
+/* Per-marker work-stealing deques, in the spirit of Chase and Lev.     */
+/* Each marker owns a deque; it pushes surplus entries of its local     */
+/* mark stack at the bottom end and pops them back from there without   */
+/* any atomic read-modify-write operation (except when racing for the   */
+/* last entry).  Markers running out of work steal single entries from  */
+/* the top end of a randomly chosen peer deque by compare-and-swap.     */
+/* The global mark stack is still used for the entries pushed by the    */
+/* initiating thread (roots, etc.), and as an overflow area for the     */
+/* entries that do not fit into a deque.  Thus there is no single       */
+/* structure all markers contend for once marking is under way.         */
+
+# ifndef MARK_DEQUE_SIZE
+#   define MARK_DEQUE_SIZE LOCAL_MARK_STACK_SIZE
+                        /* Number of entries per deque; a power of 2.   */
+# endif
+
+typedef struct {
+    volatile AO_t md_top;       /* Index of the oldest entry.  Advanced */
+                                /* by thieves (and by the owner when    */
+                                /* competing for the last entry) using  */
+                                /* compare-and-swap.                    */
+    volatile AO_t md_bottom;    /* Index just past the newest entry.    */
+                                /* Updated only by the owner.           */
+    mse *md_entries;            /* Circular buffer of MARK_DEQUE_SIZE   */
+                                /* entries.                             */
+} GC_mark_deque;
+
+STATIC GC_mark_deque *GC_mark_deques = NULL;
+                                /* Indexed by the marker id.  Allocated */
+                                /* by GC_do_parallel_mark.              */
+STATIC unsigned GC_n_mark_deques = 0;
+
+STATIC volatile AO_t GC_mark_steals = 0;
+                        /* Number of entries stolen from peer deques    */
+                        /* in the current mark phase.                   */
+
+/* Add *e to the bottom of deque d.  Called only by the owner.  Return  */
+/* FALSE if the deque is full.                                          */
+STATIC GC_bool GC_mark_deque_push(GC_mark_deque *d, const mse *e)
+{
+    AO_t b = d -> md_bottom;
+    mse *slot;
+
+    if (b - AO_load_acquire(&d->md_top) >= MARK_DEQUE_SIZE) return FALSE;
+    slot = d -> md_entries + (b & (MARK_DEQUE_SIZE - 1));
+    slot -> mse_start = e -> mse_start;
+    slot -> mse_descr.w = e -> mse_descr.w;
+    AO_store_release(&d->md_bottom, b + 1);
+    return TRUE;
+}
+
+/* Remove the newest entry of deque d, and store it to *e.  Called only */
+/* by the owner.  Return FALSE if the deque is empty.                   */
+STATIC GC_bool GC_mark_deque_pop(GC_mark_deque *d, mse *e)
+{
+    AO_t b = d -> md_bottom;
+    AO_t t;
+    mse *slot;
+    GC_bool result;
+
+    if (b == AO_load(&d->md_top)) return FALSE;
+    AO_store(&d->md_bottom, --b);
+    AO_nop_full(); /* The store above should be visible before top read. */
+    t = AO_load(&d->md_top);
+    if ((signed_word)(b - t) < 0) {
+      /* A thief took the last entry.   */
+      AO_store(&d->md_bottom, t);
+      return FALSE;
+    }
+    slot = d -> md_entries + (b & (MARK_DEQUE_SIZE - 1));
+    e -> mse_start = slot -> mse_start;
+    e -> mse_descr.w = slot -> mse_descr.w;
+    if (b != t) return TRUE;
+    /* This is the last entry; compete with thieves for it.     */
+    result = AO_compare_and_swap_full(&d->md_top, t, t + 1);
+    AO_store(&d->md_bottom, t + 1);
+    return result;
+}
+
+/* Try to remove the oldest entry of the deque d owned by another       */
+/* marker, and store it to *e.  Return FALSE on failure.                */
+STATIC GC_bool GC_mark_deque_steal(GC_mark_deque *d, mse *e)
+{
+    AO_t t = AO_load_acquire(&d->md_top);
+    AO_t b;
+    volatile mse *slot;
+
+    AO_nop_full();
+    b = AO_load_acquire(&d->md_bottom);
+    if ((signed_word)(b - t) <= 0) return FALSE;
+    slot = d -> md_entries + (t & (MARK_DEQUE_SIZE - 1));
+    e -> mse_start = slot -> mse_start;
+    e -> mse_descr.w = slot -> mse_descr.w;
+    /* The slot cannot be reused by the owner until top is advanced.    */
+    return AO_compare_and_swap_full(&d->md_top, t, t + 1);
+}
+
+/* Move the older half of the local mark stack (those entries are       */
+/* likely to require more work) to our deque, where it is available to  */
+/* idle markers.  The entries which do not fit into the deque are       */
+/* copied to the global mark stack.  Returns the new local stack top.   */
+STATIC mse * GC_share_mark_entries(GC_mark_deque *d, mse *local_mark_stack,
+                                   mse *local_top)
+{
+    size_t n_to_share = (local_top - local_mark_stack + 1) / 2;
+    size_t i;
+
+    for (i = 0; i < n_to_share; ++i) {
+      if (!GC_mark_deque_push(d, local_mark_stack + i)) {
+        GC_return_mark_stack(local_mark_stack + i,
+                             local_mark_stack + n_to_share - 1);
+        break;
+      }
+    }
+    memmove(local_mark_stack, local_mark_stack + n_to_share,
+            (local_top - local_mark_stack + 1 - n_to_share) * sizeof(mse));
+    local_top -= n_to_share;
+    GC_unpark_markers();
+    return local_top;
+}
+
+/* Mark from the local mark stack.  On return, the local mark stack is  */
+/* empty.  The surplus entries are shared through our deque d.          */
+STATIC void GC_do_local_mark(GC_mark_deque *d, mse *local_mark_stack,
+                             mse *local_top, hdr_cache_t *hc)
+{
+#   ifdef GC_ASSERTIONS
+      /* Make sure we don't hold mark lock. */
+        GC_acquire_mark_lock();
+        GC_release_mark_lock();
+#   endif
+    for (;;) {
+        local_top = GC_mark_from(local_top, local_mark_stack,
+                                 local_mark_stack + LOCAL_MARK_STACK_SIZE,
+                                 hc);
+        if ((word)local_top < (word)local_mark_stack) return;
+        if ((word)(local_top - local_mark_stack)
+                >= LOCAL_MARK_STACK_SIZE / 2
+            || ((word)local_top > (word)(local_mark_stack + 1)
+                && AO_load(&GC_active_count) < AO_load(&GC_helper_count)
+                && AO_load(&d->md_bottom) == AO_load(&d->md_top))) {
+            /* Either the local stack is filling up, or some markers    */
+            /* are waiting for work and have already taken everything   */
+            /* we shared previously.                                    */
+            local_top = GC_share_mark_entries(d, local_mark_stack,
+                                              local_top);
+        }
+    }
 }
 
+/* Find some work for marker id: first in its own deque, then on the    */
+/* global mark stack, and then in the deque of a random peer.  Return   */
+/* the local mark stack top (below local_mark_stack if nothing found).  */
+STATIC mse * GC_find_mark_work(mse *local_mark_stack, int id,
+                               mse **pmy_first_nonempty, word *prnd)
+{
+    mse * local_top;
+    unsigned i;
+
+    if (GC_mark_deque_pop(GC_mark_deques + id, local_mark_stack))
+      return local_mark_stack;
+    local_top = GC_steal_global_mark_stack(local_mark_stack,
+                                           pmy_first_nonempty);
+    if ((word)local_top >= (word)local_mark_stack) return local_top;
+    *prnd = *prnd * 1103515245 + 12345;
+    for (i = 0; i < GC_n_mark_deques; ++i) {
+      unsigned victim = (unsigned)((*prnd >> 16) + i) % GC_n_mark_deques;
+
+      if (victim != (unsigned)id
+          && GC_mark_deque_steal(GC_mark_deques + victim, local_mark_stack)) {
+        (void)AO_fetch_and_add1(&GC_mark_steals);
+        return local_mark_stack;
+      }
+    }
+    return local_top;
+}
+#endif /* USE_MARK_DEQUES */
+
+/* Is there anything left to mark on the global mark stack (or in any   */
+/* deque)?  The result is advisory.                                     */
+STATIC GC_bool GC_mark_work_visible(void)
+{
+    if ((word)AO_load(&GC_first_nonempty)
+        <= (word)AO_load((volatile AO_t *)&GC_mark_stack_top))
+      return TRUE;
+#   ifdef USE_MARK_DEQUES
+      {
+        unsigned i;
+
+        for (i = 0; i < GC_n_mark_deques; ++i) {
+          GC_mark_deque *d = GC_mark_deques + i;
+
+          if ((signed_word)(AO_load(&d->md_bottom)
+                            - AO_load(&d->md_top)) > 0)
+            return TRUE;
+        }
+      }
+#   endif
+    return FALSE;
+}
+
+/* The readiness test for an idle helper.  Work can only be published,  */
+/* and taken from a shared place, by active helpers.  Hence, if no work */
+/* is visible, and then no helper is active, the mark phase is over.    */
+STATIC GC_bool GC_mark_work_or_done(void *arg GC_ATTR_UNUSED)
+{
+    if (AO_load_acquire(&GC_mark_done)) return TRUE;
+    if (GC_mark_work_visible()) return TRUE;
+    AO_nop_full(); /* Check for work before checking the counter.      */
+    if (AO_load(&GC_active_count) == 0) {
+      AO_store_release(&GC_mark_done, TRUE);
+      GC_unpark_markers();
+      return TRUE;
+    }
+    return FALSE;
+}
+
+#ifndef USE_MARK_DEQUES
 /* Mark from the local mark stack.              */
 /* On return, the local mark stack is empty.    */
 /* But this may be achieved by copying the      */
 /* local mark stack back into the global one.   */
-STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
+STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top,
+                             hdr_cache_t *hc)
 {
     unsigned n;
 #   define N_LOCAL_ITERS 1
@@ -974,7 +1514,8 @@ STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
     for (;;) {
         for (n = 0; n < N_LOCAL_ITERS; ++n) {
             local_top = GC_mark_from(local_top, local_mark_stack,
-                                     local_mark_stack + LOCAL_MARK_STACK_SIZE);
+                                     local_mark_stack + LOCAL_MARK_STACK_SIZE,
+                                     hc);
             if ((word)local_top < (word)local_mark_stack) return;
             if ((word)(local_top - local_mark_stack)
                         >= LOCAL_MARK_STACK_SIZE / 2) {
@@ -984,7 +1525,7 @@ STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
         }
         if ((word)AO_load((volatile AO_t *)&GC_mark_stack_top)
             < (word)AO_load(&GC_first_nonempty)
-            && GC_active_count < GC_helper_count
+            && AO_load(&GC_active_count) < AO_load(&GC_helper_count)
             && (word)local_top > (word)(local_mark_stack + 1)) {
             /* Try to share the load, since the main stack is empty,    */
             /* and helper threads are waiting for a refill.             */
@@ -1002,182 +1543,231 @@ STATIC void GC_do_local_mark(mse *local_mark_stack, mse *local_top)
         }
     }
 }
+#endif /* !USE_MARK_DEQUES */
 
-#define ENTRIES_TO_GET 5
-
-/* Mark using the local mark stack until the global mark stack is empty */
-/* and there are no active workers. Update GC_first_nonempty to reflect */
-/* progress.                                                            */
-/* Caller does not hold mark lock.                                      */
-/* Caller has already incremented GC_helper_count.  We decrement it,    */
-/* and maintain GC_active_count.                                        */
+/* Mark until the mark phase is done, i.e. there is no visible work and */
+/* no active helper.  Caller does not hold mark lock.                   */
 STATIC void GC_mark_local(mse *local_mark_stack, int id)
 {
-    mse * my_first_nonempty;
+    mse * my_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
+    hdr_cache_t *hc = GC_marker_hdr_cache((unsigned)id);
+#   ifdef USE_MARK_DEQUES
+      word rnd_state = (word)id * 2654435761U + 1;
 
-    GC_acquire_mark_lock();
-    GC_active_count++;
-    my_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
+      GC_ASSERT((unsigned)id < GC_n_mark_deques);
+#   endif
     GC_ASSERT((word)GC_mark_stack <= (word)my_first_nonempty);
-    GC_ASSERT((word)my_first_nonempty
-        <= (word)AO_load((volatile AO_t *)&GC_mark_stack_top) + sizeof(mse));
     GC_VERBOSE_LOG_PRINTF("Starting mark helper %lu\n", (unsigned long)id);
-    GC_release_mark_lock();
     for (;;) {
-        size_t n_on_stack;
-        unsigned n_to_get;
-        mse * my_top;
-        mse * local_top;
-        mse * global_first_nonempty = (mse *)AO_load(&GC_first_nonempty);
-
-        GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
-                  (word)my_first_nonempty <=
-                        (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
-                        + sizeof(mse));
-        GC_ASSERT((word)global_first_nonempty >= (word)GC_mark_stack &&
-                  (word)global_first_nonempty <=
-                        (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
-                        + sizeof(mse));
-        if ((word)my_first_nonempty < (word)global_first_nonempty) {
-            my_first_nonempty = global_first_nonempty;
-        } else if ((word)global_first_nonempty < (word)my_first_nonempty) {
-            AO_compare_and_swap(&GC_first_nonempty,
-                                (AO_t) global_first_nonempty,
-                                (AO_t) my_first_nonempty);
-            /* If this fails, we just go ahead, without updating        */
-            /* GC_first_nonempty.                                       */
+        if (!GC_mark_work_visible()) {
+            GC_marker_wait(GC_mark_work_or_done, NULL);
+            if (AO_load_acquire(&GC_mark_done)) break;
         }
-        /* Perhaps we should also update GC_first_nonempty, if it */
-        /* is less.  But that would require using atomic updates. */
-        my_top = (mse *)AO_load_acquire((volatile AO_t *)(&GC_mark_stack_top));
-        n_on_stack = my_top - my_first_nonempty + 1;
-        if (0 == n_on_stack) {
-            GC_acquire_mark_lock();
-            my_top = GC_mark_stack_top;
-                /* Asynchronous modification impossible here,   */
-                /* since we hold mark lock.                     */
-            n_on_stack = my_top - my_first_nonempty + 1;
-            if (0 == n_on_stack) {
-                GC_active_count--;
-                GC_ASSERT(GC_active_count <= GC_helper_count);
-                /* Other markers may redeposit objects  */
-                /* on the stack.                                */
-                if (0 == GC_active_count) GC_notify_all_marker();
-                while (GC_active_count > 0
-                       && (word)AO_load(&GC_first_nonempty)
-                                > (word)GC_mark_stack_top) {
-                    /* We will be notified if either GC_active_count    */
-                    /* reaches zero, or if more objects are pushed on   */
-                    /* the global mark stack.                           */
-                    GC_wait_marker();
-                }
-                if (GC_active_count == 0
-                    && (word)AO_load(&GC_first_nonempty)
-                        > (word)GC_mark_stack_top) {
-                    GC_bool need_to_notify = FALSE;
-                    /* The above conditions can't be falsified while we */
-                    /* hold the mark lock, since neither                */
-                    /* GC_active_count nor GC_mark_stack_top can        */
-                    /* change.  GC_first_nonempty can only be           */
-                    /* incremented asynchronously.  Thus we know that   */
-                    /* both conditions actually held simultaneously.    */
-                    GC_helper_count--;
-                    if (0 == GC_helper_count) need_to_notify = TRUE;
-                    GC_VERBOSE_LOG_PRINTF("Finished mark helper %lu\n",
-                                          (unsigned long)id);
-                    GC_release_mark_lock();
-                    if (need_to_notify) GC_notify_all_marker();
-                    return;
-                }
-                /* else there's something on the stack again, or        */
-                /* another helper may push something.                   */
-                GC_active_count++;
-                GC_ASSERT(GC_active_count > 0);
-                GC_release_mark_lock();
+        (void)AO_fetch_and_add1(&GC_active_count);
+        AO_nop_full(); /* Count ourselves before taking any entry.      */
+        for (;;) {
+            mse * local_top;
+
+#           ifdef USE_MARK_DEQUES
+              local_top = GC_find_mark_work(local_mark_stack, id,
+                                            &my_first_nonempty, &rnd_state);
+              if ((word)local_top < (word)local_mark_stack) break;
+              GC_do_local_mark(GC_mark_deques + id, local_mark_stack,
+                               local_top, hc);
+#           else
+              local_top = GC_steal_global_mark_stack(local_mark_stack,
+                                                     &my_first_nonempty);
+              if ((word)local_top < (word)local_mark_stack) {
+                if ((word)my_first_nonempty
+                        > (word)AO_load((volatile AO_t *)&GC_mark_stack_top))
+                  break;
+                /* Only already stolen entries were seen; look further. */
                 continue;
-            } else {
-                GC_release_mark_lock();
-            }
+              }
+              GC_do_local_mark(local_mark_stack, local_top, hc);
+#           endif
         }
-        n_to_get = ENTRIES_TO_GET;
-        if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
-        local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
-                                        local_mark_stack, n_to_get,
-                                        &my_first_nonempty);
-        GC_ASSERT((word)my_first_nonempty >= (word)GC_mark_stack &&
-                  (word)my_first_nonempty <=
-                        (word)AO_load((volatile AO_t *)&GC_mark_stack_top)
-                        + sizeof(mse));
-        GC_do_local_mark(local_mark_stack, local_top);
+        AO_nop_full(); /* Everything we shared is visible before.       */
+        (void)AO_fetch_and_sub1(&GC_active_count);
     }
+    GC_VERBOSE_LOG_PRINTF("Finished mark helper %lu\n", (unsigned long)id);
 }
 
-/* Perform Parallel mark.                       */
-/* We hold the GC lock, not the mark lock.      */
-/* Currently runs until the mark stack is       */
-/* empty.                                       */
-STATIC void GC_do_parallel_mark(void)
+/* Called by each helper (including the initiating thread) once it has  */
+/* nothing more to do in the current phase.                             */
+STATIC void GC_helper_exit(void)
 {
-    mse local_mark_stack[LOCAL_MARK_STACK_SIZE];
-                /* Note: local_mark_stack is quite big (up to 128 KiB). */
+    if (AO_fetch_and_sub1(&GC_helper_count) == 1) {
+      /* We were the last one.  Let the initiating thread know. */
+      GC_unpark_markers();
+    }
+}
 
+STATIC GC_bool GC_no_helpers_left(void *arg GC_ATTR_UNUSED)
+{
+    return AO_load_acquire(&GC_helper_count) == 0;
+}
+
+/* Let the helpers join a new phase in which they run task (or mark, if */
+/* task is 0).  The initiating thread is counted as the first helper.   */
+/* We hold the GC lock, not the mark lock.                              */
+STATIC void GC_start_helper_phase(void (*task)(unsigned))
+{
     GC_acquire_mark_lock();
     GC_ASSERT(I_HOLD_LOCK());
     /* This could be a GC_ASSERT, but it seems safer to keep it on      */
     /* all the time, especially since it's cheap.                       */
     if (GC_help_wanted || GC_active_count != 0 || GC_helper_count != 0)
         ABORT("Tried to start parallel mark in bad state");
-    GC_VERBOSE_LOG_PRINTF("Starting marking for mark phase number %lu\n",
-                          (unsigned long)GC_mark_no);
-    GC_first_nonempty = (AO_t)GC_mark_stack;
-    GC_active_count = 0;
+    GC_helper_task = task;
+    GC_mark_done = FALSE;
     GC_helper_count = 1;
+    GC_helper_next_id = 1;
     GC_help_wanted = TRUE;
     GC_release_mark_lock();
-    GC_notify_all_marker();
+    GC_unpark_markers();
         /* Wake up potential helpers.   */
-    GC_mark_local(local_mark_stack, 0);
+}
+
+/* Called by the initiating thread once it has nothing more to do in    */
+/* the current phase.  Refuse any further helpers (the phase is over),  */
+/* wait for the ones still running to exit, and let the idle marker     */
+/* threads proceed to the next phase.                                   */
+STATIC void GC_finish_helper_phase(void)
+{
     GC_acquire_mark_lock();
     GC_help_wanted = FALSE;
-    /* Done; clean up.  */
-    while (GC_helper_count > 0) {
-      GC_wait_marker();
-    }
+    GC_release_mark_lock();
     /* GC_helper_count cannot be incremented while GC_help_wanted == FALSE */
-    GC_VERBOSE_LOG_PRINTF("Finished marking for mark phase number %lu\n",
-                          (unsigned long)GC_mark_no);
+    GC_helper_exit();
+    GC_marker_wait(GC_no_helpers_left, NULL);
+    GC_acquire_mark_lock();
     GC_mark_no++;
     GC_release_mark_lock();
-    GC_notify_all_marker();
+    GC_unpark_markers();
+}
+
+/* Perform Parallel mark.                       */
+/* We hold the GC lock, not the mark lock.      */
+/* Currently runs until the mark stack is       */
+/* empty.                                       */
+STATIC void GC_do_parallel_mark(void)
+{
+    mse local_mark_stack[LOCAL_MARK_STACK_SIZE];
+                /* Note: local_mark_stack is quite big (up to 128 KiB). */
+
+#   ifdef USE_MARK_DEQUES
+      if (GC_n_mark_deques < (unsigned)GC_markers_m1 + 1) {
+        /* Allocate the deques (once, unless more markers are started   */
+        /* after fork).  The previous ones, if any, are just dropped.   */
+        unsigned n = (unsigned)GC_markers_m1 + 1;
+        GC_mark_deque *deques = (GC_mark_deque *)GC_scratch_alloc(
+                                        n * sizeof(GC_mark_deque));
+        mse *entries = (mse *)GC_scratch_alloc(
+                                n * MARK_DEQUE_SIZE * sizeof(mse));
+        unsigned i;
+
+        if (NULL == deques || NULL == entries)
+          ABORT("Insufficient memory for mark deques");
+        for (i = 0; i < n; ++i)
+          deques[i].md_entries = entries + i * MARK_DEQUE_SIZE;
+        GC_mark_deques = deques;
+        GC_n_mark_deques = n;
+      }
+#   endif
+    if (GC_n_helper_hdr_caches < (unsigned)GC_markers_m1) {
+      /* Allocate the caches (as the deques above).  The statistics of  */
+      /* the previous ones are preserved, their entries are dropped.    */
+      unsigned n = (unsigned)GC_markers_m1;
+      hdr_cache_t *caches = (hdr_cache_t *)GC_scratch_alloc(
+                                                n * sizeof(hdr_cache_t));
+
+      if (NULL == caches)
+        ABORT("Insufficient memory for marker header caches");
+      BZERO(caches, n * sizeof(hdr_cache_t));
+      if (GC_n_helper_hdr_caches > 0)
+        BCOPY(GC_helper_hdr_caches, caches,
+              GC_n_helper_hdr_caches * sizeof(hdr_cache_t));
+      GC_helper_hdr_caches = caches;
+      GC_n_helper_hdr_caches = n;
+    }
+    GC_VERBOSE_LOG_PRINTF("Starting marking for mark phase number %lu\n",
+                          (unsigned long)GC_mark_no);
+    GC_first_nonempty = (AO_t)GC_mark_stack;
+#   ifdef USE_MARK_DEQUES
+      {
+        unsigned i;
+
+        for (i = 0; i < GC_n_mark_deques; ++i) {
+          GC_mark_deques[i].md_top = 0;
+          GC_mark_deques[i].md_bottom = 0;
+        }
+      }
+      GC_mark_steals = 0;
+#   endif
+    GC_start_helper_phase(0);
+    GC_mark_local(local_mark_stack, 0);
+    /* The mark phase is over, the helpers are just leaving it.         */
+#   ifdef USE_MARK_DEQUES
+      GC_VERBOSE_LOG_PRINTF("Stole %lu entries from mark deques\n",
+                            (unsigned long)AO_load(&GC_mark_steals));
+#   endif
+    GC_VERBOSE_LOG_PRINTF("Finished marking for mark phase number %lu\n",
+                          (unsigned long)GC_mark_no);
+    GC_finish_helper_phase();
 }
 
+GC_INNER void GC_run_on_markers(void (*fn)(unsigned))
+{
+    GC_VERBOSE_LOG_PRINTF("Starting helper phase number %lu\n",
+                          (unsigned long)GC_mark_no);
+    GC_start_helper_phase(fn);
+    fn(0);
+    GC_finish_helper_phase();
+}
+
+STATIC GC_bool GC_mark_phase_ready(void *arg)
+{
+    word my_mark_no = *(word *)arg;
+    word mark_no = (word)AO_load_acquire((volatile AO_t *)&GC_mark_no);
+
+    return mark_no > my_mark_no
+           || (mark_no == my_mark_no && GC_help_wanted
+               && !AO_load(&GC_mark_done));
+}
 
 /* Try to help out the marker, if it's running.         */
 /* We do not hold the GC lock, but the requestor does.  */
 GC_INNER void GC_help_marker(word my_mark_no)
 {
     unsigned my_id;
+    void (*task)(unsigned);
     mse local_mark_stack[LOCAL_MARK_STACK_SIZE];
                 /* Note: local_mark_stack is quite big (up to 128 KiB). */
 
     if (!GC_parallel) return;
 
+    GC_marker_wait(GC_mark_phase_ready, &my_mark_no);
     GC_acquire_mark_lock();
-    while (GC_mark_no < my_mark_no
-           || (!GC_help_wanted && GC_mark_no == my_mark_no)) {
-      GC_wait_marker();
-    }
-    my_id = GC_helper_count;
-    if (GC_mark_no != my_mark_no || my_id > (unsigned)GC_markers_m1) {
-      /* Second test is useful only if original threads can also        */
-      /* act as helpers.  Under Linux they can't.                       */
+    my_id = GC_helper_next_id;
+    if (GC_mark_no != my_mark_no || !GC_help_wanted || GC_mark_done
+        || my_id > (unsigned)GC_markers_m1) {
+      /* Last test is useful only if original threads can also  */
+      /* act as helpers.  Under Linux they can't.               */
       GC_release_mark_lock();
       return;
     }
-    GC_helper_count = my_id + 1;
+    GC_helper_next_id = my_id + 1;
+    /* A helper may exit meanwhile, so the count is not just stored.    */
+    (void)AO_fetch_and_add1(&GC_helper_count);
+    task = GC_helper_task;
     GC_release_mark_lock();
-    GC_mark_local(local_mark_stack, my_id);
-    /* GC_mark_local decrements GC_helper_count. */
+    if (task != 0) {
+      task(my_id);
+    } else {
+      GC_mark_local(local_mark_stack, my_id);
+    }
+    GC_helper_exit();
 }
 
 #endif /* PARALLEL_MARK */
@@ -1211,7 +1801,8 @@ static void alloc_mark_stack(size_t n)
               size = (size - displ) & ~(GC_page_size - 1);
               if (size > 0) {
                 GC_add_to_heap((struct hblk *)
-                                ((word)GC_mark_stack + displ), (word)size);
+                                ((word)GC_mark_stack + displ), (word)size,
+                               FALSE);
               }
           }
           GC_mark_stack = new_stack;
@@ -1235,9 +1826,28 @@ static void alloc_mark_stack(size_t n)
     GC_mark_stack_top = GC_mark_stack-1;
 }
 
+GC_INNER void GC_get_hdr_cache_stats(word *phits, word *pmisses)
+{
+    word hits = GC_main_hdr_cache.hc_hits;
+    word misses = GC_main_hdr_cache.hc_misses;
+#   ifdef PARALLEL_MARK
+      unsigned i;
+
+      for (i = 0; i < GC_n_helper_hdr_caches; ++i) {
+        hits += GC_helper_hdr_caches[i].hc_hits;
+        misses += GC_helper_hdr_caches[i].hc_misses;
+      }
+#   endif
+    *phits = hits;
+    *pmisses = misses;
+}
+
 GC_INNER void GC_mark_init(void)
 {
     alloc_mark_stack(INITIAL_MARK_STACK_SIZE);
+#   ifdef SIMD_SCAN
+      GC_init_scan_kernel();
+#   endif
 }
 
 /*
@@ -1397,6 +2007,13 @@ GC_API struct GC_ms_entry * GC_CALL GC_mark_and_push(void *obj,
     hdr * hhdr;
     ptr_t r = p;
 
+#   ifdef HEAP_MAP
+      if (EXPECT(!HEAP_MAP_TEST(p), FALSE)) {
+        /* Not in the heap, see GC_add_to_heap.  */
+        GC_ADD_TO_BLACK_LIST_STACK(p, source);
+        return;
+      }
+#   endif
     PREFETCH(p);
     GET_HDR(p, hhdr);
     if (EXPECT(IS_FORWARDING_ADDR_OR_NIL(hhdr), FALSE)) {
@@ -1504,11 +2121,21 @@ GC_INNER void GC_push_all_eager(ptr_t bottom, ptr_t top)
     /* check all pointers in range and push if they appear      */
     /* to be valid.                                             */
       lim = t - 1 /* longword */;
-      for (p = b; (word)p <= (word)lim;
-           p = (word *)(((ptr_t)p) + ALIGNMENT)) {
-        q = *p;
-        GC_PUSH_ONE_STACK(q, p);
-      }
+#     ifdef SIMD_SCAN
+        for (p = b;; p++) {
+          p = (word *)GC_scan_kernel((ptr_t)p, (ptr_t)lim, (word)least_ha,
+                                     (word)greatest_ha);
+          if ((word)p > (word)lim) break;
+          q = *p;
+          GC_PUSH_ONE_STACK(q, p);
+        }
+#     else
+        for (p = b; (word)p <= (word)lim;
+             p = (word *)(((ptr_t)p) + ALIGNMENT)) {
+          q = *p;
+          GC_PUSH_ONE_STACK(q, p);
+        }
+#     endif
 #   undef GC_greatest_plausible_heap_addr
 #   undef GC_least_plausible_heap_addr
 }
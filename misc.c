@@ -56,6 +56,9 @@
 # endif
   /* For other platforms with threads, the lock and possibly            */
   /* GC_lock_holder variables are defined in the thread support code.   */
+# ifdef UNCOND_LOCK
+    GC_INNER word GC_lock_acquisitions = 0;
+# endif
 #endif /* THREADS */
 
 #ifdef DYNAMIC_LOADING
@@ -223,6 +226,86 @@ GC_API void GC_CALL GC_set_handle_fork(int value GC_ATTR_UNUSED)
 # endif
 }
 
+#ifdef SIZE_CLASS_TABLE
+# ifndef SIZE_CLASSES_PER_DOUBLING
+#   define SIZE_CLASSES_PER_DOUBLING 8
+                /* With 4 KiB heap blocks, 4 classes per doubling give  */
+                /* the same object sizes as GC_extend_size_map in the   */
+                /* 512 B .. 2 KiB range (as the objects per block       */
+                /* rounding dominates there), 8 ones add the 576-byte   */
+                /* class (7 objects per block), so that every possible  */
+                /* number of objects per block is available there.      */
+# endif
+# define SIZE_CLASS_MIN_STEP 16 /* in bytes */
+
+# if SIZE_CLASSES_PER_DOUBLING == 8
+    /* The size classes (in bytes) for the default configuration.       */
+    /* Each is a multiple of max(16, 2**floor(log2(size))/8).           */
+    STATIC const unsigned short GC_size_classes[] = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        144, 160, 176, 192, 208, 224, 240, 256,
+        288, 320, 352, 384, 416, 448, 480, 512,
+        576, 640, 704, 768, 832, 896, 960, 1024,
+        1152, 1280, 1408, 1536, 1664, 1792, 1920, 2048,
+        2304, 2560, 2816, 3072, 3328, 3584, 3840, 4096,
+        4608, 5120, 5632, 6144, 6656, 7168, 7680, 8192,
+        9216, 10240, 11264, 12288, 13312, 14336, 15360, 16384,
+        18432, 20480, 22528, 24576, 26624, 28672, 30720, 32768
+    };
+# endif
+
+  /* Return the smallest size class (in bytes) greater than lb.         */
+  STATIC size_t GC_next_size_class(size_t lb)
+  {
+    size_t pow2 = 1;
+    size_t step;
+
+#   if SIZE_CLASSES_PER_DOUBLING == 8
+      size_t i;
+
+      for (i = 0; i < sizeof(GC_size_classes)/sizeof(GC_size_classes[0]);
+           i++) {
+        if (GC_size_classes[i] > lb) return GC_size_classes[i];
+      }
+#   endif
+    while (pow2 <= lb / 2) pow2 <<= 1;
+    step = pow2 / SIZE_CLASSES_PER_DOUBLING;
+    if (step < SIZE_CLASS_MIN_STEP) step = SIZE_CLASS_MIN_STEP;
+    return (lb / step + 1) * step;
+  }
+
+  /* Fill in all the entries of GC_size_map starting from low_limit.    */
+  /* Each request is mapped to the smallest size class it fits in       */
+  /* (including EXTRA_BYTES), then the object size is increased to the  */
+  /* largest one giving the same number of objects per heap block.      */
+  /* The latter costs no heap space (the rest of the block would be     */
+  /* unused anyway) but lets the adjacent size classes share the same   */
+  /* free lists.                                                        */
+  STATIC void GC_fill_size_classes(size_t low_limit)
+  {
+    size_t class_sz = 0; /* in bytes */
+    size_t granule_sz = 0;
+    size_t i;
+
+    for (i = low_limit; i <= MAXOBJBYTES - EXTRA_BYTES; i++) {
+      if (i + EXTRA_BYTES > GRANULES_TO_BYTES(granule_sz)) {
+        size_t orig_granule_sz;
+
+        while (class_sz < i + EXTRA_BYTES)
+          class_sz = GC_next_size_class(class_sz);
+        orig_granule_sz = BYTES_TO_GRANULES(class_sz + GRANULE_BYTES - 1);
+        if (orig_granule_sz > MAXOBJGRANULES)
+          orig_granule_sz = MAXOBJGRANULES;
+        granule_sz = HBLK_GRANULES / (HBLK_GRANULES / orig_granule_sz);
+        /* Prefer an even number of granules (as GC_extend_size_map).  */
+        if ((granule_sz & 1) != 0 && granule_sz > orig_granule_sz)
+          granule_sz--;
+      }
+      GC_size_map[i] = granule_sz;
+    }
+  }
+#endif /* SIZE_CLASS_TABLE */
+
 /* Set things up so that GC_size_map[i] >= granules(i),                 */
 /* but not too much bigger                                              */
 /* and so that size_map contains relatively few distinct entries        */
@@ -242,7 +325,11 @@ STATIC void GC_init_size_map(void)
           /* Seems to tickle bug in VC++ 2008 for AMD64 */
 #       endif
     }
-    /* We leave the rest of the array to be filled in on demand. */
+#   ifdef SIZE_CLASS_TABLE
+      GC_fill_size_classes((size_t)i);
+#   else
+      /* We leave the rest of the array to be filled in on demand. */
+#   endif
 }
 
 /* Fill in additional entries in GC_size_map, including the ith one     */
@@ -429,15 +516,21 @@ GC_API void * GC_CALL GC_base(void * p)
 {
     ptr_t r;
     struct hblk *h;
-    bottom_index *bi;
+#   ifndef FLAT_HDR_TABLE
+      bottom_index *bi;
+#   endif
     hdr *candidate_hdr;
     ptr_t limit;
 
     r = p;
     if (!EXPECT(GC_is_initialized, TRUE)) return 0;
     h = HBLKPTR(r);
-    GET_BI(r, bi);
-    candidate_hdr = HDR_FROM_BI(bi, r);
+#   ifdef FLAT_HDR_TABLE
+      candidate_hdr = HDR(r);
+#   else
+      GET_BI(r, bi);
+      candidate_hdr = HDR_FROM_BI(bi, r);
+#   endif
     if (candidate_hdr == 0) return(0);
     /* If it's a pointer to the middle of a large object, move it       */
     /* to the beginning.                                                */
@@ -467,11 +560,17 @@ GC_API void * GC_CALL GC_base(void * p)
 /* Return TRUE if and only if p points to somewhere in GC heap. */
 GC_API int GC_CALL GC_is_heap_ptr(const void *p)
 {
-    bottom_index *bi;
-
     GC_ASSERT(GC_is_initialized);
-    GET_BI(p, bi);
-    return HDR_FROM_BI(bi, p) != 0;
+#   ifdef FLAT_HDR_TABLE
+      return HDR(p) != 0;
+#   else
+      {
+        bottom_index *bi;
+
+        GET_BI(p, bi);
+        return HDR_FROM_BI(bi, p) != 0;
+      }
+#   endif
 }
 
 /* Return the size of an object, given a pointer to its base.           */
@@ -561,6 +660,30 @@ GC_API void GC_CALL GC_get_heap_usage_safe(GC_word *pheap_size,
     pstats->bytes_reclaimed_since_gc = GC_bytes_found > 0 ?
                                         (word)GC_bytes_found : 0;
     pstats->reclaimed_bytes_before_gc = GC_reclaimed_bytes_before_gc;
+#   ifdef MPROTECT_VDB
+      pstats->protect_calls = GC_protect_calls;
+      pstats->unprotect_calls = GC_unprotect_calls;
+#   else
+      pstats->protect_calls = 0;
+      pstats->unprotect_calls = 0;
+#   endif
+    GC_get_hdr_cache_stats(&pstats->hdr_cache_hits,
+                           &pstats->hdr_cache_misses);
+#   if defined(THREADS) && defined(UNCOND_LOCK)
+      pstats->lock_acquisitions = GC_lock_acquisitions;
+#   else
+      pstats->lock_acquisitions = 0;
+#   endif
+#   ifdef FINALIZER_THREADS
+      GC_fill_finalizer_stats(pstats);
+#   else
+      pstats->finalizer_queue_length = 0;
+      pstats->finalizer_queue_max_length = 0;
+      pstats->finalizer_thread_runs = 0;
+      pstats->finalizer_batches = 0;
+      pstats->finalizer_latency_ms_sum = 0;
+      pstats->finalizer_latency_ms_max = 0;
+#   endif
   }
 
 # include <string.h> /* for memset() */
@@ -1032,6 +1155,20 @@ GC_API void GC_CALL GC_init(void)
             GC_full_freq = full_freq;
         }
       }
+#   endif
+#   ifdef HEAP_PROFILE
+      {
+        char * interval_string = GETENV("GC_HEAP_PROFILE_INTERVAL");
+        if (interval_string != NULL) {
+          long interval = atol(interval_string);
+          if (interval < 0) {
+            WARN("GC_HEAP_PROFILE_INTERVAL environment variable has "
+                 "bad value: Ignoring\n", 0);
+          } else {
+            GC_heap_profile_interval = (word)interval;
+          }
+        }
+      }
 #   endif
     {
       char * interval_string = GETENV("GC_LARGE_ALLOC_WARN_INTERVAL");
@@ -1161,6 +1298,9 @@ GC_API void GC_CALL GC_init(void)
     GC_init_headers();
     GC_bl_init();
     GC_mark_init();
+#   ifdef SIMD_CLEAR
+      GC_init_clear_kernel();
+#   endif
     {
         char * sz_str = GETENV("GC_INITIAL_HEAP_SIZE");
         if (sz_str != NULL) {
@@ -1787,6 +1927,8 @@ GC_API unsigned GC_CALL GC_new_kind_inner(void **fl, GC_word descr,
       GC_obj_kinds[result].ok_descriptor = descr;
       GC_obj_kinds[result].ok_relocate_descr = adjust;
       GC_obj_kinds[result].ok_init = (GC_bool)clear;
+      GC_obj_kinds[result].ok_reclaim_notify = 0;
+      GC_obj_kinds[result].ok_reclaim_notify_data = NULL;
 #     ifdef ENABLE_DISCLAIM
         GC_obj_kinds[result].ok_mark_unconditionally = FALSE;
         GC_obj_kinds[result].ok_disclaim_proc = 0;
@@ -1808,6 +1950,23 @@ GC_API unsigned GC_CALL GC_new_kind(void **fl, GC_word descr, int adjust,
     return result;
 }
 
+GC_API void GC_CALL GC_register_reclaim_notifier(int kind,
+                                        GC_reclaim_notify_proc proc,
+                                        void *client_data)
+{
+    DCL_LOCK_STATE;
+
+    GC_ASSERT((unsigned)kind < MAXOBJKINDS);
+#   ifdef ENABLE_DISCLAIM
+      if (GC_obj_kinds[kind].ok_disclaim_proc != 0)
+        ABORT("Reclaim notifier for a kind with disclaim procedure");
+#   endif
+    LOCK();
+    GC_obj_kinds[kind].ok_reclaim_notify = proc;
+    GC_obj_kinds[kind].ok_reclaim_notify_data = client_data;
+    UNLOCK();
+}
+
 GC_API unsigned GC_CALL GC_new_proc_inner(GC_mark_proc proc)
 {
     unsigned result = GC_n_mark_procs;
@@ -1978,6 +2137,70 @@ GC_API void * GC_CALL GC_do_blocking(GC_fn_type fn, void * client_data)
     GC_print_hblkfreelist();
     GC_printf("\n***Blocks in use:\n");
     GC_print_block_list();
+#   ifdef LOCK_HOLD_STATS
+      GC_printf("\n***Lock hold times:\n");
+      GC_print_lock_hold_stats();
+#   endif
+  }
+
+  struct size_class_usage {
+    size_t bytes;       /* object size of the class         */
+    word n_blocks;      /* number of heap blocks in use     */
+    word n_marks;       /* number of objects marked in them */
+  };
+
+  STATIC void GC_add_size_class_usage(struct hblk *h, word client_data)
+  {
+    hdr *hhdr = HDR(h);
+    struct size_class_usage *pu = (struct size_class_usage *)client_data;
+
+    if (hhdr -> hb_sz == pu -> bytes) {
+      pu -> n_blocks++;
+      pu -> n_marks += hhdr -> hb_n_marks;
+    }
+  }
+
+  GC_API void GC_CALL GC_print_size_classes(void)
+  {
+    size_t lb;
+    size_t first = 1; /* the smallest request mapped to the class */
+    DCL_LOCK_STATE;
+
+    if (!EXPECT(GC_is_initialized, TRUE)) GC_init();
+    LOCK();
+    GC_printf("Size class requests     objs/block max/avg waste"
+              " blocks marked\n");
+    for (lb = 1; lb <= MAXOBJBYTES - EXTRA_BYTES; lb++) {
+      size_t lg = GC_size_map[lb];
+      size_t n_objs, footprint;
+      struct size_class_usage u;
+
+      if (0 == lg) {
+        /* Not computed yet (unless SIZE_CLASS_TABLE).  */
+        first = lb + 1;
+        continue;
+      }
+      if (lb < MAXOBJBYTES - EXTRA_BYTES && GC_size_map[lb + 1] == lg)
+        continue;
+      /* Requests from first to lb are all rounded up to lg granules.   */
+      /* The waste is counted against the heap space consumed by each   */
+      /* object, i.e. including its share of the unused block tail.     */
+      n_objs = HBLK_GRANULES / lg;
+      footprint = HBLKSIZE / n_objs;
+      u.bytes = GRANULES_TO_BYTES(lg);
+      u.n_blocks = 0;
+      u.n_marks = 0;
+      GC_apply_to_all_blocks(GC_add_size_class_usage, (word)&u);
+      GC_printf("%10lu %5lu..%-5lu %10lu %4lu%%/%3lu%% %6lu %6lu\n",
+                (unsigned long)u.bytes, (unsigned long)first,
+                (unsigned long)lb, (unsigned long)n_objs,
+                (unsigned long)((footprint - first) * 100 / footprint),
+                (unsigned long)((footprint - (first + lb) / 2) * 100
+                                / footprint),
+                (unsigned long)u.n_blocks, (unsigned long)u.n_marks);
+      first = lb + 1;
+    }
+    UNLOCK();
   }
 #endif /* !NO_DEBUGGING */
 
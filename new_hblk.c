@@ -23,6 +23,91 @@
 
 #include <stdio.h>
 
+#ifdef SIMD_CLEAR
+# include <immintrin.h>
+
+# ifndef CLEAR_NT_MIN_BYTES
+    /* The smaller ranges are cleared by memset (vectorized by libc)   */
+    /* through the cache, since they are likely to be accessed soon.   */
+#   define CLEAR_NT_MIN_BYTES (256 * 1024)
+# endif
+
+  /* The clearing kernels for large ranges.  Each zeroes [p, lim) (both */
+  /* 64-byte aligned) using the non-temporal stores, which bypass the   */
+  /* cache, thus neither evict the data in use nor read the lines in.   */
+  typedef void (*GC_clear_kernel_t)(ptr_t p, ptr_t lim);
+
+  STATIC void GC_clear_kernel_sse2(ptr_t p, ptr_t lim)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; (word)p < (word)lim; p += 64) {
+      _mm_stream_si128((__m128i *)p, zero);
+      _mm_stream_si128((__m128i *)p + 1, zero);
+      _mm_stream_si128((__m128i *)p + 2, zero);
+      _mm_stream_si128((__m128i *)p + 3, zero);
+    }
+  }
+
+  __attribute__((__target__("avx2")))
+  STATIC void GC_clear_kernel_avx2(ptr_t p, ptr_t lim)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; (word)p < (word)lim; p += 64) {
+      _mm256_stream_si256((__m256i *)p, zero);
+      _mm256_stream_si256((__m256i *)p + 1, zero);
+    }
+  }
+
+  STATIC GC_clear_kernel_t GC_clear_kernel = GC_clear_kernel_sse2;
+                        /* NULL means memset for all sizes.     */
+
+  /* Choose the widest kernel supported by the CPU, unless another one  */
+  /* is requested by GC_CLEAR_KERNEL environment variable.              */
+  GC_INNER void GC_init_clear_kernel(void)
+  {
+    static const char * const names[] = { "memset", "sse2", "avx2" };
+    static const GC_clear_kernel_t kernels[] = {
+                0, GC_clear_kernel_sse2, GC_clear_kernel_avx2 };
+    char * str = GETENV("GC_CLEAR_KERNEL");
+    int i = 1; /* SSE2 is always available on x86_64 */
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) i = 2;
+    if (str != NULL) {
+      int j;
+
+      for (j = 0; j < i; j++) {
+        if (strcmp(str, names[j]) == 0) {
+          i = j;
+          break;
+        }
+      }
+    }
+    GC_clear_kernel = kernels[i];
+    GC_COND_LOG_PRINTF("Using %s kernel to clear large ranges\n", names[i]);
+  }
+
+  GC_INNER void GC_clear_mem(void *p, size_t bytes)
+  {
+    ptr_t start, lim;
+
+    if (bytes < CLEAR_NT_MIN_BYTES || NULL == GC_clear_kernel) {
+      BZERO(p, bytes);
+      return;
+    }
+    start = (ptr_t)(((word)p + 63) & ~(word)63);
+    lim = (ptr_t)(((word)p + bytes) & ~(word)63);
+    BZERO(p, start - (ptr_t)p);
+    GC_clear_kernel(start, lim);
+    BZERO(lim, (ptr_t)p + bytes - lim);
+    /* The streaming stores are weakly ordered; make them visible   */
+    /* before the object is published.                              */
+    _mm_sfence();
+  }
+#endif /* SIMD_CLEAR */
+
 #ifndef SMALL_CONFIG
   /* Build a free list for size 2 (words) cleared objects inside        */
   /* hblk h.  Set the last link to be ofl.  Return a pointer tpo the    */
@@ -140,7 +225,7 @@ GC_INNER ptr_t GC_build_fl(struct hblk *h, size_t sz, GC_bool clear,
 # endif /* !SMALL_CONFIG */
 
   /* Clear the page if necessary. */
-    if (clear) BZERO(h, HBLKSIZE);
+    if (clear) GC_clear_mem(h, HBLKSIZE);
 
   /* Add objects to free list */
     p = (word *)(h -> hb_body) + sz;    /* second object in *h  */
@@ -180,6 +265,7 @@ GC_INNER void GC_new_hblk(size_t gran, int kind)
   /* Allocate a new heap block */
     h = GC_allochblk(GRANULES_TO_BYTES(gran), kind, 0);
     if (h == 0) return;
+    if (LAST_HBLK_ZEROED()) clear = FALSE;
 
   /* Mark all objects if appropriate. */
       if (IS_UNCOLLECTABLE(kind)) GC_set_hdr_marks(HDR(h));
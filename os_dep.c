@@ -811,7 +811,8 @@ GC_INNER word GC_page_size = 0;
 #else /* !MSWIN32 */
   GC_INNER void GC_setpagesize(void)
   {
-#   if defined(MPROTECT_VDB) || defined(PROC_VDB) || defined(USE_MMAP)
+#   if defined(MPROTECT_VDB) || defined(PROC_VDB) || defined(SOFT_VDB) \
+       || defined(USE_MMAP)
       GC_page_size = GETPAGESIZE();
       if (!GC_page_size) ABORT("getpagesize failed");
 #   else
@@ -2087,6 +2088,19 @@ STATIC ptr_t GC_unix_mmap_get_mem(word bytes)
     return((ptr_t)result);
 }
 
+#ifdef FLAT_HDR_TABLE
+  /* Reserve a zero-filled region of the address space.  The pages are  */
+  /* committed by the OS only when written to.                          */
+  GC_INNER ptr_t GC_get_sparse_mem(size_t bytes)
+  {
+    void *result = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                        -1, 0/* offset */);
+
+    return result == MAP_FAILED ? NULL : (ptr_t)result;
+  }
+#endif
+
 # endif  /* MMAP_SUPPORTED */
 
 #if defined(USE_MMAP)
@@ -2533,6 +2547,18 @@ GC_INNER void GC_unmap_gap(ptr_t start1, size_t bytes1, ptr_t start2,
 
 #endif /* USE_MUNMAP */
 
+#ifdef LAZY_ZEROING
+  /* Release the physical pages backing the given page-aligned range  */
+  /* while keeping it mapped; the next access to a page faults in a   */
+  /* fresh zero-filled one.  Return FALSE if the OS refused.           */
+  GC_INNER GC_bool GC_discard_pages(ptr_t start, size_t bytes)
+  {
+    GC_ASSERT(((word)start & (GC_page_size - 1)) == 0);
+    GC_ASSERT((bytes & (GC_page_size - 1)) == 0);
+    return madvise(start, bytes, MADV_DONTNEED) == 0;
+  }
+#endif /* LAZY_ZEROING */
+
 /* Routine for pushing any additional roots.  In THREADS        */
 /* environment, this is also responsible for marking from       */
 /* thread stacks.                                               */
@@ -2616,7 +2642,7 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
 
 /*
  * Routines for accessing dirty bits on virtual pages.
- * There are six ways to maintain this information:
+ * There are seven ways to maintain this information:
  * DEFAULT_VDB: A simple dummy implementation that treats every page
  *              as possibly dirty.  This makes incremental collection
  *              useless, but the implementation is still correct.
@@ -2652,12 +2678,16 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
  *              read dirty bits.  In case it is not available (because we
  *              are running on Windows 95, Windows 2000 or earlier),
  *              MPROTECT_VDB may be defined as a fallback strategy.
+ * SOFT_VDB:    Use the Linux soft-dirty bits, read from /proc/self/pagemap
+ *              and reset through /proc/self/clear_refs.  The kernel tracks
+ *              the writes itself, so there are no signals and no system
+ *              call restrictions, but it needs CONFIG_MEM_SOFT_DIRTY.
  */
 #ifndef GC_DISABLE_INCREMENTAL
   GC_INNER GC_bool GC_dirty_maintained = FALSE;
 #endif
 
-#if defined(PROC_VDB) || defined(GWW_VDB)
+#if defined(PROC_VDB) || defined(GWW_VDB) || defined(SOFT_VDB)
   /* Add all pages in pht2 to pht1 */
   STATIC void GC_or_pages(page_hash_table pht1, page_hash_table pht2)
   {
@@ -2701,7 +2731,7 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
                                        GC_bool is_ptrfree GC_ATTR_UNUSED) {}
 # endif
 
-#endif /* PROC_VDB || GWW_VDB */
+#endif /* PROC_VDB || GWW_VDB || SOFT_VDB */
 
 #ifdef GWW_VDB
 
@@ -2943,12 +2973,12 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
 #   include <signal.h>
 #   include <sys/syscall.h>
 
-#   define PROTECT(addr, len) \
+#   define MPROT_PROTECT(addr, len) \
         if (mprotect((caddr_t)(addr), (size_t)(len), \
                      PROT_READ \
                      | (GC_pages_executable ? PROT_EXEC : 0)) >= 0) { \
         } else ABORT("mprotect failed")
-#   define UNPROTECT(addr, len) \
+#   define MPROT_UNPROTECT(addr, len) \
         if (mprotect((caddr_t)(addr), (size_t)(len), \
                      (PROT_READ | PROT_WRITE) \
                      | (GC_pages_executable ? PROT_EXEC : 0)) >= 0) { \
@@ -2958,6 +2988,24 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
                                 "un-mprotect failed")
 #   undef IGNORE_PAGES_EXECUTABLE
 
+#   ifdef UFFD_VDB
+      /* If userfaultfd is in use (see GC_uffd_dirty_init), the heap    */
+      /* pages are write-protected by it instead of mprotect.           */
+      STATIC int GC_uffd_fd = -1;
+      STATIC void GC_uffd_protect(ptr_t addr, size_t len, GC_bool wp);
+#     define PROTECT(addr, len) \
+        if (GC_uffd_fd >= 0) { \
+          GC_uffd_protect((ptr_t)(addr), (size_t)(len), TRUE); \
+        } else MPROT_PROTECT(addr, len)
+#     define UNPROTECT(addr, len) \
+        if (GC_uffd_fd >= 0) { \
+          GC_uffd_protect((ptr_t)(addr), (size_t)(len), FALSE); \
+        } else MPROT_UNPROTECT(addr, len)
+#   else
+#     define PROTECT(addr, len) MPROT_PROTECT(addr, len)
+#     define UNPROTECT(addr, len) MPROT_UNPROTECT(addr, len)
+#   endif
+
 # else /* USE_WINALLOC */
 #   ifndef MSWINCE
 #     include <signal.h>
@@ -3068,6 +3116,216 @@ GC_API GC_push_other_roots_proc GC_CALL GC_get_push_other_roots(void)
                         set_pht_entry_from_index(db, index)
 #endif /* !THREADS */
 
+#ifdef UFFD_VDB
+# include <fcntl.h>
+# include <linux/userfaultfd.h>
+# include <sys/ioctl.h>
+
+# ifndef UFFD_FEATURE_WP_UNPOPULATED
+#   define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+# endif
+
+# ifndef GC_UFFD_MSG_BATCH
+#   define GC_UFFD_MSG_BATCH 64
+# endif
+
+  /* With userfaultfd, a write to a write-protected heap page blocks    */
+  /* the writer, and a message describing the fault is delivered to a   */
+  /* dedicated handler thread (not registered with the collector, thus  */
+  /* never stopped).  The handler records the page as dirty and then    */
+  /* removes the protection, which also wakes up the writer.  No signal */
+  /* handler is involved, the writes by system calls to the heap block  */
+  /* instead of failing with EFAULT, and the heap is protected again by */
+  /* a few ioctl calls (one per contiguous range) in GC_protect_heap.   */
+  /* GC_uffd_lock makes the set-then-unprotect pair atomic with respect */
+  /* to GC_read_dirty; otherwise a page could be marked dirty just      */
+  /* before the bits are cleared, and unprotected just after the heap   */
+  /* is protected again, thus its next write would go unnoticed.        */
+  STATIC pthread_mutex_t GC_uffd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+  STATIC void GC_uffd_protect(ptr_t addr, size_t len, GC_bool wp)
+  {
+    struct uffdio_writeprotect prot;
+
+    prot.range.start = (word)addr;
+    prot.range.len = len;
+    prot.mode = wp ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+    while (ioctl(GC_uffd_fd, UFFDIO_WRITEPROTECT, &prot) != 0) {
+      if (errno != EAGAIN) /* EAGAIN means the mappings are changing */
+        ABORT_ARG3("UFFDIO_WRITEPROTECT failed",
+                   " at %p (length %lu), errno= %d",
+                   addr, (unsigned long)len, errno);
+    }
+  }
+
+  STATIC GC_bool GC_uffd_register(int fd, ptr_t start, size_t len)
+  {
+    struct uffdio_register reg;
+
+    reg.range.start = (word)start;
+    reg.range.len = len;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    while (ioctl(fd, UFFDIO_REGISTER, &reg) != 0) {
+      if (errno != EAGAIN) return FALSE;
+    }
+    return TRUE;
+  }
+
+  STATIC void GC_uffd_unregister_heap(int fd)
+  {
+    unsigned i;
+
+    for (i = 0; i < GC_n_heap_sects; i++) {
+      struct uffdio_range range;
+
+      range.start = (word)GC_heap_sects[i].hs_start;
+      range.len = GC_heap_sects[i].hs_bytes;
+      (void)ioctl(fd, UFFDIO_UNREGISTER, &range);
+    }
+  }
+
+  /* Switch to mprotect.  Unregistering removes the write protection   */
+  /* and wakes up the blocked writers; the pages are unknown to be      */
+  /* clean thus they are all considered dirty till the next cycle.     */
+  /* Called with the allocation lock held.                             */
+  STATIC void GC_uffd_disable(void)
+  {
+    pthread_mutex_lock(&GC_uffd_lock);
+    GC_uffd_unregister_heap(GC_uffd_fd);
+    GC_uffd_fd = -1; /* the descriptor itself is owned by the handler */
+    memset((word *)GC_dirty_pages, 0xff, sizeof(GC_dirty_pages));
+    pthread_mutex_unlock(&GC_uffd_lock);
+    WARN("Cannot register heap with userfaultfd, using mprotect\n", 0);
+  }
+
+  GC_INNER void GC_uffd_add_heap_range(ptr_t start, size_t bytes)
+  {
+    if (GC_uffd_fd >= 0 && !GC_uffd_register(GC_uffd_fd, start, bytes))
+      GC_uffd_disable();
+  }
+
+  STATIC void *GC_uffd_handler_thread(void *arg)
+  {
+    int fd = (int)(word)arg;
+    struct uffd_msg msgs[GC_UFFD_MSG_BATCH];
+
+    for (;;) {
+      ssize_t res = read(fd, msgs, sizeof(msgs));
+      size_t i, n;
+
+      if (res < 0) {
+        if (errno == EINTR || errno == EAGAIN) continue;
+        ABORT_ARG1("userfaultfd read failed", ": errno= %d", errno);
+      }
+      n = (size_t)res / sizeof(msgs[0]);
+      pthread_mutex_lock(&GC_uffd_lock);
+      for (i = 0; i < n; i++) {
+        struct hblk *h;
+        size_t j;
+
+        if (msgs[i].event != UFFD_EVENT_PAGEFAULT
+            || (msgs[i].arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP) == 0
+            || GC_uffd_fd < 0)
+          continue;
+        h = (struct hblk *)((word)msgs[i].arg.pagefault.address
+                            & ~(GC_page_size-1));
+        for (j = 0; j < divHBLKSZ(GC_page_size); j++) {
+          async_set_pht_entry_from_index(GC_dirty_pages, PHT_HASH(h+j));
+        }
+        GC_uffd_protect((ptr_t)h, GC_page_size, FALSE);
+      }
+      pthread_mutex_unlock(&GC_uffd_lock);
+    }
+    return NULL;
+  }
+
+  /* The registration is not inherited by a forked child, nor is the    */
+  /* handler thread; thus the child continues with mprotect.            */
+  STATIC void GC_uffd_fork_child(void)
+  {
+    if (GC_uffd_fd >= 0) {
+      GC_uffd_fd = -1;
+      memset((word *)GC_dirty_pages, 0xff, sizeof(GC_dirty_pages));
+    }
+  }
+
+  /* Try to switch the write protection to userfaultfd.  Called at the  */
+  /* end of GC_dirty_init (the write fault handler is installed anyway, */
+  /* as it is needed if we fall back to mprotect later).                */
+  STATIC GC_bool GC_uffd_dirty_init(void)
+  {
+    static GC_bool atfork_installed = FALSE;
+    char * str = GETENV("GC_USE_USERFAULTFD");
+    struct uffdio_api api;
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t blocked, oldset;
+    unsigned i;
+    int fd, err;
+
+    if (str != NULL && *str == '0' && *(str + 1) == '\0') {
+      /* GC_USE_USERFAULTFD is set "0".         */
+      return FALSE;
+    }
+    fd = (int)syscall(SYS_userfaultfd, O_CLOEXEC);
+    if (fd < 0) {
+      GC_COND_LOG_PRINTF("userfaultfd is unavailable, errno= %d\n", errno);
+      return FALSE;
+    }
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP
+                   | UFFD_FEATURE_WP_UNPOPULATED;
+    if (ioctl(fd, UFFDIO_API, &api) != 0) {
+      GC_COND_LOG_PRINTF("userfaultfd write protection is unsupported\n");
+      close(fd);
+      return FALSE;
+    }
+    for (i = 0; i < GC_n_heap_sects; i++) {
+      if (!GC_uffd_register(fd, GC_heap_sects[i].hs_start,
+                            GC_heap_sects[i].hs_bytes)) {
+        GC_COND_LOG_PRINTF("Cannot register heap with userfaultfd,"
+                           " errno= %d\n", errno);
+        GC_uffd_unregister_heap(fd);
+        close(fd);
+        return FALSE;
+      }
+    }
+
+    if (!atfork_installed) {
+      if (pthread_atfork(0, 0, GC_uffd_fork_child) != 0)
+        ABORT("pthread_atfork failed");
+      atfork_installed = TRUE;
+    }
+    if (pthread_attr_init(&attr) != 0)
+      ABORT("pthread_attr_init failed");
+    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0)
+      ABORT("pthread_attr_setdetachedstate failed");
+    /* The handler should not receive any signals (especially those    */
+    /* used to stop the world).                                         */
+    if (sigfillset(&blocked) != 0)
+      ABORT("sigfillset failed");
+    if (pthread_sigmask(SIG_BLOCK, &blocked, &oldset) != 0)
+      ABORT("pthread_sigmask failed");
+#   undef pthread_create
+    /* This will call the real pthread function, not our wrapper.       */
+    err = pthread_create(&thread, &attr, GC_uffd_handler_thread,
+                         (void *)(word)fd);
+    if (pthread_sigmask(SIG_SETMASK, &oldset, NULL) != 0)
+      ABORT("pthread_sigmask failed");
+    (void)pthread_attr_destroy(&attr);
+    if (err != 0) {
+      WARN("Cannot start userfaultfd handler thread, errno= %" WARN_PRIdPTR
+           "\n", (signed_word)err);
+      GC_uffd_unregister_heap(fd);
+      close(fd);
+      return FALSE;
+    }
+    GC_uffd_fd = fd;
+    GC_COND_LOG_PRINTF("Using userfaultfd for write protection\n");
+    return TRUE;
+  }
+#endif /* UFFD_VDB */
+
 #ifdef CHECKSUMS
   void GC_record_fault(struct hblk * h); /* from checksums.c */
 #endif
@@ -3266,8 +3524,11 @@ GC_INNER void GC_remove_protection(struct hblk *h, word nblocks,
     if (!GC_dirty_maintained) return;
     h_trunc = (struct hblk *)((word)h & ~(GC_page_size-1));
     h_end = (struct hblk *)ROUNDUP_PAGESIZE((word)(h + nblocks));
-    if (h_end == h_trunc + 1 &&
-        get_pht_entry_from_index(GC_dirty_pages, PHT_HASH(h_trunc))) {
+    for (current = h_trunc; (word)current < (word)h_end; ++current) {
+        if (!get_pht_entry_from_index(GC_dirty_pages, PHT_HASH(current)))
+          break;
+    }
+    if (current == h_end) {
         /* already marked dirty, and hence unprotected. */
         return;
     }
@@ -3279,6 +3540,7 @@ GC_INNER void GC_remove_protection(struct hblk *h, word nblocks,
         }
     }
     UNPROTECT(h_trunc, (ptr_t)h_end - (ptr_t)h_trunc);
+    GC_unprotect_calls++;
 }
 
 #if !defined(DARWIN)
@@ -3354,6 +3616,9 @@ GC_INNER void GC_remove_protection(struct hblk *h, word nblocks,
       }
 #   endif /* HPUX || LINUX || HURD || (FREEBSD && SUNOS5SIGS) */
 #   endif /* ! MS windows */
+#   ifdef UFFD_VDB
+      (void)GC_uffd_dirty_init();
+#   endif
 #   if defined(GWW_VDB)
       if (GC_gww_dirty_init())
         return;
@@ -3387,6 +3652,63 @@ GC_API int GC_CALL GC_incremental_protection_needs(void)
 #define IS_PTRFREE(hhdr) ((hhdr)->hb_descr == 0)
 #define PAGE_ALIGNED(x) !((word)(x) & (GC_page_size - 1))
 
+GC_INNER word GC_protect_calls = 0;
+GC_INNER word GC_unprotect_calls = 0;
+
+/* The range to be protected is accumulated in GC_prot_pending_start    */
+/* and GC_prot_pending_len, so that adjacent runs (e.g., the tail of a  */
+/* heap section and the head of the section following it immediately)  */
+/* are protected by a single call.                                      */
+STATIC ptr_t GC_prot_pending_start = NULL;
+STATIC size_t GC_prot_pending_len = 0;
+
+/* Add the given range to the pending one, or protect the latter and    */
+/* start a new one if they are not adjacent.  Zero len flushes it.      */
+STATIC void GC_protect_range(ptr_t start, size_t len)
+{
+    if (GC_prot_pending_len > 0) {
+      if (len > 0 && GC_prot_pending_start + GC_prot_pending_len == start) {
+        GC_prot_pending_len += len;
+        return;
+      }
+      PROTECT(GC_prot_pending_start, GC_prot_pending_len);
+      GC_protect_calls++;
+    }
+    GC_prot_pending_start = start;
+    GC_prot_pending_len = len;
+}
+
+/* Whether GC_protect_heap has been called at least once.  Thereafter, */
+/* a page not recorded in GC_grungy_pages is still protected: the only */
+/* ways to unprotect a pointer-containing page (the write fault        */
+/* handler and GC_remove_protection) both set its dirty bit.           */
+STATIC GC_bool GC_heap_protected = FALSE;
+
+/* Protect the pointer-containing blocks between start and limit.  If  */
+/* the protection state is known, only the part from the first dirty  */
+/* page to the last one needs the call (or none if all are clean).     */
+/* Assumes GC_page_size is HBLKSIZE.                                   */
+STATIC void GC_protect_run(struct hblk *start, struct hblk *limit)
+{
+    struct hblk *first = start;
+    struct hblk *last = limit;
+
+    if (GC_heap_protected) {
+      while ((word)first < (word)limit
+             && !get_pht_entry_from_index(GC_grungy_pages, PHT_HASH(first)))
+        first++;
+      if (first == limit) return; /* clean, thus still protected */
+      while (!get_pht_entry_from_index(GC_grungy_pages, PHT_HASH(last - 1)))
+        last--;
+      if (GC_prot_pending_len > 0
+          && GC_prot_pending_start + GC_prot_pending_len == (ptr_t)start) {
+        /* Extend the pending range over the protected clean prefix. */
+        first = start;
+      }
+    }
+    GC_protect_range((ptr_t)first, (ptr_t)last - (ptr_t)first);
+}
+
 STATIC void GC_protect_heap(void)
 {
     ptr_t start;
@@ -3395,13 +3717,14 @@ STATIC void GC_protect_heap(void)
     struct hblk * current_start;  /* Start of block to be protected. */
     struct hblk * limit;
     unsigned i;
+    word calls_before = GC_protect_calls;
     GC_bool protect_all =
           (0 != (GC_incremental_protection_needs() & GC_PROTECTS_PTRFREE_HEAP));
     for (i = 0; i < GC_n_heap_sects; i++) {
         start = GC_heap_sects[i].hs_start;
         len = GC_heap_sects[i].hs_bytes;
         if (protect_all) {
-          PROTECT(start, len);
+          GC_protect_range(start, len);
         } else {
           GC_ASSERT(PAGE_ALIGNED(len));
           GC_ASSERT(PAGE_ALIGNED(start));
@@ -3433,7 +3756,7 @@ STATIC void GC_protect_heap(void)
             }
             if (is_ptrfree) {
               if ((word)current_start < (word)current) {
-                PROTECT(current_start, (ptr_t)current - (ptr_t)current_start);
+                GC_protect_run(current_start, current);
               }
               current_start = (current += nhblks);
             } else {
@@ -3441,10 +3764,14 @@ STATIC void GC_protect_heap(void)
             }
           }
           if ((word)current_start < (word)current) {
-            PROTECT(current_start, (ptr_t)current - (ptr_t)current_start);
+            GC_protect_run(current_start, current);
           }
         }
     }
+    GC_protect_range(NULL, 0); /* flush */
+    GC_heap_protected = !protect_all;
+    GC_VERBOSE_LOG_PRINTF("Protected heap by %lu calls\n",
+                          (unsigned long)(GC_protect_calls - calls_before));
 }
 
 /* We assume that either the world is stopped or its OK to lose dirty   */
@@ -3456,11 +3783,19 @@ GC_INNER void GC_read_dirty(void)
         GC_gww_read_dirty();
         return;
       }
+#   endif
+#   ifdef UFFD_VDB
+      GC_bool uffd_locked = GC_uffd_fd >= 0;
+
+      if (uffd_locked) pthread_mutex_lock(&GC_uffd_lock);
 #   endif
     BCOPY((word *)GC_dirty_pages, GC_grungy_pages,
           (sizeof GC_dirty_pages));
     BZERO((word *)GC_dirty_pages, (sizeof GC_dirty_pages));
     GC_protect_heap();
+#   ifdef UFFD_VDB
+      if (uffd_locked) pthread_mutex_unlock(&GC_uffd_lock);
+#   endif
 }
 
 GC_INNER GC_bool GC_page_was_dirty(struct hblk *h)
@@ -3752,6 +4087,176 @@ GC_INNER void GC_read_dirty(void)
 # undef READ
 #endif /* PROC_VDB */
 
+#ifdef SOFT_VDB
+/* See DEFAULT_VDB for interface descriptions.  */
+
+/* The kernel sets the soft-dirty bit of a page table entry on the      */
+/* first write to the page after the bits have been cleared by writing  */
+/* "4" to /proc/self/clear_refs.  The bits are reported by              */
+/* /proc/self/pagemap (one 64-bit entry per page).  GC_read_dirty is    */
+/* called with the world stopped, thus no write can occur between       */
+/* reading the bits and clearing them.                                  */
+
+# include <sys/types.h>
+# include <sys/stat.h>
+
+  typedef unsigned long long pagemap_elem_t;
+
+# define PM_SOFT_DIRTY_MASK ((pagemap_elem_t)1 << 55)
+
+# ifndef PAGEMAP_BUF_ENTRIES
+#   define PAGEMAP_BUF_ENTRIES 4096 /* 32 KiB buffer */
+# endif
+
+  STATIC int GC_pagemap_fd = -1;
+  STATIC int GC_clear_refs_fd = -1;
+  STATIC pid_t GC_soft_vdb_pid = 0;
+                        /* The process the above files were opened by. */
+  STATIC pagemap_elem_t *GC_pagemap_buf = NULL;
+
+  STATIC void GC_soft_vdb_close(void)
+  {
+    if (GC_pagemap_fd >= 0) (void)close(GC_pagemap_fd);
+    if (GC_clear_refs_fd >= 0) (void)close(GC_clear_refs_fd);
+    GC_pagemap_fd = GC_clear_refs_fd = -1;
+  }
+
+  STATIC GC_bool GC_soft_vdb_open(void)
+  {
+    GC_pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+    GC_clear_refs_fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (GC_pagemap_fd < 0 || GC_clear_refs_fd < 0) {
+      GC_soft_vdb_close();
+      return FALSE;
+    }
+    (void)fcntl(GC_pagemap_fd, F_SETFD, FD_CLOEXEC);
+    (void)fcntl(GC_clear_refs_fd, F_SETFD, FD_CLOEXEC);
+    GC_soft_vdb_pid = getpid();
+    return TRUE;
+  }
+
+  STATIC GC_bool GC_clear_soft_dirty_bits(void)
+  {
+    return write(GC_clear_refs_fd, "4", 1) == 1;
+  }
+
+  /* Read the pagemap entries for n pages starting at vaddr into        */
+  /* GC_pagemap_buf.                                                    */
+  STATIC GC_bool GC_read_pagemap(ptr_t vaddr, size_t n)
+  {
+    size_t len = n * sizeof(pagemap_elem_t);
+
+    return pread(GC_pagemap_fd, GC_pagemap_buf, len,
+                 (off_t)((word)vaddr / GC_page_size
+                         * sizeof(pagemap_elem_t))) == (ssize_t)len;
+  }
+
+  STATIC void GC_set_grungy_range(ptr_t vaddr, ptr_t limit)
+  {
+    struct hblk *h;
+
+    for (h = HBLKPTR(vaddr); (word)h < (word)limit; h++) {
+      register word index = PHT_HASH(h);
+      set_pht_entry_from_index(GC_grungy_pages, index);
+    }
+  }
+
+GC_INNER void GC_dirty_init(void)
+{
+    static volatile int probe = 0;
+
+    GC_VERBOSE_LOG_PRINTF("Initializing SOFT_VDB...\n");
+    if (GC_bytes_allocd != 0 || GC_bytes_allocd_before_gc != 0) {
+      memset(GC_written_pages, 0xff, sizeof(page_hash_table));
+      GC_VERBOSE_LOG_PRINTF(
+                "Allocated %lu bytes: all pages may have been written\n",
+                (unsigned long)(GC_bytes_allocd + GC_bytes_allocd_before_gc));
+    }
+    if (NULL == GC_pagemap_buf) {
+      GC_pagemap_buf = (pagemap_elem_t *)GC_scratch_alloc(
+                                PAGEMAP_BUF_ENTRIES * sizeof(pagemap_elem_t));
+      if (NULL == GC_pagemap_buf)
+        ABORT("Insufficient space for pagemap buffer");
+    }
+    /* Check the kernel really tracks the soft-dirty bits (it does not  */
+    /* unless built with CONFIG_MEM_SOFT_DIRTY).  If not, every page is  */
+    /* considered dirty (as with DEFAULT_VDB).                          */
+    if (GC_pagemap_fd < 0 && !GC_soft_vdb_open()) {
+      WARN("Cannot open /proc/self/pagemap or clear_refs;"
+           " all pages are considered dirty\n", 0);
+    } else {
+      GC_bool supported = GC_clear_soft_dirty_bits();
+
+      if (supported) {
+        probe++; /* Write to a page after the bits have been cleared. */
+        supported = GC_read_pagemap((ptr_t)&probe, 1)
+                    && (GC_pagemap_buf[0] & PM_SOFT_DIRTY_MASK) != 0;
+      }
+      if (!supported) {
+        WARN("Soft-dirty bits are not supported;"
+             " all pages are considered dirty\n", 0);
+        GC_soft_vdb_close();
+      }
+    }
+    GC_dirty_maintained = TRUE;
+}
+
+GC_INNER void GC_read_dirty(void)
+{
+    word i;
+
+    BZERO(GC_grungy_pages, sizeof(GC_grungy_pages));
+    if (GC_pagemap_fd < 0) {
+      memset(GC_grungy_pages, 0xff, sizeof(page_hash_table));
+      GC_or_pages(GC_written_pages, GC_grungy_pages);
+      return;
+    }
+    if (getpid() != GC_soft_vdb_pid) {
+      /* We are in a forked child, the files refer to the parent.       */
+      /* Consider everything dirty this time.                           */
+      GC_soft_vdb_close();
+      if (!GC_soft_vdb_open())
+        ABORT("Cannot reopen /proc/self/pagemap or clear_refs");
+      memset(GC_grungy_pages, 0xff, sizeof(page_hash_table));
+    } else {
+      for (i = 0; i < GC_n_heap_sects; i++) {
+        ptr_t vaddr = (ptr_t)((word)GC_heap_sects[i].hs_start
+                              & ~(GC_page_size - 1));
+        ptr_t limit = GC_heap_sects[i].hs_start + GC_heap_sects[i].hs_bytes;
+
+        while ((word)vaddr < (word)limit) {
+          size_t n = ((word)limit - (word)vaddr + GC_page_size - 1)
+                        / GC_page_size;
+          size_t j;
+
+          if (n > PAGEMAP_BUF_ENTRIES) n = PAGEMAP_BUF_ENTRIES;
+          if (!GC_read_pagemap(vaddr, n)) {
+            /* Punt: consider the rest of the section dirty.    */
+            WARN("Pagemap read failed\n", 0);
+            GC_set_grungy_range(vaddr, limit);
+            break;
+          }
+          for (j = 0; j < n; j++, vaddr += GC_page_size) {
+            if ((GC_pagemap_buf[j] & PM_SOFT_DIRTY_MASK) != 0) {
+#             ifdef DEBUG_DIRTY_BITS
+                GC_log_printf("dirty page at: %p\n", vaddr);
+#             endif
+              GC_set_grungy_range(vaddr, vaddr + GC_page_size);
+            }
+          }
+        }
+      }
+    }
+    if (!GC_clear_soft_dirty_bits()) {
+      /* The pages written until the next call would be missed.        */
+      ABORT("Cannot clear soft-dirty bits");
+    }
+
+    /* Update GC_written_pages. */
+    GC_or_pages(GC_written_pages, GC_grungy_pages);
+}
+#endif /* SOFT_VDB */
+
 #ifdef PCR_VDB
 
 # include "vd/PCR_VD.h"
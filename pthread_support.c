@@ -301,6 +301,22 @@ STATIC int GC_nprocs = 1;
     }
   }
 
+# ifdef THREAD_LOCAL_LARGE_CACHE
+    GC_INNER void GC_drop_thread_local_large_caches(void)
+    {
+      int i;
+      GC_thread p;
+
+      GC_ASSERT(GC_world_stopped);
+      for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+        for (p = GC_threads[i]; 0 != p; p = p -> next) {
+          if (!(p -> flags & FINISHED))
+            GC_drop_large_cache_for(&(p->tlfs));
+        }
+      }
+    }
+# endif /* THREAD_LOCAL_LARGE_CACHE */
+
 # if defined(GC_ASSERTIONS)
     void GC_check_tls_for(GC_tlfs p);
 #   if defined(USE_CUSTOM_SPECIFIC)
@@ -332,7 +348,11 @@ STATIC int GC_nprocs = 1;
 #ifdef PARALLEL_MARK
 
 # ifndef MAX_MARKERS
-#   define MAX_MARKERS 16
+#   ifdef USE_MARK_DEQUES
+#     define MAX_MARKERS 64
+#   else
+#     define MAX_MARKERS 16
+#   endif
 # endif
 
 static ptr_t marker_sp[MAX_MARKERS - 1] = {0};
@@ -964,6 +984,9 @@ static void fork_prepare_proc(void)
           GC_wait_for_reclaim();
 #     endif
       GC_wait_for_gc_completion(TRUE);
+#     ifdef FINE_GRAINED_LOCKS
+        GC_fl_lock_all();
+#     endif
 #     if defined(PARALLEL_MARK)
         if (GC_parallel)
           GC_acquire_mark_lock();
@@ -976,6 +999,9 @@ static void fork_parent_proc(void)
 #   if defined(PARALLEL_MARK)
       if (GC_parallel)
         GC_release_mark_lock();
+#   endif
+#   ifdef FINE_GRAINED_LOCKS
+      GC_fl_unlock_all();
 #   endif
     RESTORE_CANCEL(fork_cancel_state);
     UNLOCK();
@@ -995,6 +1021,12 @@ static void fork_child_proc(void)
       /* just going to exec, and we would have to restart mark threads. */
         GC_parallel = FALSE;
 #   endif /* PARALLEL_MARK */
+#   ifdef FINE_GRAINED_LOCKS
+      GC_fl_unlock_all();
+#   endif
+#   ifdef FINALIZER_THREADS
+      GC_finalizer_threads_fork_child();
+#   endif
     RESTORE_CANCEL(fork_cancel_state);
     UNLOCK();
 }
@@ -1960,6 +1992,151 @@ GC_INNER void GC_lock(void)
 
 #endif /* !USE_SPIN_LOCK */
 
+#ifdef FINE_GRAINED_LOCKS
+  GC_INNER volatile AO_TS_t GC_fl_locks[MAXOBJKINDS][MAXOBJGRANULES+1];
+  GC_INNER volatile AO_t GC_fl_bytes_allocd = 0;
+
+  /* A free list lock is held either for a few instructions by an       */
+  /* allocating thread, or by the allocation lock holder while it       */
+  /* refills the list.  Thus we spin for a while, then yield.           */
+  GC_INNER void GC_fl_lock_slow(volatile AO_TS_t *lock)
+  {
+    unsigned i;
+
+    for (i = 0;; ++i) {
+      if (i >= SPIN_MAX) sched_yield();
+      if (AO_test_and_set_acquire(lock) == AO_TS_CLEAR) return;
+    }
+  }
+
+  /* The kinds are added only while holding the allocation lock, so     */
+  /* GC_n_kinds does not change until GC_fl_unlock_all is called.       */
+  GC_INNER void GC_fl_lock_all(void)
+  {
+    unsigned k;
+    size_t lg;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (k = 0; k < GC_n_kinds; ++k) {
+      for (lg = 0; lg <= MAXOBJGRANULES; ++lg) {
+        if (AO_test_and_set_acquire(&GC_fl_locks[k][lg]) == AO_TS_SET)
+          GC_fl_lock_slow(&GC_fl_locks[k][lg]);
+      }
+    }
+  }
+
+  GC_INNER void GC_fl_unlock_all(void)
+  {
+    unsigned k;
+    size_t lg;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (k = 0; k < GC_n_kinds; ++k) {
+      for (lg = 0; lg <= MAXOBJGRANULES; ++lg)
+        AO_CLEAR(&GC_fl_locks[k][lg]);
+    }
+  }
+
+  GC_INNER void GC_flush_fl_bytes_allocd(void)
+  {
+    AO_t bytes = AO_load(&GC_fl_bytes_allocd);
+
+    GC_ASSERT(I_HOLD_LOCK());
+    if (bytes != 0) {
+      (void)AO_fetch_and_add(&GC_fl_bytes_allocd, (AO_t)0 - bytes);
+      GC_bytes_allocd += (word)bytes;
+    }
+  }
+#endif /* FINE_GRAINED_LOCKS */
+
+#ifdef LOCK_HOLD_STATS
+# define LOCK_HOLD_HIST_SIZE 32
+                /* Bucket i counts the holds of [2**i, 2**(i+1)) ns.    */
+
+  STATIC word GC_lock_hold_hist[LOCK_HOLD_HIST_SIZE] = { 0 };
+                /* Updated by the allocation lock holder.               */
+  static word lock_hold_start = 0;
+
+  static word lock_hold_now(void)
+  {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+      return 0;
+    return (word)ts.tv_sec * 1000000000 + (word)ts.tv_nsec;
+  }
+
+  static unsigned lock_hold_bucket(word ns)
+  {
+    unsigned i = 0;
+
+    while (ns > 1 && i < LOCK_HOLD_HIST_SIZE - 1) {
+      ns >>= 1;
+      i++;
+    }
+    return i;
+  }
+
+  GC_INNER void GC_lock_hold_begin(void)
+  {
+    lock_hold_start = lock_hold_now();
+  }
+
+  GC_INNER void GC_lock_hold_end(void)
+  {
+    /* The lock might have been acquired without GC_lock_hold_begin,    */
+    /* e.g. if GC_need_to_lock has been set meanwhile.                  */
+    if (lock_hold_start != 0) {
+      GC_lock_hold_hist[lock_hold_bucket(lock_hold_now()
+                                         - lock_hold_start)]++;
+      lock_hold_start = 0;
+    }
+  }
+
+# ifdef FINE_GRAINED_LOCKS
+    STATIC volatile AO_t GC_fl_lock_hold_hist[LOCK_HOLD_HIST_SIZE] = { 0 };
+    STATIC word GC_fl_lock_hold_start[MAXOBJKINDS * (MAXOBJGRANULES+1)];
+                /* Updated by the holder of the corresponding lock.     */
+
+    GC_INNER void GC_fl_lock_hold_begin(volatile AO_TS_t *lock)
+    {
+      GC_fl_lock_hold_start[lock - &GC_fl_locks[0][0]] = lock_hold_now();
+    }
+
+    GC_INNER void GC_fl_lock_hold_end(volatile AO_TS_t *lock)
+    {
+      word start = GC_fl_lock_hold_start[lock - &GC_fl_locks[0][0]];
+
+      (void)AO_fetch_and_add1(&GC_fl_lock_hold_hist[
+                                lock_hold_bucket(lock_hold_now() - start)]);
+    }
+# endif
+
+  GC_INNER void GC_print_lock_hold_stats(void)
+  {
+    unsigned i;
+
+    GC_printf("Hold time (ns)   allocation lock"
+#             ifdef FINE_GRAINED_LOCKS
+                "   free list locks"
+#             endif
+              "\n");
+    for (i = 0; i < LOCK_HOLD_HIST_SIZE; i++) {
+      word cnt = GC_lock_hold_hist[i];
+#     ifdef FINE_GRAINED_LOCKS
+        word fl_cnt = (word)AO_load(&GC_fl_lock_hold_hist[i]);
+
+        if (0 == cnt && 0 == fl_cnt) continue;
+        GC_printf("< 2^%-2u %24lu %18lu\n", i + 1, (unsigned long)cnt,
+                  (unsigned long)fl_cnt);
+#     else
+        if (0 == cnt) continue;
+        GC_printf("< 2^%-2u %24lu\n", i + 1, (unsigned long)cnt);
+#     endif
+    }
+  }
+#endif /* LOCK_HOLD_STATS */
+
 #ifdef PARALLEL_MARK
 
 # ifdef GC_ASSERTIONS
@@ -2078,6 +2255,7 @@ STATIC void GC_wait_builder(void)
 GC_INNER void GC_wait_for_reclaim(void)
 {
     GC_acquire_mark_lock();
+    GC_reclaim_lists_frozen = TRUE;
     while (GC_fl_builder_count > 0) {
         GC_wait_builder();
     }
@@ -2112,6 +2290,39 @@ GC_INNER void GC_notify_all_marker(void)
     }
 }
 
+#ifdef USE_MARKER_FUTEX
+# include <sys/syscall.h>
+# include <linux/futex.h>
+# ifndef FUTEX_WAIT_PRIVATE
+#   define FUTEX_WAIT_PRIVATE FUTEX_WAIT
+#   define FUTEX_WAKE_PRIVATE FUTEX_WAKE
+# endif
+
+  /* The futex word is the least significant half of the AO_t value.   */
+  STATIC int *GC_futex_word(volatile AO_t *addr)
+  {
+#   if CPP_WORDSZ == 64 && defined(__BYTE_ORDER__) \
+       && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      return (int *)addr + 1;
+#   else
+      return (int *)addr;
+#   endif
+  }
+
+  GC_INNER void GC_futex_wait(volatile AO_t *addr, AO_t expected)
+  {
+    /* EAGAIN (value changed) and EINTR are both fine for the caller.   */
+    (void)syscall(SYS_futex, GC_futex_word(addr), FUTEX_WAIT_PRIVATE,
+                  (int)expected, NULL, NULL, 0);
+  }
+
+  GC_INNER void GC_futex_wake_all(volatile AO_t *addr)
+  {
+    (void)syscall(SYS_futex, GC_futex_word(addr), FUTEX_WAKE_PRIVATE,
+                  0x7fffffff /* all */, NULL, NULL, 0);
+  }
+#endif /* USE_MARKER_FUTEX */
+
 #endif /* PARALLEL_MARK */
 
 #ifdef PTHREAD_REGISTER_CANCEL_WEAK_STUBS
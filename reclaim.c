@@ -32,6 +32,11 @@ GC_INNER signed_word GC_bytes_found = 0;
         /* Number of threads currently building free lists without      */
         /* holding GC lock.  It is not safe to collect if this is       */
         /* nonzero.                                                     */
+  GC_INNER GC_bool GC_reclaim_lists_frozen = FALSE;
+        /* Set by GC_wait_for_reclaim (i.e. before the mark bits are    */
+        /* cleared), and reset once GC_start_reclaim has rebuilt the    */
+        /* reclaim lists.  While it is set, the free list builders may  */
+        /* not pop the reclaim lists without holding the GC lock.       */
 #endif /* PARALLEL_MARK */
 
 /* We defer printing of leaked objects until we're done with the GC     */
@@ -49,6 +54,13 @@ GC_INNER GC_bool GC_have_errors = FALSE;
   STATIC void GC_reclaim_unconditionally_marked(void);
 #endif
 
+#if defined(PARALLEL_SWEEP) && !defined(PARALLEL_MARK)
+# undef PARALLEL_SWEEP
+#endif
+#ifdef PARALLEL_SWEEP
+  STATIC void GC_parallel_sweep(void);
+#endif
+
 GC_INLINE void GC_add_leaked(ptr_t leaked)
 {
 #  ifndef SHORT_DBG_HDRS
@@ -138,6 +150,29 @@ STATIC GC_bool GC_block_nearly_full(hdr *hhdr)
 /* FIXME: This should perhaps again be specialized for USE_MARK_BYTES   */
 /* and USE_MARK_BITS cases.                                             */
 
+#ifdef SIMD_CLEAR
+  /* Clear the adjacent objects of size sz in [start, limit) at once,   */
+  /* and push them to list.  Returns the new list.                      */
+  GC_INLINE ptr_t GC_clear_and_link(ptr_t start, ptr_t limit, size_t sz,
+                                    ptr_t list)
+  {
+    ptr_t p;
+
+    if ((word)(limit - start) > 8 * sizeof(word)) {
+      GC_clear_mem(start, limit - start);
+    } else {
+      /* Too short to be worth a call. */
+      for (p = start; (word)p < (word)limit; p += 2 * sizeof(word))
+        CLEAR_DOUBLE(p);
+    }
+    for (p = start; (word)p < (word)limit; p += sz) {
+      obj_link(p) = list;
+      list = p;
+    }
+    return list;
+  }
+#endif /* SIMD_CLEAR */
+
 /*
  * Restore unmarked small objects in h of size sz to the object
  * free list.  Returns the new list.
@@ -156,6 +191,26 @@ STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, size_t sz,
     p = (word *)(hbp->hb_body);
     plim = (word *)(hbp->hb_body + HBLKSIZE - sz);
 
+#   ifdef SIMD_CLEAR
+      /* Clear each run of unmarked objects by a single call (a mostly  */
+      /* empty block is cleared almost entirely at once).               */
+      q = NULL; /* the start of the current run */
+      while ((word)p <= (word)plim) {
+        if (!mark_bit_from_hdr(hhdr, bit_no)) {
+          if (NULL == q) q = p;
+        } else if (q != NULL) {
+          n_bytes_found += (ptr_t)p - (ptr_t)q;
+          list = GC_clear_and_link((ptr_t)q, (ptr_t)p, sz, list);
+          q = NULL;
+        }
+        p = (word *)((ptr_t)p + sz);
+        bit_no += MARK_BIT_OFFSET(sz);
+      }
+      if (q != NULL) {
+        n_bytes_found += (ptr_t)p - (ptr_t)q;
+        list = GC_clear_and_link((ptr_t)q, (ptr_t)p, sz, list);
+      }
+#   else
     /* go through all words in block */
         while ((word)p <= (word)plim) {
             if (mark_bit_from_hdr(hhdr, bit_no)) {
@@ -185,6 +240,7 @@ STATIC ptr_t GC_reclaim_clear(struct hblk *hbp, hdr *hhdr, size_t sz,
             }
             bit_no += MARK_BIT_OFFSET(sz);
         }
+#   endif /* !SIMD_CLEAR */
     *count += n_bytes_found;
     return(list);
 }
@@ -288,6 +344,36 @@ STATIC void GC_reclaim_check(struct hblk *hbp, hdr *hhdr, word sz)
     }
 }
 
+#ifndef RECLAIM_NOTIFY_BATCH
+# define RECLAIM_NOTIFY_BATCH 128
+#endif
+
+/* Pass the unmarked objects in the block to the reclaim notifier of    */
+/* its kind, at most RECLAIM_NOTIFY_BATCH ones at a time.               */
+STATIC void GC_notify_reclaimed(struct hblk *hbp, hdr *hhdr, size_t sz)
+{
+    struct obj_kind *ok = &GC_obj_kinds[hhdr -> hb_obj_kind];
+    GC_reclaim_notify_proc notify = ok -> ok_reclaim_notify;
+    void *batch[RECLAIM_NOTIFY_BATCH];
+    size_t n = 0;
+    word bit_no = 0;
+    ptr_t p, plim;
+
+    GC_ASSERT(notify != 0);
+    p = hbp -> hb_body;
+    plim = p + HBLKSIZE - sz;
+    for (; (word)p <= (word)plim; p += sz, bit_no += MARK_BIT_OFFSET(sz)) {
+      if (mark_bit_from_hdr(hhdr, bit_no)) continue;
+      batch[n++] = p;
+      if (RECLAIM_NOTIFY_BATCH == n) {
+        (*notify)(batch, n, ok -> ok_reclaim_notify_data);
+        n = 0;
+      }
+    }
+    if (n > 0)
+      (*notify)(batch, n, ok -> ok_reclaim_notify_data);
+}
+
 /*
  * Generic procedure to rebuild a free list in hbp.
  * Also called directly from GC_malloc_many.
@@ -308,11 +394,16 @@ GC_INNER ptr_t GC_reclaim_generic(struct hblk * hbp, hdr *hhdr, size_t sz,
         result = GC_disclaim_and_reclaim(hbp, hhdr, sz, list, count);
       } else
 #   endif
-    /* else */ if (init || GC_debugging_started) {
-      result = GC_reclaim_clear(hbp, hhdr, sz, list, count);
-    } else {
-      GC_ASSERT((hhdr)->hb_descr == 0 /* Pointer-free block */);
-      result = GC_reclaim_uninit(hbp, hhdr, sz, list, count);
+    /* else */ {
+      if (EXPECT(GC_obj_kinds[hhdr -> hb_obj_kind].ok_reclaim_notify != 0,
+                 FALSE))
+        GC_notify_reclaimed(hbp, hhdr, sz);
+      if (init || GC_debugging_started) {
+        result = GC_reclaim_clear(hbp, hhdr, sz, list, count);
+      } else {
+        GC_ASSERT((hhdr)->hb_descr == 0 /* Pointer-free block */);
+        result = GC_reclaim_uninit(hbp, hhdr, sz, list, count);
+      }
     }
     if (IS_UNCOLLECTABLE(hhdr -> hb_obj_kind)) GC_set_hdr_marks(hhdr);
     return result;
@@ -395,6 +486,12 @@ STATIC void GC_reclaim_block(struct hblk *hbp, word report_if_found)
                   }
                 }
 #             endif
+              if (EXPECT(ok -> ok_reclaim_notify != 0, FALSE)) {
+                void *obj = hbp -> hb_body;
+
+                (*ok -> ok_reclaim_notify)(&obj, 1,
+                                           ok -> ok_reclaim_notify_data);
+              }
               blocks = OBJ_SZ_TO_BLOCKS(sz);
               if (blocks > 1) {
                 GC_large_allocd_bytes -= blocks * HBLKSIZE;
@@ -434,6 +531,8 @@ STATIC void GC_reclaim_block(struct hblk *hbp, word report_if_found)
           } else
 #       endif
           /* else */ {
+            if (EXPECT(ok -> ok_reclaim_notify != 0, FALSE))
+              GC_notify_reclaimed(hbp, hhdr, sz);
             GC_bytes_found += HBLKSIZE;
             GC_freehblk(hbp);
           }
@@ -621,7 +720,17 @@ GC_INNER void GC_start_reclaim(GC_bool report_if_found)
         GC_bool should_clobber = (GC_obj_kinds[kind].ok_descriptor != 0);
 
         if (rlist == 0) continue;       /* This kind not used.  */
-        if (!report_if_found) {
+        if (GC_obj_kinds[kind].ok_reclaim_notify != 0
+            && !report_if_found) {
+            /* Keep the free lists (marked, as in the find-leak mode),  */
+            /* so that the reclaim notifier is passed only the objects  */
+            /* allocated (and not deallocated explicitly) since.        */
+            lim = &(GC_obj_kinds[kind].ok_freelist[MAXOBJGRANULES+1]);
+            for (fop = GC_obj_kinds[kind].ok_freelist;
+                 (word)fop < (word)lim; fop++) {
+              if (*fop != 0) GC_set_fl_marks((ptr_t)(*fop));
+            }
+        } else if (!report_if_found) {
             lim = &(GC_obj_kinds[kind].ok_freelist[MAXOBJGRANULES+1]);
             for (fop = GC_obj_kinds[kind].ok_freelist;
                  (word)fop < (word)lim; fop++) {
@@ -653,10 +762,42 @@ GC_INNER void GC_start_reclaim(GC_bool report_if_found)
     /* marking work.                                                    */
     GC_reclaim_unconditionally_marked();
 # endif
+# ifdef PARALLEL_SWEEP
+    /* Sweep the rest of the heap right now, on the otherwise idle      */
+    /* marker threads, rather than lazily in the allocating threads.    */
+    if (GC_parallel && !report_if_found) GC_parallel_sweep();
+# endif
 # if defined(PARALLEL_MARK)
     GC_ASSERT(0 == GC_fl_builder_count);
+    if (GC_parallel && !report_if_found) {
+      /* The reclaim lists are consistent with the mark bits again.     */
+      GC_acquire_mark_lock();
+      GC_reclaim_lists_frozen = FALSE;
+      GC_release_mark_lock();
+    }
 # endif
+}
 
+/* No block is added to a reclaim list while it is not frozen, thus a   */
+/* block cannot reappear at the list head once removed, and the simple  */
+/* compare-and-swap loop is not subject to the ABA problem.  The header */
+/* of a block just popped by another thread is still valid (the block   */
+/* is not returned to the heap until the next collection).              */
+GC_INNER struct hblk * GC_pop_reclaim_list(struct hblk **rlh)
+{
+    struct hblk * hbp;
+
+#   ifdef PARALLEL_MARK
+      do {
+        hbp = (struct hblk *)AO_load_acquire((volatile AO_t *)rlh);
+        if (NULL == hbp) break;
+      } while (!AO_compare_and_swap_full((volatile AO_t *)rlh, (AO_t)hbp,
+                                         (AO_t)(HDR(hbp) -> hb_next)));
+#   else
+      hbp = *rlh;
+      if (hbp != NULL) *rlh = HDR(hbp) -> hb_next;
+#   endif
+    return hbp;
 }
 
 /*
@@ -666,7 +807,6 @@ GC_INNER void GC_start_reclaim(GC_bool report_if_found)
  */
 GC_INNER void GC_continue_reclaim(size_t sz /* granules */, int kind)
 {
-    hdr * hhdr;
     struct hblk * hbp;
     struct obj_kind * ok = &(GC_obj_kinds[kind]);
     struct hblk ** rlh = ok -> ok_reclaim_list;
@@ -674,9 +814,8 @@ GC_INNER void GC_continue_reclaim(size_t sz /* granules */, int kind)
 
     if (rlh == 0) return;       /* No blocks of this kind.      */
     rlh += sz;
-    while ((hbp = *rlh) != 0) {
-        hhdr = HDR(hbp);
-        *rlh = hhdr -> hb_next;
+    /* The free list builders may pop the same list concurrently.       */
+    while ((hbp = GC_pop_reclaim_list(rlh)) != 0) {
         GC_reclaim_small_nonempty_block(hbp, FALSE);
         if (*flh != 0) break;
     }
@@ -772,3 +911,76 @@ GC_INNER GC_bool GC_reclaim_all(GC_stop_func stop_func, GC_bool ignore_old)
     }
   }
 #endif /* !EAGER_SWEEP && ENABLE_DISCLAIM */
+
+#ifdef PARALLEL_SWEEP
+  STATIC volatile AO_t GC_sweep_next_list = 0;
+                        /* Index of the next reclaim list to be swept,  */
+                        /* kind * (MAXOBJGRANULES + 1) + granules.      */
+  STATIC volatile AO_t GC_sweep_bytes_found = 0;
+
+  /* Claim the reclaim lists one by one, and sweep each of them into     */
+  /* the corresponding free list.  Each list (and free list) is thus    */
+  /* accessed by a single thread.  This is the same as what             */
+  /* GC_malloc_many does concurrently with other threads (without       */
+  /* holding the GC lock).                                              */
+  STATIC void GC_sweep_reclaim_lists(unsigned id GC_ATTR_UNUSED)
+  {
+    word n_lists = (word)GC_n_kinds * (MAXOBJGRANULES + 1);
+    signed_word bytes_found = 0;
+
+    for (;;) {
+      word i = (word)AO_fetch_and_add1(&GC_sweep_next_list);
+      struct obj_kind * ok;
+      struct hblk ** rlh;
+      void **flh;
+      struct hblk * hbp;
+
+      if (i >= n_lists) break;
+      ok = &GC_obj_kinds[i / (MAXOBJGRANULES + 1)];
+      if (ok -> ok_reclaim_list == 0) continue; /* This kind not used. */
+#     ifdef ENABLE_DISCLAIM
+        /* Avoid running the client disclaim procedures in the marker   */
+        /* threads; such blocks are left for the lazy sweep.            */
+        if (ok -> ok_disclaim_proc != 0) continue;
+#     endif
+      if (ok -> ok_reclaim_notify != 0)
+        continue; /* Similarly, for the client reclaim notifiers.       */
+      rlh = ok -> ok_reclaim_list + i % (MAXOBJGRANULES + 1);
+      flh = &(ok -> ok_freelist[i % (MAXOBJGRANULES + 1)]);
+      while ((hbp = *rlh) != 0) {
+        hdr * hhdr = HDR(hbp);
+
+        *rlh = hhdr -> hb_next;
+        hhdr -> hb_last_reclaimed = (unsigned short) GC_gc_no;
+        *flh = GC_reclaim_generic(hbp, hhdr, hhdr -> hb_sz, ok -> ok_init,
+                                  *flh, &bytes_found);
+      }
+    }
+    (void)AO_fetch_and_add(&GC_sweep_bytes_found, (AO_t)bytes_found);
+  }
+
+  /* Sweep all the reclaim lists in parallel.  Called with the GC lock  */
+  /* held.  The other threads may run but cannot allocate from the      */
+  /* global free lists meanwhile.                                       */
+  STATIC void GC_parallel_sweep(void)
+  {
+#   ifndef SMALL_CONFIG
+      CLOCK_TYPE start_time = 0; /* initialized to prevent warning. */
+      CLOCK_TYPE done_time;
+
+      if (GC_print_stats == VERBOSE)
+        GET_TIME(start_time);
+#   endif
+    GC_sweep_next_list = 0;
+    GC_sweep_bytes_found = 0;
+    GC_run_on_markers(GC_sweep_reclaim_lists);
+    GC_bytes_found += (signed_word)AO_load(&GC_sweep_bytes_found);
+#   ifndef SMALL_CONFIG
+      if (GC_print_stats == VERBOSE) {
+        GET_TIME(done_time);
+        GC_verbose_log_printf("Parallel sweep took %lu msecs\n",
+                              MS_TIME_DIFF(done_time,start_time));
+      }
+#   endif
+  }
+#endif /* PARALLEL_SWEEP */
@@ -0,0 +1,184 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the allocation of objects of a given size range (normal and  */
+/* pointer-free ones) by several threads at once.  The "medium" range   */
+/* is 300 bytes to 2 KiB, the "large" one is a few recurring sizes up   */
+/* to 64 heap blocks; by default both are run.  Besides the throughput, */
+/* report the number of the allocation lock acquisitions per allocated  */
+/* object; it should be much less than one for the medium objects if    */
+/* they are allocated from the thread-local free lists, and below one   */
+/* for the large ones if THREAD_LOCAL_LARGE_CACHE is defined.  Also     */
+/* check that the normal objects are returned cleared.  Finally, print  */
+/* the size classes and their internal fragmentation.                   */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+#include "gc.h"
+
+#include <pthread.h>
+
+#define N_THREADS 4
+#define MAX_KEEP_CNT 256
+
+static const size_t large_sizes[] = {
+    3000, 5000, 12000, 30000, 65000, 250000
+};
+
+static const struct size_range_s {
+    const char *name;
+    int n_allocs;               /* per thread */
+    int keep_cnt;
+    size_t min_size, max_size;  /* used if sizes is NULL */
+    const size_t *sizes;
+    int n_sizes;
+} size_ranges[] = {
+    { "medium", 200000, MAX_KEEP_CNT, 300, 2000, NULL, 0 },
+    { "large", 20000, 16, 0, 0, large_sizes,
+      (int)(sizeof(large_sizes) / sizeof(large_sizes[0])) }
+};
+
+#define N_RANGES (int)(sizeof(size_ranges) / sizeof(size_ranges[0]))
+
+static const struct size_range_s *range;
+static int n_allocs;
+
+static void *run_one_test(void *arg)
+{
+    void **keep_arr;
+    GC_word seed = (GC_word)arg * 7 + 1;
+    int i;
+
+    keep_arr = (void **)GC_MALLOC(sizeof(void *) * MAX_KEEP_CNT);
+    if (NULL == keep_arr) {
+        fprintf(stderr, "Out of memory!\n");
+        exit(3);
+    }
+    for (i = 0; i < n_allocs; ++i) {
+        size_t sz;
+        void *p;
+
+        seed = seed * 1103515245 + 12345;
+        if (range -> sizes != NULL) {
+            sz = range -> sizes[(seed >> 8) % (unsigned)range -> n_sizes];
+        } else {
+            sz = range -> min_size + (size_t)((seed >> 8)
+                        % (range -> max_size - range -> min_size + 1));
+        }
+        p = (seed & 0x100) != 0 ? GC_MALLOC_ATOMIC(sz) : GC_MALLOC(sz);
+        if (NULL == p) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(3);
+        }
+        if ((seed & 0x100) == 0 && (((char *)p)[sz / 2] != 0
+                                    || ((char *)p)[sz - 1] != 0)) {
+            fprintf(stderr, "Object of %lu bytes is not cleared\n",
+                    (unsigned long)sz);
+            exit(1);
+        }
+        ((char *)p)[sz / 2] = 1;
+        ((char *)p)[sz - 1] = 1;
+        /* Keep some recent objects live.       */
+        keep_arr[i % range -> keep_cnt] = p;
+        if ((seed & 0x100) == 0)
+            *(void **)p = keep_arr;
+    }
+    return keep_arr;
+}
+
+static double now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+}
+
+static void run_range(const struct size_range_s *r, int allocs)
+{
+    pthread_t th[N_THREADS];
+    struct GC_prof_stats_s stats;
+    GC_word lock_cnt;
+    GC_word gc_no;
+    double t;
+    int i;
+
+    range = r;
+    n_allocs = allocs > 0 ? allocs : r -> n_allocs;
+    (void)GC_get_prof_stats(&stats, sizeof(stats));
+    lock_cnt = stats.lock_acquisitions;
+    gc_no = GC_get_gc_no();
+    t = now_us();
+    for (i = 0; i < N_THREADS; ++i) {
+        int err = pthread_create(&th[i], NULL, run_one_test,
+                                 (void *)(GC_word)i);
+
+        if (err != 0) {
+            fprintf(stderr, "Thread creation failed: %d\n", err);
+            exit(2);
+        }
+    }
+    for (i = 0; i < N_THREADS; ++i) {
+        int err = pthread_join(th[i], NULL);
+
+        if (err != 0) {
+            fprintf(stderr, "Thread join failed: %d\n", err);
+            exit(2);
+        }
+    }
+    t = now_us() - t;
+    (void)GC_get_prof_stats(&stats, sizeof(stats));
+    lock_cnt = stats.lock_acquisitions - lock_cnt;
+
+    printf("Size range: %s, threads: %d, allocations: %d, collections: %lu,"
+           " heap size: %lu KiB\n", r -> name, N_THREADS,
+           N_THREADS * n_allocs, (unsigned long)(GC_get_gc_no() - gc_no),
+           (unsigned long)GC_get_heap_size() / 1024);
+    printf("Time: %.1f ms, ns per allocation: %.1f,"
+           " lock acquisitions per allocation: %.3f\n", t / 1e3,
+           t * 1e3 / ((double)N_THREADS * n_allocs),
+           (double)lock_cnt / ((double)N_THREADS * n_allocs));
+}
+
+int main(int argc, char **argv)
+{
+    const struct size_range_s *r = NULL;
+    int allocs = 0;
+    int i;
+
+    GC_INIT();
+    if (argc > 1) {
+        for (i = 0; i < N_RANGES; ++i) {
+            if (strcmp(argv[1], size_ranges[i].name) == 0)
+                r = &size_ranges[i];
+        }
+        if (argc > 3 || NULL == r
+            || (argc == 3 && (allocs = atoi(argv[2])) <= 0)) {
+            fprintf(stderr, "Usage: %s [medium|large [ALLOCS_PER_THREAD]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < N_RANGES; ++i) {
+        if (NULL == r || r == &size_ranges[i])
+            run_range(&size_ranges[i], allocs);
+    }
+    fflush(stdout);
+    GC_print_size_classes();
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the cost of clearing the large objects on a mixed workload:  */
+/* each step allocates a large pointer-containing object (which is      */
+/* cleared by the collector) and then walks a working set which fits    */
+/* in the cache.  Clearing through the cache evicts the working set,    */
+/* thus the walk gets slower.  The result is the allocation throughput  */
+/* (in cleared bytes per ns) and the mean walk time; on Linux, the      */
+/* number of the last level cache misses is also reported if available. */
+/* Set GC_CLEAR_KERNEL environment variable (to "memset", "sse2" or     */
+/* "avx2") to compare the kernels.                                      */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+
+#include "gc.h"
+
+#define LARGE_BYTES (1024 * 1024)
+#define N_LIVE 8
+#define WS_BYTES (512 * 1024)
+#define N_STEPS 2000
+
+static void **live; /* a root (never dead for the compiler) */
+static volatile GC_word sink;
+
+static double now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+}
+
+#ifdef __linux__
+  static int open_llc_misses(void)
+  {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0 /* self */,
+                        -1 /* any CPU */, -1 /* no group */, 0);
+  }
+
+  static long long read_counter(int fd)
+  {
+    long long v;
+
+    if (fd < 0 || read(fd, &v, sizeof(v)) != (ssize_t)sizeof(v))
+      return -1;
+    return v;
+  }
+#endif
+
+int main(int argc, char **argv)
+{
+    int i, n_steps = N_STEPS;
+    size_t j;
+    GC_word *ws;
+    GC_word sum = 0;
+    double t, alloc_t = 0.0, walk_t = 0.0;
+    long long misses = -1;
+    char *kernel = getenv("GC_CLEAR_KERNEL");
+#   ifdef __linux__
+      int fd = open_llc_misses();
+      long long misses0 = read_counter(fd);
+#   endif
+
+    GC_INIT();
+    if (argc == 2) n_steps = atoi(argv[1]);
+    if (n_steps <= 0) {
+        fprintf(stderr, "Usage: %s [STEPS]\n", argv[0]);
+        return 1;
+    }
+
+    live = (void **)GC_MALLOC(sizeof(void *) * N_LIVE);
+    ws = (GC_word *)GC_MALLOC_ATOMIC(WS_BYTES);
+    if (NULL == live || NULL == ws) {
+        fprintf(stderr, "Out of memory!\n");
+        return 3;
+    }
+    for (j = 0; j < WS_BYTES / sizeof(GC_word); ++j)
+        ws[j] = j;
+
+    for (i = 0; i < n_steps; ++i) {
+        void **p;
+
+        t = now_us();
+        p = (void **)GC_MALLOC(LARGE_BYTES);
+        alloc_t += now_us() - t;
+        if (NULL == p) {
+            fprintf(stderr, "Out of memory!\n");
+            return 3;
+        }
+        p[0] = live[i % N_LIVE]; /* touch the object as a client would */
+        live[i % N_LIVE] = p;
+
+        t = now_us();
+        for (j = 0; j < WS_BYTES / sizeof(GC_word); j += 8)
+            sum += ws[j];
+        walk_t += now_us() - t;
+    }
+    sink = sum;
+#   ifdef __linux__
+      if (misses0 >= 0) {
+        misses = read_counter(fd);
+        if (misses >= 0) misses -= misses0;
+      }
+#   endif
+
+    printf("Clear kernel: %s, collections: %lu\n",
+           kernel != NULL ? kernel : "default",
+           (unsigned long)GC_get_gc_no());
+    printf("Steps: %d, cleared bytes per ns: %.2f, working set walk: %.2f us",
+           n_steps, (double)n_steps * LARGE_BYTES / (alloc_t * 1e3),
+           walk_t / n_steps);
+    if (misses >= 0) {
+        printf(", LLC misses per step: %.0f\n", (double)misses / n_steps);
+    } else {
+        printf(", LLC misses: n/a\n");
+    }
+    return 0;
+}
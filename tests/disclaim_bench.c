@@ -47,6 +47,21 @@ static const struct GC_finalizer_closure fclos = {
     &free_count
 };
 
+static int notify_kind;
+
+void GC_CALLBACK testobj_notify(void **objs, size_t n, void *carg)
+{
+    size_t j;
+
+    for (j = 0; j < n; ++j) {
+        testobj_t obj = (testobj_t)objs[j];
+
+        my_assert(obj->i == 109);
+        ++*(int *)carg;
+        obj->i = 110;
+    }
+}
+
 testobj_t testobj_new(int model)
 {
     testobj_t obj;
@@ -63,6 +78,9 @@ testobj_t testobj_new(int model)
         case 2:
             obj = GC_MALLOC(sizeof(struct testobj_s));
             break;
+        case 3:
+            obj = GC_generic_malloc(sizeof(struct testobj_s), notify_kind);
+            break;
         default:
             exit(-1);
     }
@@ -78,10 +96,11 @@ testobj_t testobj_new(int model)
 #define ALLOC_CNT (4*1024*1024)
 #define KEEP_CNT      (32*1024)
 
-static char const *model_str[3] = {
+static char const *model_str[4] = {
    "regular finalization",
    "finalize on reclaim",
-   "no finalization"
+   "no finalization",
+   "reclaim notifier"
 };
 
 int main(int argc, char **argv)
@@ -92,6 +111,9 @@ int main(int argc, char **argv)
 
     GC_INIT();
     GC_init_finalized_malloc();
+    notify_kind = (int)GC_new_kind(GC_new_free_list(), 0 | GC_DS_LENGTH,
+                                   TRUE, TRUE);
+    GC_register_reclaim_notifier(notify_kind, testobj_notify, &free_count);
 
     keep_arr = GC_MALLOC(sizeof(void *)*KEEP_CNT);
 
@@ -100,17 +122,18 @@ int main(int argc, char **argv)
                 "Usage: %s [FINALIZATION_MODEL]\n"
                 "\t0 -- original finalization\n"
                 "\t1 -- finalization on reclaim\n"
-                "\t2 -- no finalization\n", argv[0]);
+                "\t2 -- no finalization\n"
+                "\t3 -- reclaim notifier of a kind\n", argv[0]);
         return 1;
     }
     if (argc == 2) {
         model_min = model_max = atoi(argv[1]);
-        if (model_min < 0 || model_max > 2)
+        if (model_min < 0 || model_max > 3)
             exit(2);
     }
     else {
         model_min = 0;
-        model_max = 2;
+        model_max = 3;
     }
 
     printf("\t\t\tfin. ratio       time/s    time/fin.\n");
@@ -132,7 +155,7 @@ int main(int argc, char **argv)
             t = MS_TIME_DIFF(tF, tI)*1e-3;
 #       endif
 
-        if (model < 2)
+        if (model != 2)
             printf("%20s: %12.4lf %12lg %12lg\n", model_str[model],
                    free_count/(double)ALLOC_CNT, t, t/free_count);
         else
@@ -0,0 +1,123 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Check that the finalizers are run by the finalizer threads (started  */
+/* by GC_start_finalizer_threads), and print the queue statistics.      */
+/* The finalizers allocate to check the threads are registered.         */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+#include "gc.h"
+
+#include <pthread.h>
+
+#define N_THREADS 4
+#define N_OBJS 100000
+#define N_ROUNDS 5
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t main_thread;
+static long finalized;
+static long finalized_in_main;
+
+static void GC_CALLBACK finalizer(void *obj, void *client_data)
+{
+    void *p = GC_MALLOC(16);
+
+    if (NULL == p || *(int *)obj != (int)(GC_word)client_data) {
+        fprintf(stderr, "Bad finalized object!\n");
+        exit(1);
+    }
+    pthread_mutex_lock(&lock);
+    finalized++;
+    if (pthread_equal(pthread_self(), main_thread))
+        finalized_in_main++;
+    pthread_mutex_unlock(&lock);
+}
+
+static void make_garbage(int round)
+{
+    int i;
+
+    for (i = 0; i < N_OBJS; ++i) {
+        int *p = (int *)GC_MALLOC(sizeof(int) * 4);
+
+        if (NULL == p) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(3);
+        }
+        *p = round;
+        GC_REGISTER_FINALIZER(p, finalizer, (void *)(GC_word)round, 0, 0);
+    }
+}
+
+int main(void)
+{
+    struct GC_prof_stats_s stats;
+    unsigned n;
+    long done = 0;
+    int i;
+
+    GC_INIT();
+    main_thread = pthread_self();
+    n = GC_start_finalizer_threads(N_THREADS);
+    if (0 == n) {
+        printf("Finalizer threads are not supported\n");
+        return 0;
+    }
+
+    for (i = 0; i < N_ROUNDS; ++i) {
+        make_garbage(i);
+        GC_gcollect();
+    }
+    /* Wait for the finalizer threads (most objects are expected to be  */
+    /* collected, some could be retained conservatively).               */
+    for (i = 0; i < 500; ++i) {
+        long prev = done;
+
+        GC_gcollect();
+        usleep(10000);
+        pthread_mutex_lock(&lock);
+        done = finalized;
+        pthread_mutex_unlock(&lock);
+        if (done >= (long)N_OBJS * N_ROUNDS - 100 && done == prev) break;
+    }
+
+    (void)GC_get_prof_stats(&stats, sizeof(stats));
+    printf("Finalizer threads: %u, finalized: %ld of %d\n",
+           n, done, N_OBJS * N_ROUNDS);
+    printf("Batches: %lu, queue max length: %lu,"
+           " latency (avg/max): %lu/%lu ms\n",
+           (unsigned long)stats.finalizer_batches,
+           (unsigned long)stats.finalizer_queue_max_length,
+           stats.finalizer_batches > 0 ? (unsigned long)
+                (stats.finalizer_latency_ms_sum / stats.finalizer_batches) : 0,
+           (unsigned long)stats.finalizer_latency_ms_max);
+    if (done < (long)N_OBJS * N_ROUNDS / 2) {
+        fprintf(stderr, "Too few objects finalized!\n");
+        return 1;
+    }
+    if (finalized_in_main != 0) {
+        fprintf(stderr, "Finalizers run in the main thread!\n");
+        return 1;
+    }
+    if ((long)stats.finalizer_thread_runs != done) {
+        fprintf(stderr, "Wrong finalizer_thread_runs: %lu\n",
+                (unsigned long)stats.finalizer_thread_runs);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Check the allocation sampling heap profiler: allocate lots of        */
+/* short-lived objects and some long-lived ones, collect, dump the      */
+/* profile and check that only a small part of the samples is live.     */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#define N_ALLOCS 200000
+#define N_LIVE 2000
+#define INTERVAL 4096
+#define PROFILE_NAME "heapprof_test.prof"
+
+void *live[N_LIVE];
+
+static void *alloc_live(size_t lb)
+{
+    return GC_MALLOC(lb);
+}
+
+static void *alloc_garbage(size_t lb)
+{
+    return GC_MALLOC_ATOMIC(lb);
+}
+
+int main(void)
+{
+    unsigned long live_count, live_bytes, alloc_count, alloc_bytes;
+    char line[200];
+    FILE *f;
+    int i;
+    int has_maps = 0;
+
+    GC_INIT();
+    GC_set_heap_profile_interval(INTERVAL);
+    if (GC_get_heap_profile_interval() != INTERVAL) {
+        printf("Heap profiler is not supported; test skipped\n");
+        return 0;
+    }
+    for (i = 0; i < N_ALLOCS; ++i) {
+        void *p = alloc_garbage(100 + (size_t)(i % 200));
+
+        if (NULL == p) {
+            fprintf(stderr, "Out of memory!\n");
+            exit(3);
+        }
+        if (i % (N_ALLOCS / N_LIVE) == 0) {
+            p = alloc_live(256);
+            if (NULL == p) {
+                fprintf(stderr, "Out of memory!\n");
+                exit(3);
+            }
+            live[(i / (N_ALLOCS / N_LIVE)) % N_LIVE] = p;
+        }
+    }
+    GC_gcollect();
+    if (GC_dump_heap_profile(PROFILE_NAME) != 0) {
+        fprintf(stderr, "GC_dump_heap_profile failed\n");
+        exit(1);
+    }
+
+    f = fopen(PROFILE_NAME, "r");
+    if (NULL == f || NULL == fgets(line, sizeof(line), f)
+        || sscanf(line, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/",
+                  &live_count, &live_bytes, &alloc_count, &alloc_bytes)
+           != 4) {
+        fprintf(stderr, "Bad heap profile header\n");
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "MAPPED_LIBRARIES:", 17) == 0) has_maps = 1;
+    }
+    fclose(f);
+    remove(PROFILE_NAME);
+    printf("Samples: %lu live (%lu bytes), %lu allocated (%lu bytes)\n",
+           live_count, live_bytes, alloc_count, alloc_bytes);
+    /* About 40 MB are allocated, 0.5 MB of which stay live.    */
+    if (alloc_count < 1000 || live_count == 0
+        || live_count > alloc_count / 4 || !has_maps) {
+        fprintf(stderr, "Unexpected heap profile\n");
+        exit(1);
+    }
+    return 0;
+}
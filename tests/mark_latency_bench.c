@@ -0,0 +1,80 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the cost of a full collection of a tiny heap.  With such a   */
+/* heap, the mark phase itself takes almost no time, thus the result    */
+/* is dominated by the start-up and termination of the parallel mark    */
+/* helpers.  Compare the output for GC_MARKERS=1 with that for larger   */
+/* values (the difference is the helper start/stop latency).            */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#ifndef GC_THREADS
+# define GC_THREADS
+#endif
+#include "gc.h"
+
+#define N_ITERS 2000
+#define N_WARMUP 50
+#define KEEP_CNT 1000
+
+static double now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    int n_iters = N_ITERS;
+    void **keep_arr;
+    double t, min_t = 1e30, total_t = 0.0;
+
+    GC_INIT();
+    if (argc == 2) n_iters = atoi(argv[1]);
+    if (n_iters <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+
+    keep_arr = (void **)GC_MALLOC(sizeof(void *) * KEEP_CNT);
+    if (NULL == keep_arr) {
+        fprintf(stderr, "Out of memory!\n");
+        return 3;
+    }
+    for (i = 0; i < KEEP_CNT; ++i) {
+        keep_arr[i] = GC_MALLOC(16);
+        if (NULL == keep_arr[i]) {
+            fprintf(stderr, "Out of memory!\n");
+            return 3;
+        }
+    }
+
+    for (i = 0; i < N_WARMUP; ++i)
+        GC_gcollect();
+    for (i = 0; i < n_iters; ++i) {
+        t = now_us();
+        GC_gcollect();
+        t = now_us() - t;
+        total_t += t;
+        if (t < min_t) min_t = t;
+    }
+    printf("Parallel mark helpers: %d, heap size: %lu KiB\n",
+           GC_get_parallel(), (unsigned long)GC_get_heap_size() / 1024);
+    printf("Collections: %d, mean: %.1f us, min: %.1f us\n",
+           n_iters, total_t / n_iters, min_t);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure the conservative scan speed on a synthetic heap consisting   */
+/* of large pointer-containing objects filled mostly with non-pointer   */
+/* values (one word in PTR_PERIOD is a real pointer).  The result is    */
+/* the number of heap words scanned per nanosecond by a full collection */
+/* (the mark phase dominates).  Set GC_SCAN_KERNEL environment variable */
+/* (to "scalar", "sse2", "avx2" or "avx512") to compare the kernels.    */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "gc.h"
+
+#define OBJ_WORDS 512
+#define N_OBJS 4096 /* 16 MiB on a 64-bit target */
+#define PTR_PERIOD 256
+#define N_ITERS 50
+
+static GC_word **objs; /* a root (never dead for the compiler) */
+
+static double now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j;
+    int n_iters = N_ITERS;
+    GC_word seed = 12345;
+    double t, min_t = 1e30, total_t = 0.0;
+    double n_words = (double)N_OBJS * OBJ_WORDS;
+    char *kernel = getenv("GC_SCAN_KERNEL");
+
+    GC_INIT();
+    if (argc == 2) n_iters = atoi(argv[1]);
+    if (n_iters <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+
+    objs = (GC_word **)GC_MALLOC(sizeof(GC_word *) * N_OBJS);
+    if (NULL == objs) {
+        fprintf(stderr, "Out of memory!\n");
+        return 3;
+    }
+    for (i = 0; i < N_OBJS; ++i) {
+        objs[i] = (GC_word *)GC_MALLOC(sizeof(GC_word) * OBJ_WORDS);
+        if (NULL == objs[i]) {
+            fprintf(stderr, "Out of memory!\n");
+            return 3;
+        }
+    }
+    for (i = 0; i < N_OBJS; ++i) {
+        for (j = 0; j < OBJ_WORDS; ++j) {
+            if (j % PTR_PERIOD == PTR_PERIOD - 1) {
+                objs[i][j] = (GC_word)objs[(i + j) % N_OBJS];
+            } else {
+                /* Small integers and values with high bits set, neither */
+                /* looks like a heap address.                           */
+                seed = seed * 1103515245 + 12345;
+                objs[i][j] = (seed & 1) != 0 ? (seed >> 8) & 0xffff
+                                            : ~(seed >> 4);
+            }
+        }
+    }
+
+    GC_gcollect();
+    for (i = 0; i < n_iters; ++i) {
+        t = now_us();
+        GC_gcollect();
+        t = now_us() - t;
+        total_t += t;
+        if (t < min_t) min_t = t;
+    }
+    printf("Scan kernel: %s, heap size: %lu KiB\n",
+           kernel != NULL ? kernel : "default",
+           (unsigned long)GC_get_heap_size() / 1024);
+    printf("Collections: %d, mean: %.1f ms, scanned words per ns: %.2f"
+           " (best: %.2f)\n", n_iters, total_t / n_iters / 1e3,
+           n_words / (total_t / n_iters * 1e3), n_words / (min_t * 1e3));
+    return 0;
+}
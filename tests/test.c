@@ -1201,6 +1201,42 @@ void run_one_test(void)
         GC_printf("GC_malloc_uncollectable(0) failed\n");
         FAIL;
       }
+      {
+        size_t lb;
+
+        for (lb = 1; lb < 5000; lb += 37) {
+          atomic_count++;
+          if (GC_size(GC_malloc_atomic(lb)) < lb) {
+            GC_printf("GC_size(GC_malloc_atomic(%lu)) is too small\n",
+                      (unsigned long)lb);
+            FAIL;
+          }
+        }
+      }
+      {
+        void *objs[40];
+        size_t cnt = GC_malloc_n(24, 40, objs);
+        size_t i;
+
+        if (cnt == 0 || cnt > 40) {
+          GC_printf("GC_malloc_n failed\n");
+          FAIL;
+        }
+        for (i = 0; i < cnt; i++) {
+          if (GC_size(objs[i]) < 24 || ((GC_word *)objs[i])[1] != 0
+              || (i > 0 && objs[i] == objs[i-1])) {
+            GC_printf("GC_malloc_n produced unexpected results\n");
+            FAIL;
+          }
+        }
+        collectable_count += (int)cnt;
+        cnt = GC_malloc_atomic_n(5000, 4, objs);
+        if (cnt == 0 || cnt > 4 || GC_size(objs[0]) < 5000) {
+          GC_printf("GC_malloc_atomic_n failed\n");
+          FAIL;
+        }
+        atomic_count += (int)cnt;
+      }
       GC_is_valid_displacement_print_proc = fail_proc1;
       GC_is_visible_print_proc = fail_proc1;
       collectable_count += 1;
@@ -223,6 +223,13 @@ int APIENTRY WinMain( HINSTANCE instance ATTR_UNUSED,
       xio = gc_allocator_ignore_off_page<int>().allocate(1);
       (void)xio;
       int **xptr = traceable_allocator<int *>().allocate(1);
+      gc_batch_allocator<int> xba;
+      int *xb1 = xba.allocate(1);
+      int *xb2 = xba.allocate(1);
+      if (!xb1 || !xb2 || xb1 == xb2) {
+        GC_printf("gc_batch_allocator failed\n");
+        exit(1);
+      }
 #   else
       int *x = (int *)gc_alloc::allocate(sizeof(int));
 #   endif
@@ -0,0 +1,137 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/* Measure a weak-keyed map built on the ephemerons: the values (which  */
+/* reference their keys, and the key of the next entry in a chain) are  */
+/* stored in a pointer-free array, each slot registered as an ephemeron */
+/* with the key.  Then only the first key of some chains is kept, and   */
+/* it is checked that the values of the whole kept chains survive while */
+/* the rest of the entries are cleared (most of them, some could be     */
+/* retained conservatively).  The registration and collection times     */
+/* are reported.                                                        */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "gc.h"
+
+#define N_ENTRIES 200000 /* a multiple of CHAIN_LEN */
+#define KEEP_EVERY 8
+#define CHAIN_LEN 4
+
+struct key_s {
+    int id;
+};
+
+struct value_s {
+    struct key_s *key; /* makes a cycle through the map */
+    struct key_s *next_key; /* the key of the next entry of the chain */
+    int id;
+};
+
+static struct key_s **kept; /* a root */
+static void **map; /* the values, pointer-free */
+
+static double now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1e3 + (double)tv.tv_usec * 1e-3;
+}
+
+static void *GC_CALLBACK count_live(void *arg)
+{
+    long *counts = (long *)arg;
+    int i;
+
+    for (i = 0; i < N_ENTRIES; ++i) {
+        struct value_s *v = (struct value_s *)map[i];
+
+        if (NULL == v) continue;
+        if (v->id != i || v->key->id != i) {
+            fprintf(stderr, "Bad value at %d!\n", i);
+            exit(1);
+        }
+        counts[i / CHAIN_LEN % KEEP_EVERY == 0 ? 0 : 1]++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    int i;
+    long counts[2] = { 0, 0 };
+    long n_kept = 0;
+    double t, reg_t, gc_t;
+
+    GC_INIT();
+    kept = (struct key_s **)GC_MALLOC(sizeof(struct key_s *) * N_ENTRIES);
+    map = (void **)GC_MALLOC_ATOMIC(sizeof(void *) * N_ENTRIES);
+    if (NULL == kept || NULL == map) {
+        fprintf(stderr, "Out of memory!\n");
+        return 3;
+    }
+
+    t = now_ms();
+    for (i = 0; i < N_ENTRIES; i += CHAIN_LEN) {
+        struct key_s *k[CHAIN_LEN];
+        struct value_s *v[CHAIN_LEN];
+        int j;
+
+        for (j = 0; j < CHAIN_LEN; ++j) {
+            k[j] = (struct key_s *)GC_MALLOC(sizeof(struct key_s));
+            v[j] = (struct value_s *)GC_MALLOC(sizeof(struct value_s));
+            if (NULL == k[j] || NULL == v[j]) {
+                fprintf(stderr, "Out of memory!\n");
+                return 3;
+            }
+            k[j]->id = i + j;
+            v[j]->key = k[j];
+            v[j]->id = i + j;
+            if (j > 0) v[j - 1]->next_key = k[j];
+        }
+        for (j = 0; j < CHAIN_LEN; ++j) {
+            map[i + j] = v[j];
+            if (GC_register_ephemeron(&map[i + j], k[j]) != GC_SUCCESS) {
+                fprintf(stderr, "GC_register_ephemeron failed!\n");
+                return 1;
+            }
+        }
+        if (i / CHAIN_LEN % KEEP_EVERY == 0) {
+            kept[i] = k[0];
+            n_kept += CHAIN_LEN;
+        }
+    }
+    reg_t = now_ms() - t;
+
+    t = now_ms();
+    GC_gcollect();
+    gc_t = now_ms() - t;
+    GC_gcollect();
+    (void)GC_call_with_alloc_lock(count_live, counts);
+
+    printf("Ephemerons: %d, registration: %.1f ms, collection: %.1f ms\n",
+           N_ENTRIES, reg_t, gc_t);
+    printf("Values alive: %ld of %ld kept, %ld of %ld dropped\n",
+           counts[0], n_kept, counts[1], (long)N_ENTRIES - n_kept);
+    if (counts[0] != n_kept) {
+        fprintf(stderr, "Values of reachable keys lost!\n");
+        return 1;
+    }
+    if (counts[1] > (N_ENTRIES - n_kept) / 2) {
+        fprintf(stderr, "Too many values of unreachable keys retained!\n");
+        return 1;
+    }
+    GC_reachable_here(kept);
+    return 0;
+}
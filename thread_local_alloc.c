@@ -44,7 +44,13 @@ static GC_bool keys_initialized;
 static void return_single_freelist(void *fl, void **gfl)
 {
     void *q, **qptr;
+#   ifdef FINE_GRAINED_LOCKS
+      hdr *hhdr = HDR(fl);
+      int k = (int)hhdr -> hb_obj_kind;
+      size_t lg = BYTES_TO_GRANULES(hhdr -> hb_sz);
 
+      FL_LOCK(k, lg);
+#   endif
     if (*gfl == 0) {
       *gfl = fl;
     } else {
@@ -57,6 +63,9 @@ static void return_single_freelist(void *fl, void **gfl)
         *qptr = *gfl;
         *gfl = fl;
     }
+#   ifdef FINE_GRAINED_LOCKS
+      FL_UNLOCK(k, lg);
+#   endif
 }
 
 /* Recover the contents of the freelist array fl into the global one gfl.*/
@@ -82,6 +91,62 @@ static void return_freelists(void **fl, void **gfl)
     }
 }
 
+#ifdef MEDIUM_FREELISTS
+  /* Same as return_freelists but for the medium free lists array fl.   */
+  static void return_medium_freelists(void **fl, void **gfl)
+  {
+    int i;
+
+    for (i = 0; i < (int)MEDIUM_FREELISTS; ++i) {
+        if ((word)(fl[i]) >= HBLKSIZE) {
+          return_single_freelist(fl[i], gfl + TINY_FREELISTS + i);
+        }
+        fl[i] = (ptr_t)HBLKSIZE;
+    }
+  }
+#endif /* MEDIUM_FREELISTS */
+
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  GC_INNER void GC_drop_large_cache_for(GC_tlfs p)
+  {
+    int i;
+
+    GC_ASSERT(I_HOLD_LOCK());
+    for (i = 0; i < LARGE_CACHE_BLOCKS * LARGE_CACHE_SLOTS; ++i) {
+      AO_store(&p->ptrfree_large_cache[i], 0);
+      AO_store(&p->normal_large_cache[i], 0);
+    }
+    AO_store(&p->large_cached_blocks, 0);
+    GC_bytes_allocd += AO_load(&p->large_bytes_allocd);
+    AO_store(&p->large_bytes_allocd, 0);
+  }
+#endif /* THREAD_LOCAL_LARGE_CACHE */
+
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  /* Return the rest of the regions array r as free lists to gfl.       */
+  /* We hold the allocator lock.                                        */
+  static void return_regions(struct bump_region *r, void **gfl)
+  {
+    int i;
+
+    for (i = 0; i < TINY_FREELISTS; ++i) {
+      ptr_t p = r[i].cur;
+      ptr_t limit = r[i].limit;
+
+      if ((word)p < (word)limit) {
+        size_t lb = GC_size(p);
+
+        /* Thread a free list through the remaining objects.    */
+        for (; (word)(p + lb) < (word)limit; p += lb)
+          obj_link(p) = p + lb;
+        obj_link(p) = NULL;
+        return_single_freelist(r[i].cur, gfl + BYTES_TO_GRANULES(lb));
+      }
+      r[i].cur = r[i].limit = NULL;
+    }
+  }
+#endif /* THREAD_LOCAL_BUMP_ALLOC */
+
 /* Each thread structure must be initialized.   */
 /* This call must be made from the new thread.  */
 GC_INNER void GC_init_thread_local(GC_tlfs p)
@@ -121,6 +186,23 @@ GC_INNER void GC_init_thread_local(GC_tlfs p)
 #   ifdef ENABLE_DISCLAIM
         p -> finalized_freelists[0] = (void *)(word)1;
 #   endif
+#   ifdef MEDIUM_FREELISTS
+      for (i = 0; i < (int)MEDIUM_FREELISTS; ++i) {
+        p -> ptrfree_medium_freelists[i] = (void *)(word)1;
+        p -> normal_medium_freelists[i] = (void *)(word)1;
+      }
+#   endif
+#   ifdef THREAD_LOCAL_BUMP_ALLOC
+      BZERO(p -> ptrfree_regions, sizeof(p -> ptrfree_regions));
+      BZERO(p -> normal_regions, sizeof(p -> normal_regions));
+#   endif
+#   ifdef THREAD_LOCAL_LARGE_CACHE
+      GC_drop_large_cache_for(p);
+#   endif
+#   ifdef HEAP_PROFILE
+      p -> bytes_until_sample = 0;
+      p -> sample_rnd = (word)p;
+#   endif
 }
 
 /* We hold the allocator lock.  */
@@ -137,6 +219,19 @@ GC_INNER void GC_destroy_thread_local(GC_tlfs p)
         return_freelists(p -> finalized_freelists,
                          (void **)GC_finalized_objfreelist);
 #   endif
+#   ifdef MEDIUM_FREELISTS
+      return_medium_freelists(p -> ptrfree_medium_freelists,
+                              GC_aobjfreelist);
+      return_medium_freelists(p -> normal_medium_freelists, GC_objfreelist);
+#   endif
+#   ifdef THREAD_LOCAL_BUMP_ALLOC
+      return_regions(p -> ptrfree_regions, GC_aobjfreelist);
+      return_regions(p -> normal_regions, GC_objfreelist);
+#   endif
+#   ifdef THREAD_LOCAL_LARGE_CACHE
+      /* The objects will be reclaimed by the next collection.  */
+      GC_drop_large_cache_for(p);
+#   endif
 }
 
 #ifdef GC_ASSERTIONS
@@ -144,6 +239,151 @@ GC_INNER void GC_destroy_thread_local(GC_tlfs p)
   GC_bool GC_is_thread_tsd_valid(void *tsd);
 #endif
 
+#ifdef MEDIUM_FREELISTS
+  /* Allocate a medium object of kind k (NORMAL or PTRFREE) from the    */
+  /* thread-local free list (in medium_fl) for the size class the       */
+  /* global allocator would use.  The free list entry is used the same  */
+  /* way as the tiny ones (see thread_local_freelists).  Return 0 if    */
+  /* the object should be allocated globally instead.                   */
+  GC_INLINE void * medium_malloc(void **medium_fl, size_t bytes, int k)
+  {
+    size_t lg = GC_size_map[bytes];
+                /* Read without the lock.  0 if not yet computed.       */
+    void **my_fl;
+    void *my_entry;
+    void *next;
+
+    if (EXPECT(0 == lg, FALSE)) return NULL;
+    GC_ASSERT(lg >= TINY_FREELISTS && lg <= MAXOBJGRANULES);
+    my_fl = medium_fl + (lg - TINY_FREELISTS);
+    my_entry = *my_fl;
+    if (EXPECT((word)my_entry < HBLKSIZE, FALSE)) {
+      if ((word)my_entry - 1 < DIRECT_GRANULES) {
+        /* Too few objects of this size allocated by this thread yet.  */
+        *my_fl = (char *)my_entry + lg + 1;
+        return NULL;
+      }
+      GC_generic_malloc_many(GRANULES_TO_BYTES(lg), k, my_fl);
+      my_entry = *my_fl;
+      if (EXPECT(NULL == my_entry, FALSE)) return NULL;
+    }
+    next = obj_link(my_entry);
+    *my_fl = next;
+    if (k != PTRFREE) obj_link(my_entry) = 0;
+    PREFETCH_FOR_WRITE(next);
+    GC_ASSERT(GC_size(my_entry) >= bytes);
+    return my_entry;
+  }
+#endif /* MEDIUM_FREELISTS */
+
+#ifdef THREAD_LOCAL_BUMP_ALLOC
+  /* Is the thread-local free list entry e empty (and the thread-local  */
+  /* allocation is in use for the size)?                                */
+# define TL_FL_EMPTY(e) ((word)(e) - 1 >= DIRECT_GRANULES \
+                         && (word)(e) < HBLKSIZE)
+
+  /* Allocate a tiny object of kind k (NORMAL or PTRFREE) from the      */
+  /* region r by bumping its pointer.  The corresponding free list      */
+  /* (my_fl) is empty.  If the region is exhausted, refill either of    */
+  /* them (only a new block goes to the region).  Return 0 if the free  */
+  /* list should be used (or the allocation has failed).                */
+  GC_INLINE void * bump_malloc(struct bump_region *r, void **my_fl,
+                               size_t granules, int k)
+  {
+    size_t lb = granules != 0 ? GRANULES_TO_BYTES(granules)
+                              : GRANULE_BYTES;
+    ptr_t result = r -> cur;
+
+    if (EXPECT((word)(r -> limit - result) < lb, FALSE)) {
+      GC_generic_malloc_many_or_region(lb, k, my_fl, r);
+      if (*my_fl != NULL) return NULL;
+      result = r -> cur;
+      if ((word)(r -> limit - result) < lb) return NULL;
+    }
+    r -> cur = result + lb;
+    PREFETCH_FOR_WRITE(result + lb);
+    return result;
+  }
+#endif /* THREAD_LOCAL_BUMP_ALLOC */
+
+#ifdef THREAD_LOCAL_LARGE_CACHE
+  /* Allocate a large object of kind k (NORMAL or PTRFREE) from the     */
+  /* thread-local cache (large_cache, one of the arrays of p), refilling */
+  /* the bucket if it is empty.  Return 0 if the object should be       */
+  /* allocated globally instead.                                        */
+  static void * large_cache_malloc(GC_tlfs p, volatile AO_t *large_cache,
+                                   size_t bytes, int k)
+  {
+    size_t lb_rounded, n_blocks;
+    volatile AO_t *bucket;
+    struct hblk *objs[LARGE_CACHE_SLOTS + 1];
+    void *result = NULL;
+    unsigned i, count;
+    word budget;
+    DCL_LOCK_STATE;
+
+    if (bytes > LARGE_CACHE_BLOCKS * HBLKSIZE || GC_find_leak) return NULL;
+    /* The same size (with EXTRA_BYTES added and rounded up to the      */
+    /* granule size) as GC_generic_malloc would allocate.               */
+    lb_rounded = GRANULES_TO_BYTES(ROUNDED_UP_GRANULES(bytes));
+    if (lb_rounded < ADD_SLOP(bytes)) return NULL;
+    n_blocks = OBJ_SZ_TO_BLOCKS(lb_rounded);
+    if (n_blocks > LARGE_CACHE_BLOCKS) return NULL;
+    bucket = large_cache + (n_blocks - 1) * LARGE_CACHE_SLOTS;
+    for (i = 0; i < LARGE_CACHE_SLOTS; ++i) {
+      AO_t h = AO_load(&bucket[i]);
+
+      /* The slot might be zeroed by a collection meanwhile.    */
+      if (h != 0 && AO_compare_and_swap_full(&bucket[i], h, 0)) {
+        result = (void *)h;
+        (void)AO_fetch_and_add(&p->large_cached_blocks,
+                               (AO_t)0 - (AO_t)n_blocks);
+        (void)AO_fetch_and_add(&p->large_bytes_allocd,
+                               (AO_t)n_blocks * HBLKSIZE);
+        break;
+      }
+    }
+    if (NULL == result) {
+      count = (unsigned)(LARGE_CACHE_REFILL_BLOCKS / n_blocks);
+      if (count > LARGE_CACHE_SLOTS + 1) count = LARGE_CACHE_SLOTS + 1;
+      budget = LARGE_CACHE_MAX_BLOCKS - AO_load(&p->large_cached_blocks);
+                /* Racy (the counter may be zeroed meanwhile) but safe. */
+      if (budget <= LARGE_CACHE_MAX_BLOCKS
+          && count > 1 + budget / n_blocks)
+        count = 1 + (unsigned)(budget / n_blocks);
+      if (count < 2) return NULL;
+      LOCK();
+      count = GC_alloc_large_many(n_blocks * HBLKSIZE, k, count, objs);
+      if (count > 0) {
+        GC_bytes_allocd += HDR(objs[0]) -> hb_sz
+                            + AO_load(&p->large_bytes_allocd);
+        AO_store(&p->large_bytes_allocd, 0);
+      }
+      /* All the slots are empty: only this thread fills them.  */
+      for (i = 1; i < count; ++i) {
+        AO_store(&bucket[i - 1], (AO_t)objs[i]);
+        (void)AO_fetch_and_add(&p->large_cached_blocks, (AO_t)n_blocks);
+      }
+      UNLOCK();
+      if (0 == count) return NULL;
+      result = objs[0];
+    }
+    if (k != PTRFREE || GC_debugging_started) {
+      /* Clear the whole object, as GC_generic_malloc does.     */
+      GC_clear_mem(result, GC_size(result));
+    }
+    return result;
+  }
+#endif /* THREAD_LOCAL_LARGE_CACHE */
+
+#ifdef HEAP_PROFILE
+# define TL_SAMPLE_ALLOC(p, result, bytes) \
+        GC_SAMPLE_ALLOC(&(p) -> bytes_until_sample, &(p) -> sample_rnd, \
+                        result, bytes)
+#else
+# define TL_SAMPLE_ALLOC(p, result, bytes) (result)
+#endif
+
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc(size_t bytes)
 {
     size_t granules = ROUNDED_UP_GRANULES(bytes);
@@ -171,14 +411,41 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc(size_t bytes)
 
     GC_ASSERT(GC_is_thread_tsd_valid(tsd));
 
-    tiny_fl = ((GC_tlfs)tsd) -> normal_freelists;
-    GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
-                         NORMAL, GC_core_malloc(bytes), obj_link(result)=0);
+#   ifdef THREAD_LOCAL_LARGE_CACHE
+      if (EXPECT(!SMALL_OBJ(bytes), FALSE)) {
+        result = large_cache_malloc((GC_tlfs)tsd,
+                                    ((GC_tlfs)tsd) -> normal_large_cache,
+                                    bytes, NORMAL);
+        if (NULL == result) result = GC_core_malloc(bytes);
+      } else
+#   endif
+#   ifdef MEDIUM_FREELISTS
+      if (EXPECT(granules >= TINY_FREELISTS, FALSE) && SMALL_OBJ(bytes)) {
+        result = medium_malloc(((GC_tlfs)tsd) -> normal_medium_freelists,
+                               bytes, NORMAL);
+        if (NULL == result) result = GC_core_malloc(bytes);
+      } else
+#   endif
+    /* else */ {
+      tiny_fl = ((GC_tlfs)tsd) -> normal_freelists;
+#     ifdef THREAD_LOCAL_BUMP_ALLOC
+        result = NULL;
+        if (granules < TINY_FREELISTS && TL_FL_EMPTY(tiny_fl[granules]))
+          result = bump_malloc(((GC_tlfs)tsd) -> normal_regions + granules,
+                               tiny_fl + granules, granules, NORMAL);
+        if (NULL == result)
+#     endif
+      /* else */ {
+        GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES,
+                             NORMAL, GC_core_malloc(bytes),
+                             obj_link(result)=0);
+      }
+    }
 #   ifdef LOG_ALLOCS
       GC_log_printf("GC_malloc(%lu) returned %p, recent GC #%lu\n",
                     (unsigned long)bytes, result, (unsigned long)GC_gc_no);
 #   endif
-    return result;
+    return TL_SAMPLE_ALLOC((GC_tlfs)tsd, result, bytes);
 }
 
 GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_atomic(size_t bytes)
@@ -205,10 +472,125 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_atomic(size_t bytes)
       }
 #   endif
     GC_ASSERT(GC_is_initialized);
+#   ifdef THREAD_LOCAL_LARGE_CACHE
+      if (EXPECT(!SMALL_OBJ(bytes), FALSE)) {
+        result = large_cache_malloc((GC_tlfs)tsd,
+                                    ((GC_tlfs)tsd) -> ptrfree_large_cache,
+                                    bytes, PTRFREE);
+        if (NULL == result) result = GC_core_malloc_atomic(bytes);
+        return TL_SAMPLE_ALLOC((GC_tlfs)tsd, result, bytes);
+      }
+#   endif
+#   ifdef MEDIUM_FREELISTS
+      if (EXPECT(granules >= TINY_FREELISTS, FALSE) && SMALL_OBJ(bytes)) {
+        result = medium_malloc(((GC_tlfs)tsd) -> ptrfree_medium_freelists,
+                               bytes, PTRFREE);
+        if (NULL == result) result = GC_core_malloc_atomic(bytes);
+        return TL_SAMPLE_ALLOC((GC_tlfs)tsd, result, bytes);
+      }
+#   endif
     tiny_fl = ((GC_tlfs)tsd) -> ptrfree_freelists;
+#   ifdef THREAD_LOCAL_BUMP_ALLOC
+      if (granules < TINY_FREELISTS && TL_FL_EMPTY(tiny_fl[granules])) {
+        result = bump_malloc(((GC_tlfs)tsd) -> ptrfree_regions + granules,
+                             tiny_fl + granules, granules, PTRFREE);
+        if (result != NULL)
+          return TL_SAMPLE_ALLOC((GC_tlfs)tsd, result, bytes);
+      }
+#   endif
     GC_FAST_MALLOC_GRANS(result, granules, tiny_fl, DIRECT_GRANULES, PTRFREE,
                          GC_core_malloc_atomic(bytes), (void)0 /* no init */);
-    return result;
+    return TL_SAMPLE_ALLOC((GC_tlfs)tsd, result, bytes);
+}
+
+/* Take up to n objects of the given size and kind (NORMAL or PTRFREE)  */
+/* from the thread-local free lists p (refilling them as needed) and    */
+/* store them to out.  Return the number of the stored objects.         */
+static size_t local_malloc_n(GC_tlfs p, size_t bytes, int k, size_t n,
+                             void **out)
+{
+    size_t granules = ROUNDED_UP_GRANULES(bytes);
+    size_t lb;
+    void **my_fl;
+    size_t i;
+
+    if (granules < TINY_FREELISTS) {
+      my_fl = (k == NORMAL ? p -> normal_freelists
+                           : p -> ptrfree_freelists) + granules;
+      lb = granules != 0 ? GRANULES_TO_BYTES(granules) : GRANULE_BYTES;
+    } else {
+#     ifdef MEDIUM_FREELISTS
+        size_t lg;
+
+        if (!SMALL_OBJ(bytes) || 0 == (lg = GC_size_map[bytes]))
+          return 0;
+        my_fl = (k == NORMAL ? p -> normal_medium_freelists
+                             : p -> ptrfree_medium_freelists)
+                + (lg - TINY_FREELISTS);
+        lb = GRANULES_TO_BYTES(lg);
+#     else
+        return 0;
+#     endif
+    }
+    for (i = 0; i < n; ++i) {
+      void *op = *my_fl;
+
+      if (EXPECT((word)op < HBLKSIZE, FALSE)) {
+        /* The free list is empty (or not used yet); refill it.        */
+#       ifdef THREAD_LOCAL_BUMP_ALLOC
+          if (granules < TINY_FREELISTS) {
+            op = bump_malloc((k == NORMAL ? p -> normal_regions
+                                          : p -> ptrfree_regions)
+                             + granules, my_fl, granules, k);
+            if (op != NULL) {
+              out[i] = op;
+              continue;
+            }
+          } else
+#       endif
+        /* else */ {
+          GC_generic_malloc_many(lb, k, my_fl);
+        }
+        op = *my_fl;
+        if (EXPECT((word)op < HBLKSIZE, FALSE)) break;
+      }
+      *my_fl = obj_link(op);
+      if (k != PTRFREE) obj_link(op) = 0;
+      out[i] = op;
+    }
+    return i;
+}
+
+/* Same as GC_malloc_n and GC_malloc_atomic_n, respectively.    */
+GC_INLINE size_t malloc_n_kind(size_t bytes, int k, size_t n, void **out)
+{
+    void *tsd;
+    size_t cnt = 0;
+
+#   if !defined(USE_PTHREAD_SPECIFIC) && !defined(USE_WIN32_SPECIFIC)
+      GC_key_t key = GC_thread_key;
+
+      tsd = EXPECT(key != 0, TRUE) ? GC_getspecific(key) : NULL;
+#   else
+      tsd = GC_getspecific(GC_thread_key);
+#   endif
+    if (EXPECT(tsd != NULL, TRUE)) {
+      GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+      cnt = local_malloc_n((GC_tlfs)tsd, bytes, k, n, out);
+    }
+    if (cnt < n)
+      cnt += GC_generic_malloc_n(bytes, k, n - cnt, out + cnt);
+    return cnt;
+}
+
+GC_API size_t GC_CALL GC_malloc_n(size_t bytes, size_t n, void **out)
+{
+    return malloc_n_kind(bytes, NORMAL, n, out);
+}
+
+GC_API size_t GC_CALL GC_malloc_atomic_n(size_t bytes, size_t n, void **out)
+{
+    return malloc_n_kind(bytes, PTRFREE, n, out);
 }
 
 #ifdef GC_GCJ_SUPPORT
@@ -304,6 +686,26 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
           GC_set_fl_marks(q);
 #     endif
     }
+#   ifdef MEDIUM_FREELISTS
+      for (j = 0; j < (int)MEDIUM_FREELISTS; ++j) {
+        q = p -> ptrfree_medium_freelists[j];
+        if ((word)q > HBLKSIZE) GC_set_fl_marks(q);
+        q = p -> normal_medium_freelists[j];
+        if ((word)q > HBLKSIZE) GC_set_fl_marks(q);
+      }
+#   endif
+#   ifdef THREAD_LOCAL_BUMP_ALLOC
+      /* The objects not yet handed out should survive the sweep.       */
+      for (j = 0; j < TINY_FREELISTS; ++j) {
+        struct bump_region *r = &p->ptrfree_regions[j];
+
+        if ((word)r->cur < (word)r->limit)
+          GC_set_region_marks(r->cur, r->limit);
+        r = &p->normal_regions[j];
+        if ((word)r->cur < (word)r->limit)
+          GC_set_region_marks(r->cur, r->limit);
+      }
+#   endif
 }
 
 #if defined(GC_ASSERTIONS)
@@ -322,6 +724,12 @@ GC_INNER void GC_mark_thread_local_fls_for(GC_tlfs p)
             GC_check_fl_marks(&p->finalized_freelists[j]);
 #         endif
         }
+#       ifdef MEDIUM_FREELISTS
+          for (j = 0; j < (int)MEDIUM_FREELISTS; ++j) {
+            GC_check_fl_marks(&p->ptrfree_medium_freelists[j]);
+            GC_check_fl_marks(&p->normal_medium_freelists[j]);
+          }
+#       endif
     }
 #endif /* GC_ASSERTIONS */
 
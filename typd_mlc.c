@@ -593,14 +593,14 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_malloc_explicitly_typed(size_t lb,
         GC_DBG_COLLECT_AT_MALLOC(lb);
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_eobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_eobjfreelist[lg],
+                       GC_explicit_kind, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             op = (ptr_t)GENERAL_MALLOC((word)lb, GC_explicit_kind);
             if (0 == op) return 0;
             lg = GC_size_map[lb];       /* May have been uninitialized. */
         } else {
-            GC_eobjfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             UNLOCK();
@@ -628,14 +628,14 @@ GC_API GC_ATTR_MALLOC void * GC_CALL
         GC_DBG_COLLECT_AT_MALLOC(lb);
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_eobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_eobjfreelist[lg],
+                       GC_explicit_kind, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             op = (ptr_t)GENERAL_MALLOC_IOP(lb, GC_explicit_kind);
             if (0 == op) return 0;
             lg = GC_size_map[lb];       /* May have been uninitialized. */
         } else {
-            GC_eobjfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             UNLOCK();
@@ -679,14 +679,13 @@ GC_API GC_ATTR_MALLOC void * GC_CALL GC_calloc_explicitly_typed(size_t n,
     if( SMALL_OBJ(lb) ) {
         lg = GC_size_map[lb];
         LOCK();
-        op = GC_arobjfreelist[lg];
+        op = GC_fl_pop((void **)&GC_arobjfreelist[lg], GC_array_kind, lg);
         if (EXPECT(0 == op, FALSE)) {
             UNLOCK();
             op = (ptr_t)GENERAL_MALLOC((word)lb, GC_array_kind);
             if (0 == op) return(0);
             lg = GC_size_map[lb];       /* May have been uninitialized. */
         } else {
-            GC_arobjfreelist[lg] = obj_link(op);
             obj_link(op) = 0;
             GC_bytes_allocd += GRANULES_TO_BYTES(lg);
             UNLOCK();
@@ -1548,7 +1548,11 @@ GC_INNER void GC_push_all_stacks(void)
 #ifdef PARALLEL_MARK
 
 # ifndef MAX_MARKERS
-#   define MAX_MARKERS 16
+#   ifdef USE_MARK_DEQUES
+#     define MAX_MARKERS 64
+#   else
+#     define MAX_MARKERS 16
+#   endif
 # endif
 
   static ptr_t marker_sp[MAX_MARKERS - 1]; /* The cold end of the stack */
@@ -1845,6 +1849,7 @@ GC_INNER void GC_get_next_stack(char *start, char *limit,
     GC_INNER void GC_wait_for_reclaim(void)
     {
       GC_acquire_mark_lock();
+      GC_reclaim_lists_frozen = TRUE;
       while (GC_fl_builder_count > 0) {
         GC_wait_builder();
       }
@@ -2023,6 +2028,7 @@ GC_INNER void GC_get_next_stack(char *start, char *limit,
       GC_ASSERT(builder_cv != 0);
       for (;;) {
         GC_acquire_mark_lock();
+        GC_reclaim_lists_frozen = TRUE;
         if (GC_fl_builder_count == 0)
           break;
         if (ResetEvent(builder_cv) == FALSE)
@@ -2808,6 +2814,22 @@ GC_INNER void GC_init_parallel(void)
     }
   }
 
+# ifdef THREAD_LOCAL_LARGE_CACHE
+    GC_INNER void GC_drop_thread_local_large_caches(void)
+    {
+      int i;
+      GC_thread p;
+
+      GC_ASSERT(GC_world_stopped);
+      for (i = 0; i < THREAD_TABLE_SZ; ++i) {
+        for (p = GC_threads[i]; 0 != p; p = p -> tm.next) {
+          if (!KNOWN_FINISHED(p))
+            GC_drop_large_cache_for(&(p->tlfs));
+        }
+      }
+    }
+# endif /* THREAD_LOCAL_LARGE_CACHE */
+
 # if defined(GC_ASSERTIONS)
     void GC_check_tls_for(GC_tlfs p);
 #   if defined(USE_CUSTOM_SPECIFIC)